@@ -0,0 +1,91 @@
+#include "boardloader.h"
+
+#include <QFile>
+#include <QXmlStreamReader>
+
+BoardLoader::BoardLoader()
+{
+	m_skippedWires = 0;
+}
+
+void BoardLoader::setFillingsLayers(const QStringList & layers)
+{
+	// only polygons on these layers keep their fillings
+	m_fillingsLayers = layers;
+}
+
+int BoardLoader::skippedWires()
+{
+	return m_skippedWires;
+}
+
+bool BoardLoader::load(const QString & path, QDomDocument & doc, QString & errorStr, int & errorLine, int & errorColumn)
+{
+	m_skippedWires = 0;
+	doc = QDomDocument();
+
+	QFile file(path);
+	if (!file.open(QIODevice::ReadOnly)) {
+		errorStr = file.errorString();
+		errorLine = errorColumn = 0;
+		return false;
+	}
+
+	// builds the same tree QDomDocument::setContent would (whitespace-only text and comments dropped)
+	QXmlStreamReader xml(&file);
+	QDomNode current = doc;
+	while (!xml.atEnd()) {
+		switch (xml.readNext()) {
+			case QXmlStreamReader::StartElement:
+			{
+				QString name = xml.name().toString();
+				if (name.compare("fillings") == 0) {
+					QDomElement polygon = current.toElement();
+					if (polygon.tagName().compare("polygon") == 0 && !m_fillingsLayers.contains(polygon.attribute("layer"))) {
+						// keep an empty <fillings> so the tree has the usual shape
+						current.appendChild(doc.createElement(name));
+						int depth = 1;
+						while (depth > 0 && !xml.atEnd()) {
+							QXmlStreamReader::TokenType tokenType = xml.readNext();
+							if (tokenType == QXmlStreamReader::StartElement) {
+								depth++;
+								if (xml.name().toString().compare("wire") == 0) m_skippedWires++;
+							}
+							else if (tokenType == QXmlStreamReader::EndElement) {
+								depth--;
+							}
+						}
+						break;
+					}
+				}
+
+				QDomElement element = doc.createElement(name);
+				foreach (QXmlStreamAttribute attribute, xml.attributes()) {
+					element.setAttribute(attribute.name().toString(), attribute.value().toString());
+				}
+				current.appendChild(element);
+				current = element;
+				break;
+			}
+			case QXmlStreamReader::EndElement:
+				current = current.parentNode();
+				break;
+			case QXmlStreamReader::Characters:
+				if (!xml.isWhitespace()) {
+					current.appendChild(doc.createTextNode(xml.text().toString()));
+				}
+				break;
+			default:
+				break;
+		}
+	}
+
+	if (xml.hasError()) {
+		errorStr = xml.errorString();
+		errorLine = xml.lineNumber();
+		errorColumn = xml.columnNumber();
+		return false;
+	}
+
+	return true;
+}
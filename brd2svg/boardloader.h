@@ -0,0 +1,24 @@
+#ifndef BOARDLOADER_H
+#define BOARDLOADER_H
+
+#include <QDomDocument>
+#include <QStringList>
+
+// Streams a brd2xml board file into a QDomDocument, leaving out the polygon <fillings> nobody draws.
+// On pour-heavy boards the fillings are nearly all of the file.
+
+class BoardLoader
+{
+public:
+	BoardLoader();
+
+	void setFillingsLayers(const QStringList & layers);
+	bool load(const QString & path, QDomDocument & doc, QString & errorStr, int & errorLine, int & errorColumn);
+	int skippedWires();
+
+protected:
+	QStringList m_fillingsLayers;
+	int m_skippedWires;
+};
+
+#endif // BOARDLOADER_H
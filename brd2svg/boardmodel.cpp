@@ -0,0 +1,483 @@
+#include "boardmodel.h"
+#include "miscutils.h"
+
+#include <QStringList>
+#include <QtDebug>
+#include <qmath.h>
+
+#include <limits>
+#include <algorithm>
+
+#include "utils/textutils.h"
+
+static const QString GroupIndex("groupIndex");
+static const QString PadIndex("padIndex");
+
+///////////////////////////////////////////////////////
+
+BoardModel::BoardModel()
+{
+}
+
+void BoardModel::load(QDomElement & root)
+{
+	m_groups.clear();
+	m_pads.clear();
+	m_elements.clear();
+
+	// pads first, so the groups can refer to them from their contacts
+	QStringList padTags;
+	padTags << "pad" << "smd" << "via" << "hole";
+	foreach (QString tagName, padTags) {
+		loadPads(root, tagName);
+	}
+
+	loadGroup(root);
+}
+
+const ModelGroup * BoardModel::group(const QDomElement & element) const
+{
+	bool ok;
+	int ix = element.attribute(GroupIndex).toInt(&ok);
+	if (!ok || ix < 0 || ix >= m_groups.count()) return NULL;
+
+	return &m_groups.at(ix);
+}
+
+const ModelPad * BoardModel::pad(const QDomElement & element) const
+{
+	bool ok;
+	int ix = element.attribute(PadIndex).toInt(&ok);
+	if (!ok || ix < 0 || ix >= m_pads.count()) return NULL;
+
+	return &m_pads.at(ix);
+}
+
+const ModelGroup & BoardModel::group(int index) const
+{
+	return m_groups.at(index);
+}
+
+const ModelPad & BoardModel::pad(int index) const
+{
+	return m_pads.at(index);
+}
+
+const ModelElement & BoardModel::element(int index) const
+{
+	return m_elements.at(index);
+}
+
+QVector<int> BoardModel::elementsNear(const ModelGroup & group, const QRectF & rect) const
+{
+	// returns the elements whose package area touches rect, in board order; callers still do the exact test
+	QVector<int> result;
+	const ModelGrid & grid = group.grid;
+	if (grid.columns == 0) return result;
+
+	QRectF r = rect.normalized();
+	if (r.right() < grid.left || r.bottom() < grid.top) return result;
+	if (r.left() > grid.left + (grid.cellWidth * grid.columns)) return result;
+	if (r.top() > grid.top + (grid.cellHeight * grid.rows)) return result;
+
+	int c1 = qBound(0, (int) ((r.left() - grid.left) / grid.cellWidth), grid.columns - 1);
+	int c2 = qBound(0, (int) ((r.right() - grid.left) / grid.cellWidth), grid.columns - 1);
+	int r1 = qBound(0, (int) ((r.top() - grid.top) / grid.cellHeight), grid.rows - 1);
+	int r2 = qBound(0, (int) ((r.bottom() - grid.top) / grid.cellHeight), grid.rows - 1);
+	for (int row = r1; row <= r2; row++) {
+		for (int column = c1; column <= c2; column++) {
+			foreach (int ix, grid.cells.at((row * grid.columns) + column)) {
+				const ModelGroup & package = m_groups.at(m_elements.at(ix).packageGroup);
+				if (qMax(package.x1, package.x2) < r.left() || qMin(package.x1, package.x2) > r.right()) continue;
+				if (qMax(package.y1, package.y2) < r.top() || qMin(package.y1, package.y2) > r.bottom()) continue;
+
+				result.append(ix);
+			}
+		}
+	}
+
+	// a package spanning several cells shows up once per cell
+	qSort(result);
+	result.erase(std::unique(result.begin(), result.end()), result.end());
+	return result;
+}
+
+int BoardModel::loadGroup(QDomElement & container)
+{
+	int index = m_groups.count();
+	m_groups.append(ModelGroup());
+	container.setAttribute(GroupIndex, index);
+
+	ModelGroup group;
+	group.areaOK = MiscUtils::x1y1x2y2(container, group.x1, group.y1, group.x2, group.y2);
+
+	QDomElement child = container.firstChildElement("wires").firstChildElement();
+	while (!child.isNull()) {
+		if (child.tagName().compare("wire") == 0) {
+			ModelWire wire;
+			loadWire(child, wire);
+			group.wires.append(wire);
+		}
+		child = child.nextSiblingElement();
+	}
+
+	child = container.firstChildElement("circles").firstChildElement();
+	while (!child.isNull()) {
+		if (child.tagName().compare("circle") == 0) {
+			ModelCircle circle;
+			circle.element = child;
+			circle.layer = child.attribute("layer", "");
+			circle.cx = circle.cy = circle.radius = circle.width = 0;
+			bool ok = true;
+			circle.radius = MiscUtils::strToMil(child.attribute("r", ""), ok);
+			if (ok) circle.width = MiscUtils::strToMil(child.attribute("width", ""), ok);
+			if (ok) circle.cx = MiscUtils::strToMil(child.attribute("cx", ""), ok);
+			if (ok) circle.cy = MiscUtils::strToMil(child.attribute("cy", ""), ok);
+			circle.ok = ok;
+			if (ok) {
+				circle.bounds.setCoords(circle.cx - circle.radius, circle.cy - circle.radius, circle.cx + circle.radius, circle.cy + circle.radius);
+			}
+			group.circles.append(circle);
+		}
+		child = child.nextSiblingElement();
+	}
+
+	child = container.firstChildElement("polygons").firstChildElement();
+	while (!child.isNull()) {
+		if (child.tagName().compare("polygon") == 0) {
+			ModelPolygon polygon;
+			polygon.element = child;
+			polygon.layer = child.attribute("layer", "");
+
+			qreal left = std::numeric_limits<int>::max();
+			qreal right = std::numeric_limits<int>::min();
+			qreal top = std::numeric_limits<int>::max();
+			qreal bottom = std::numeric_limits<int>::min();
+			bool gotOne = false;
+			QDomElement contour = child.firstChildElement("contours").firstChildElement("wire");
+			while (!contour.isNull()) {
+				ModelWire wire;
+				loadWire(contour, wire);
+				QRectF r = wire.bounds;
+				if (!r.isNull()) {
+					left = qMin(left, r.left());
+					right = qMax(right, r.right());
+					top = qMin(top, r.top());
+					bottom = qMax(bottom, r.bottom());
+					gotOne = true;
+				}
+				contour = contour.nextSiblingElement("wire");
+			}
+			if (gotOne) {
+				polygon.bounds.setCoords(left, top, right, bottom);
+			}
+			group.polygons.append(polygon);
+		}
+		child = child.nextSiblingElement();
+	}
+
+	child = container.firstChildElement("rects").firstChildElement();
+	while (!child.isNull()) {
+		if (child.tagName().compare("rect") == 0) {
+			ModelRect rect;
+			rect.element = child;
+			rect.layer = child.attribute("layer", "");
+			rect.coordsOK = MiscUtils::x1y1x2y2(child, rect.x1, rect.y1, rect.x2, rect.y2);
+			bool ok = true;
+			rect.width = MiscUtils::strToMil(child.attribute("width", ""), ok);
+			if (!ok) rect.width = 0;
+			if (rect.coordsOK) {
+				rect.bounds.setCoords(qMin(rect.x1, rect.x2), qMin(rect.y1, rect.y2), qMax(rect.x1, rect.x2), qMax(rect.y1, rect.y2));
+			}
+			group.rects.append(rect);
+		}
+		child = child.nextSiblingElement();
+	}
+
+	child = container.firstChildElement("texts").firstChildElement();
+	while (!child.isNull()) {
+		if (child.tagName().compare("text") == 0) {
+			ModelText text;
+			text.element = child;
+			text.layer = child.attribute("layer", "");
+			TextUtils::findText(child, text.text);
+
+			QDomElement wire = child.firstChildElement("wires").firstChildElement("wire");
+			while (!wire.isNull()) {
+				qreal x1 = 0, y1 = 0, x2 = 0, y2 = 0;
+				MiscUtils::x1y1x2y2(wire, x1, y1, x2, y2);
+				text.wires.append(QLineF(x1, y1, x2, y2));
+				wire = wire.nextSiblingElement("wire");
+			}
+
+			bool ok = true;
+			text.x = MiscUtils::strToMil(child.attribute("x", ""), ok);
+			if (ok) text.y = MiscUtils::strToMil(child.attribute("y", ""), ok);
+			text.positionOK = ok;
+
+			text.width = MiscUtils::strToMil(child.attribute("width", ""), text.widthOK);
+
+			text.angle = child.attribute("angle", "").toDouble(&ok);
+			if (ok) text.mirror = child.attribute("mirror", "").toInt(&ok);
+			if (ok) text.spin = child.attribute("spin", "").toInt(&ok);
+			if (ok) text.size = MiscUtils::strToMil(child.attribute("size", ""), ok);
+			text.restOK = ok;
+
+			group.texts.append(text);
+		}
+		child = child.nextSiblingElement();
+	}
+
+	QDomElement contact = container.firstChildElement("contacts").firstChildElement("contact");
+	while (!contact.isNull()) {
+		QDomElement padOrSmd = contact.firstChildElement("pad");
+		if (padOrSmd.isNull()) padOrSmd = contact.firstChildElement("smd");
+		bool ok;
+		int ix = padOrSmd.attribute(PadIndex).toInt(&ok);
+		if (ok) group.contacts.append(ix);
+		contact = contact.nextSiblingElement("contact");
+	}
+
+	QDomElement element = container.firstChildElement("elements").firstChildElement("element");
+	while (!element.isNull()) {
+		ModelElement modelElement;
+		modelElement.element = element;
+		modelElement.name = element.attribute("name", "");
+		modelElement.package = element.firstChildElement("package");
+		modelElement.packageName = modelElement.package.attribute("name", "");
+		modelElement.group = loadGroup(element);
+		modelElement.packageGroup = modelElement.package.isNull() ? -1 : loadGroup(modelElement.package);
+		if (modelElement.packageGroup < 0) {
+			qDebug() << "element without package" << modelElement.name;
+		}
+		group.elements.append(m_elements.count());
+		m_elements.append(modelElement);
+		element = element.nextSiblingElement("element");
+	}
+
+	indexElements(group);
+	m_groups[index] = group;
+	return index;
+}
+
+void BoardModel::indexElements(ModelGroup & group)
+{
+	ModelGrid & grid = group.grid;
+	grid.columns = grid.rows = 0;
+	grid.cells.clear();
+
+	QVector<int> indexed;
+	qreal left = 0, top = 0, right = 0, bottom = 0;
+	foreach (int ix, group.elements) {
+		const ModelElement & element = m_elements.at(ix);
+		if (element.packageGroup < 0) continue;
+
+		const ModelGroup & package = m_groups.at(element.packageGroup);
+		if (!package.areaOK) continue;			// never in bounds
+
+		if (indexed.isEmpty()) {
+			left = qMin(package.x1, package.x2);
+			right = qMax(package.x1, package.x2);
+			top = qMin(package.y1, package.y2);
+			bottom = qMax(package.y1, package.y2);
+		}
+		else {
+			left = qMin(left, qMin(package.x1, package.x2));
+			right = qMax(right, qMax(package.x1, package.x2));
+			top = qMin(top, qMin(package.y1, package.y2));
+			bottom = qMax(bottom, qMax(package.y1, package.y2));
+		}
+		indexed.append(ix);
+	}
+
+	if (indexed.isEmpty()) return;
+
+	// about one package per cell
+	int side = qMax(1, qCeil(qSqrt(indexed.count())));
+	grid.columns = grid.rows = side;
+	grid.left = left;
+	grid.top = top;
+	grid.cellWidth = (right > left) ? (right - left) / side : 1;
+	grid.cellHeight = (bottom > top) ? (bottom - top) / side : 1;
+	grid.cells.resize(side * side);
+
+	foreach (int ix, indexed) {
+		const ModelGroup & package = m_groups.at(m_elements.at(ix).packageGroup);
+		int c1 = qBound(0, (int) ((qMin(package.x1, package.x2) - left) / grid.cellWidth), side - 1);
+		int c2 = qBound(0, (int) ((qMax(package.x1, package.x2) - left) / grid.cellWidth), side - 1);
+		int r1 = qBound(0, (int) ((qMin(package.y1, package.y2) - top) / grid.cellHeight), side - 1);
+		int r2 = qBound(0, (int) ((qMax(package.y1, package.y2) - top) / grid.cellHeight), side - 1);
+		for (int row = r1; row <= r2; row++) {
+			for (int column = c1; column <= c2; column++) {
+				grid.cells[(row * side) + column].append(ix);
+			}
+		}
+	}
+}
+
+void BoardModel::loadPads(QDomElement & root, const QString & tagName)
+{
+	QDomNodeList nodeList = root.elementsByTagName(tagName);
+	for (int i = 0; i < nodeList.count(); i++) {
+		QDomElement element = nodeList.item(i).toElement();
+		if (element.isNull()) continue;
+
+		ModelPad pad;
+		pad.element = element;
+		pad.x = pad.y = pad.drill = pad.dx = pad.dy = pad.smdAngle = pad.roundness = 0;
+
+		bool xyOK = true;
+		pad.x = MiscUtils::strToMil(element.attribute("x", ""), xyOK);
+		if (xyOK) pad.y = MiscUtils::strToMil(element.attribute("y", ""), xyOK);
+
+		bool ok = xyOK;
+		if (ok) pad.drill = MiscUtils::strToMil(element.attribute("drill", ""), ok);
+		pad.holeOK = ok;
+
+		pad.angle = element.attribute("angle", "0").toDouble();
+
+		ok = xyOK;
+		if (ok) pad.dx = MiscUtils::strToMil(element.attribute("dx", ""), ok);
+		if (ok) pad.dy = MiscUtils::strToMil(element.attribute("dy", ""), ok);
+		bool sizeOK = ok;
+		if (ok) pad.smdAngle = element.attribute("angle", "").toDouble(&ok);
+		if (ok) pad.roundness = element.attribute("roundness", "").toDouble(&ok);
+		pad.smdOK = ok;
+
+		QDomElement layer = element.firstChildElement("layer");
+		while (!layer.isNull()) {
+			ModelPadLayer padLayer;
+			padLayer.layer = layer.attribute("layer", "");
+			padLayer.diameter = MiscUtils::strToMil(layer.attribute("diameter", ""), padLayer.diameterOK);
+			padLayer.shape = layer.attribute("shape", "");
+			pad.layers.append(padLayer);
+			layer = layer.nextSiblingElement("layer");
+		}
+
+		if (tagName.compare("smd") == 0) {
+			if (sizeOK) pad.bounds = QRectF(pad.x - (pad.dx / 2), pad.y - (pad.dy / 2), pad.dx, pad.dy);
+		}
+		else if (xyOK) {
+			qreal diameter = 0;
+			foreach (ModelPadLayer padLayer, pad.layers) {
+				if (padLayer.diameterOK && padLayer.diameter != 0) {
+					diameter = padLayer.diameter;
+					break;
+				}
+			}
+			pad.bounds = QRectF(pad.x - (diameter / 2), pad.y - (diameter / 2), diameter, diameter);
+		}
+
+		element.setAttribute(PadIndex, m_pads.count());
+		m_pads.append(pad);
+	}
+}
+
+void BoardModel::loadWire(QDomElement & element, ModelWire & wire)
+{
+	wire.element = element;
+	wire.layer = element.attribute("layer", "");
+
+	QDomElement piece = element.firstChildElement("piece");
+	while (!piece.isNull()) {
+		QDomElement line = piece.firstChildElement("line");
+		if (!line.isNull()) {
+			ModelPiece modelPiece;
+			modelPiece.isArc = false;
+			ModelLine & modelLine = modelPiece.line;
+			modelLine.coordsOK = MiscUtils::x1y1x2y2(line, modelLine.x1, modelLine.y1, modelLine.x2, modelLine.y2);
+			modelLine.width = MiscUtils::strToMil(line.attribute("width", ""), modelLine.widthOK);
+			modelLine.cap = line.attribute("cap", "1").toInt();
+			wire.pieces.append(modelPiece);
+		}
+		else {
+			QDomElement arc = piece.firstChildElement("arc");
+			if (!arc.isNull()) {
+				ModelPiece modelPiece;
+				modelPiece.isArc = true;
+				ModelArc & modelArc = modelPiece.arc;
+				modelArc.coordsOK = MiscUtils::x1y1x2y2(arc, modelArc.x1, modelArc.y1, modelArc.x2, modelArc.y2);
+				modelArc.rwaaOK = MiscUtils::rwaa(arc, modelArc.radius, modelArc.width, modelArc.angle1, modelArc.angle2);
+				bool ok;
+				modelArc.xc = MiscUtils::strToMil(arc.attribute("xc", ""), ok);
+				if (ok) modelArc.yc = MiscUtils::strToMil(arc.attribute("yc", ""), ok);
+				modelArc.centerOK = ok;
+				wire.pieces.append(modelPiece);
+			}
+		}
+
+		piece = piece.nextSiblingElement("piece");
+	}
+
+	wire.bounds = wireBounds(wire);
+}
+
+QRectF BoardModel::wireBounds(const ModelWire & wire)
+{
+	qreal left = std::numeric_limits<int>::max();
+	qreal right = std::numeric_limits<int>::min();
+	qreal top = std::numeric_limits<int>::max();
+	qreal bottom = std::numeric_limits<int>::min();
+
+	foreach (ModelPiece piece, wire.pieces) {
+		qreal x1, y1, x2, y2;
+		bool ok = false;
+		if (!piece.isArc) {
+			ok = piece.line.coordsOK;
+			x1 = piece.line.x1;
+			y1 = piece.line.y1;
+			x2 = piece.line.x2;
+			y2 = piece.line.y2;
+		}
+		else {
+			const ModelArc & arc = piece.arc;
+			ok = arc.coordsOK && arc.rwaaOK && arc.centerOK;
+			if (ok) {
+				// from http://groups.google.com/group/comp.graphics.algorithms/browse_thread/thread/1adbcc734e44d024/79201c57a09149fe?lnk=gst&q=arc+bounding+box#79201c57a09149fe
+				// Assuming that the arc is the counterclockwise arc from s to e.
+				// Precondition: 0 <= s < 360  and 0 <= e < 360
+				qreal angle1 = arc.angle1;
+				qreal angle2 = arc.angle2;
+				qreal xc = arc.xc;
+				qreal yc = arc.yc;
+				qreal radius = arc.radius;
+				if (angle2 < angle1) angle2 = angle2 + 360;
+				x1 = qMin(arc.x1, arc.x2);
+				y1 = qMin(arc.y1, arc.y2);
+				x2 = qMax(arc.x1, arc.x2);
+				y2 = qMax(arc.y1, arc.y2);
+
+				if (angle2 > 90) {
+					if (angle1 < 90) y2 = yc + radius;
+					if (angle2 > 180) {
+						if (angle1 < 180) x1 = xc - radius;
+						if (angle2 > 270) {
+							if (angle1 < 270) y1 = yc - radius;
+							if (angle2 > 360) {
+								x2 = xc + radius;
+								if (angle2 > 450) {
+									y2 = yc + radius;
+									if (angle2 > 540) {
+										x1 = xc - radius;
+										if (angle2 > 630) y1 = yc - radius;
+									}
+								}
+							}
+						}
+					}
+				}
+			}
+		}
+
+		if (ok) {
+			left = qMin(left, qMin(x1, x2));
+			right = qMax(right, qMax(x1, x2));
+			top = qMin(top, qMin(y1, y2));
+			bottom = qMax(bottom, qMax(y1, y2));
+		}
+	}
+
+	QRectF bounds;
+	bounds.setCoords(left, top, right, bottom);
+	return bounds;
+}
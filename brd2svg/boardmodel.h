@@ -0,0 +1,158 @@
+#ifndef BOARDMODEL_H
+#define BOARDMODEL_H
+
+#include <QDomElement>
+#include <QRectF>
+#include <QLineF>
+#include <QVector>
+
+// Geometry of a brd2xml board, parsed once when the board is loaded instead of on every attribute access.
+// Records keep their QDomElement: params matching, nudges and connector bookkeeping still work on the dom.
+// The ...OK flags record which attributes parsed, so callers can bail out exactly where they used to.
+
+struct ModelLine {
+	qreal x1, y1, x2, y2;
+	qreal width;
+	int cap;
+	bool coordsOK;
+	bool widthOK;
+};
+
+struct ModelArc {
+	qreal x1, y1, x2, y2;
+	qreal radius, width, angle1, angle2;
+	qreal xc, yc;
+	bool coordsOK;
+	bool rwaaOK;
+	bool centerOK;
+};
+
+struct ModelPiece {
+	bool isArc;
+	ModelLine line;
+	ModelArc arc;
+};
+
+struct ModelWire {
+	QDomElement element;
+	QString layer;
+	QVector<ModelPiece> pieces;
+	QRectF bounds;
+};
+
+struct ModelCircle {
+	QDomElement element;
+	QString layer;
+	qreal cx, cy, radius, width;
+	bool ok;
+	QRectF bounds;
+};
+
+struct ModelRect {
+	QDomElement element;
+	QString layer;
+	qreal x1, y1, x2, y2;
+	qreal width;				// 0 when missing
+	bool coordsOK;
+	QRectF bounds;
+};
+
+struct ModelPolygon {
+	QDomElement element;
+	QString layer;
+	QRectF bounds;				// of the contours
+};
+
+struct ModelText {
+	QDomElement element;
+	QString layer;
+	QString text;
+	QVector<QLineF> wires;		// vector font strokes, only used to check the text is on the board
+	qreal x, y;
+	qreal width;
+	qreal angle;
+	int mirror;
+	int spin;
+	qreal size;
+	bool positionOK;
+	bool widthOK;
+	bool restOK;
+};
+
+struct ModelPadLayer {
+	QString layer;
+	qreal diameter;
+	bool diameterOK;
+	QString shape;
+};
+
+// a pad, smd, via or hole
+struct ModelPad {
+	QDomElement element;
+	qreal x, y, drill;
+	qreal angle;
+	QVector<ModelPadLayer> layers;
+	bool holeOK;				// x, y and drill parsed
+	qreal dx, dy, smdAngle, roundness;
+	bool smdOK;					// x, y, dx, dy, angle and roundness parsed
+	QRectF bounds;
+};
+
+struct ModelElement {
+	QDomElement element;
+	QString name;
+	QDomElement package;
+	QString packageName;
+	int group;
+	int packageGroup;			// -1 if there is no package
+};
+
+// uniform grid over the package areas of a group's elements, so area queries only test nearby packages
+struct ModelGrid {
+	qreal left, top;
+	qreal cellWidth, cellHeight;
+	int columns, rows;				// 0 when there is nothing to index
+	QVector< QVector<int> > cells;	// element indexes, row by row
+};
+
+// the layer elements directly inside a board, element or package
+struct ModelGroup {
+	QVector<ModelWire> wires;
+	QVector<ModelCircle> circles;
+	QVector<ModelPolygon> polygons;
+	QVector<ModelRect> rects;
+	QVector<ModelText> texts;
+	QVector<int> contacts;		// the pad or smd of each <contact>
+	QVector<int> elements;
+	qreal x1, y1, x2, y2;
+	bool areaOK;
+	ModelGrid grid;
+};
+
+class BoardModel
+{
+public:
+	BoardModel();
+
+	void load(QDomElement & root);
+	const ModelGroup * group(const QDomElement &) const;
+	const ModelGroup & group(int index) const;
+	const ModelPad * pad(const QDomElement &) const;
+	const ModelPad & pad(int index) const;
+	const ModelElement & element(int index) const;
+	QVector<int> elementsNear(const ModelGroup &, const QRectF &) const;
+
+protected:
+	int loadGroup(QDomElement & container);
+	void loadPads(QDomElement & root, const QString & tagName);
+	void loadWire(QDomElement & element, ModelWire & wire);
+	void indexElements(ModelGroup &);
+	QRectF wireBounds(const ModelWire & wire);
+
+protected:
+	QVector<ModelGroup> m_groups;
+	QVector<ModelPad> m_pads;
+	QVector<ModelElement> m_elements;
+};
+
+#endif // BOARDMODEL_H
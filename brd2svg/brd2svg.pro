@@ -16,6 +16,7 @@ QT += xml \
     network \
     gui \
     widgets \
+    concurrent \
     # script \
 
 TARGET = brd2svg
@@ -24,7 +25,16 @@ CONFIG -= app_bundle
 TEMPLATE = app
 SOURCES += main.cpp \
     brdapplication.cpp \
+    boardloader.cpp \
+    buildmanifest.cpp \
+    boardmodel.cpp \
+    brdreader.cpp \
     miscutils.cpp \
+    outputwriter.cpp \
+    subpartcache.cpp \
+    subpartindex.cpp \
+    svgwriter.cpp \
+    zipwriter.cpp \
     $$FRITZING_SRC/utils/textutils.cpp \
     $$FRITZING_SRC/utils/graphicsutils.cpp  \
     $$FRITZING_SRC/utils/schematicrectconstants.cpp  \
@@ -35,7 +45,16 @@ SOURCES += main.cpp \
     $$FRITZING_SRC/svg/svgpathrunner.cpp  
    
 HEADERS += brdapplication.h \
+    boardloader.h \
+    boardmodel.h \
+    buildmanifest.h \
+    brdreader.h \
     miscutils.h \
+    outputwriter.h \
+    subpartcache.h \
+    subpartindex.h \
+    svgwriter.h \
+    zipwriter.h \
     $$FRITZING_SRC/utils/textutils.h \
     $$FRITZING_SRC/utils/misc.h \
     $$FRITZING_SRC/utils/graphicsutils.h  \
@@ -1,5 +1,10 @@
 #include "brdapplication.h"
+#include "boardloader.h"
+#include "brdreader.h"
+#include "buildmanifest.h"
+#include "svgwriter.h"
 #include "miscutils.h"
+#include "outputwriter.h"
 
 #include "stdio.h"
 
@@ -22,6 +27,9 @@
 //#include <QScriptEngine>
 //#include <QScriptValue>
 #include <QTextDocument> 
+#include <QThreadStorage>
+#include <QThreadPool>
+#include <QtConcurrentMap>
 
 #include <limits>
 
@@ -56,6 +64,8 @@ const QString BottomPlaceLayer("22");
 
 const qreal MinPCBPackageArea = 250 * 250;
 
+const qreal OutputDPI = 72;
+
 const QString FritzingVersion = "0.5.2b.02.18.4756";
 
 QList<QString> GroundNames;
@@ -70,10 +80,82 @@ bool cxcyrw(QDomElement & element, qreal & cx, qreal & cy, qreal & radius, qreal
 
 inline QString SW(qreal strokeWidth)
 {
-	return QString("%1").arg(strokeWidth);
+	return SvgWriter::formatNumber(strokeWidth);
 }
 
-static QMultiHash<QString, class Renamer *> Renamers;
+// getConnectorName is handed to fritzing-app code as a plain function pointer, 
+// so it finds the renames of the board being converted on the current thread here
+static QThreadStorage< QMultiHash<QString, class Renamer *> > Renamers;
+
+static bool sameNumbers(const QString & s1, const QString & s2)
+{
+	// attribute values match if they hold the same numbers, give or take the rounding of each pass
+	QRegExp number("[-+]?(\\d+\\.?\\d*|\\.\\d+)([eE][-+]?\\d+)?");
+	QList<qreal> n1, n2;
+	int pos = 0;
+	while ((pos = number.indexIn(s1, pos)) >= 0) {
+		n1.append(number.cap(0).toDouble());
+		pos += number.matchedLength();
+	}
+	pos = 0;
+	while ((pos = number.indexIn(s2, pos)) >= 0) {
+		n2.append(number.cap(0).toDouble());
+		pos += number.matchedLength();
+	}
+
+	if (n1.isEmpty() && n2.isEmpty()) return s1.trimmed() == s2.trimmed();
+	if (n1.count() != n2.count()) return false;
+
+	for (int i = 0; i < n1.count(); i++) {
+		if (qAbs(n1.at(i) - n2.at(i)) > 0.001 + 0.0001 * qMax(qAbs(n1.at(i)), qAbs(n2.at(i)))) return false;
+	}
+
+	return true;
+}
+
+static bool sameSvgElement(const QDomElement & e1, const QDomElement & e2, QString & difference)
+{
+	if (e1.tagName() != e2.tagName()) {
+		difference = QString("<%1> vs <%2>").arg(e1.tagName()).arg(e2.tagName());
+		return false;
+	}
+
+	QDomNamedNodeMap attributes = e1.attributes();
+	if (attributes.count() != e2.attributes().count()) {
+		difference = QString("<%1> has %2 attributes vs %3").arg(e1.tagName()).arg(attributes.count()).arg(e2.attributes().count());
+		return false;
+	}
+
+	for (int i = 0; i < attributes.count(); i++) {
+		QDomAttr attribute = attributes.item(i).toAttr();
+		if (!e2.hasAttribute(attribute.name()) || !sameNumbers(attribute.value(), e2.attribute(attribute.name()))) {
+			difference = QString("<%1 %2='%3'> vs '%4'").arg(e1.tagName()).arg(attribute.name()).arg(attribute.value()).arg(e2.attribute(attribute.name()));
+			return false;
+		}
+	}
+
+	QDomElement c1 = e1.firstChildElement();
+	QDomElement c2 = e2.firstChildElement();
+	while (!c1.isNull() && !c2.isNull()) {
+		if (!sameSvgElement(c1, c2, difference)) return false;
+
+		c1 = c1.nextSiblingElement();
+		c2 = c2.nextSiblingElement();
+	}
+
+	if (!c1.isNull() || !c2.isNull()) {
+		difference = QString("<%1> has a different number of children").arg(e1.tagName());
+		return false;
+	}
+
+	return true;
+}
+
+static QString fzpFilename(const QString & basename, bool genericSMD)
+{
+	if (genericSMD) return "SMD_" + basename + ".fzp";
+	return basename + ".fzp";
+}
 
 bool numericByIndex(QDomElement & e1, QDomElement & e2)
 {
@@ -91,7 +173,7 @@ QString getConnectorName(const QDomElement & element)
 	packages << "DUEMILANOVE_SHIELD_NOHOLES" << "DUEMILANOVE_SHIELD_NOLABELS" << "DUEMILANOVE_SHIELD";
 
 	QString signal = element.attribute("signal");
-	QList<Renamer *> renamers = Renamers.values(signal);
+	QList<Renamer *> renamers = Renamers.localData().values(signal);
 	if (renamers.count() > 0) {
         QDomElement package = element.parentNode().parentNode().toElement();
 		QString packageName = package.attribute("name");
@@ -175,10 +257,33 @@ Renamer::Renamer(const QDomElement & element)
 
 ///////////////////////////////////////////////////////
 
-BrdApplication::BrdApplication(int& argc, char **argv[]) : QApplication(argc, *argv)
+class ConvertBoard
 {
-	m_networkAccessManager = NULL;
+public:
+	typedef BoardResult result_type;
+
+	ConvertBoard(const BoardRun & run) : m_run(run) {}
+
+	BoardResult operator()(const QString & filename) const {
+		BoardResult result;
+		BoardContext boardContext(m_run);
+		result.converted = boardContext.convert(filename, result.packageNames);
+		result.subparts = boardContext.subparts();
+		result.outputs = boardContext.outputs();
+		if (m_run.fzpzArchive) {
+			result.bundle = boardContext.bundle();
+		}
+		return result;
+	}
 
+protected:
+	const BoardRun & m_run;
+};
+
+///////////////////////////////////////////////////////
+
+BrdApplication::BrdApplication(int& argc, char **argv[]) : QApplication(argc, *argv)
+{
 	GroundNames << "gnd"<<  "vss" << "vee" << "com"; 
 	PowerNames << "vcc" << "+5v" << "+3v" << "+3.3v" << "5v" << "3v" << "3.3v" << "-" << "+" << "vdd" << "v+" << "v-" << "vin" << "vout" << "+v";
 	ExternalElementNames << "sv" << "j";
@@ -192,6 +297,11 @@ void BrdApplication::start() {
         return;
     }
 
+	if (m_benchmarkNumbers) {
+		message(SvgWriter::benchmark(1000000));
+		return;
+	}
+
 	QDir workingFolder(m_workingPath);
 	QDir fzpFolder, breadboardFolder, schematicFolder, pcbFolder, iconFolder;
 	if (!MiscUtils::makePartsDirectories(workingFolder, m_core, fzpFolder, breadboardFolder, schematicFolder, pcbFolder, iconFolder)) return;
@@ -249,29 +359,36 @@ void BrdApplication::start() {
 		return;	
     }
 
-	QStringList nameFilters;
-	nameFilters << "*.brd";
-	QStringList fileList = brdFolder.entryList(nameFilters, QDir::Files | QDir::NoDotAndDotDot);
-	foreach (QString filename, fileList) {
-		genXml(workingFolder, andFolder, filename, xmlFolder);
-	}
-
-	QHash<QString, DifParam *> difParams;
-	loadDifParams(workingFolder, difParams);
+	BoardRun run;
+	run.workingPath = workingFolder.absolutePath();
+	run.xmlPath = xmlFolder.absolutePath();
+	run.paramsPath = paramsFolder.absolutePath();
+	run.descriptionsPath = descriptionsFolder.absolutePath();
+	run.fzpPath = fzpFolder.absolutePath();
+	run.breadboardPath = breadboardFolder.absolutePath();
+	run.schematicPath = schematicFolder.absolutePath();
+	run.pcbPath = pcbFolder.absolutePath();
+	run.genericSMD = m_genericSMD;
+	run.verifySvg = m_verifySvg;
+	run.fzpz = m_fzpz;
+	run.fzpzArchive = m_fzpzArchive;
+	run.fzpzPath = workingFolder.absoluteFilePath("fzpz");
+	run.simplifyTolerance = m_simplifyTolerance;
+
+	loadDifParams(workingFolder, run.difParams);
 
-	QStringList ICs;
-    QHash<QString, QString> SubpartAliases;
 	QFile file(AllPackagesPath);
 	QString errorStr;
 	int errorLine;
 	int errorColumn;
 	QDomDocument doc;
+	QHash<QString, QString> subpartAliases;
 	if (doc.setContent(&file, true, &errorStr, &errorLine, &errorColumn)) {	
 		QDomElement root = doc.documentElement();
 		QDomElement package = root.firstChildElement("package");
 		while (!package.isNull()) {
 			if (package.attribute("ic").compare("yes", Qt::CaseInsensitive) == 0) {
-				ICs.append(package.attribute("name"));
+				run.ICs.append(package.attribute("name"));
 			}
 			package = package.nextSiblingElement("package");
 		}
@@ -280,137 +397,116 @@ void BrdApplication::start() {
 			QString from = map.attribute("package");
             QString to = map.attribute("to");
             if (!from.isEmpty() && !to.isEmpty()) {
-                SubpartAliases.insert(to.toLower(), from);
+                subpartAliases.insert(to.toLower(), from);
             }
 			map = map.nextSiblingElement("map");
 		}
 	}
 
-	//QString txt = TextUtils::escapeAnd(this->loadDescription("ThermalPrinter", "http://www.sparkfun.com/products/10438", descriptionsFolder));
-
-
-	QSet<QString> packageNames;
-	foreach (QString filename, fileList) {
-		QString errorStr;
-		int errorLine;
-		int errorColumn;
-
-		QFileInfo fileInfo(filename);
-		QString basename = fileInfo.completeBaseName();
-		QString xmlname = basename + ".xml";
-
-		DifParam * difParam = difParams.value(basename.toLower(), NULL);
-		QFile file(xmlFolder.absoluteFilePath(xmlname));
-		if (!m_boardDoc.setContent(&file, true, &errorStr, &errorLine, &errorColumn)) {
-			message(QString("unable to parse board xml '%1': %2 line:%3 col:%4").arg(xmlname).arg(errorStr).arg(errorLine).arg(errorColumn));
-			qDebug() << "";
-			continue;
-		}
-
-		QDomElement root = m_boardDoc.documentElement();
-		if (root.isNull()) {
-			message(QString("file '%1' has no root").arg(xmlname));
-			qDebug() << "";
-			continue;
-		}
+	// list the subpart folders once instead of probing them for every package
+	run.subparts.scan(m_fritzingSubpartsPath);
+	run.subparts.addAliases(subpartAliases);
+	run.breadboardSubparts.scan(QDir(m_fritzingSubpartsPath).absoluteFilePath("breadboard"));
+	run.breadboardSubparts.addAliases(subpartAliases);
+	if (m_dumpSubpartsIndex) {
+		message(run.subparts.dump());
+		message(run.breadboardSubparts.dump());
+		return;
+	}
 
-		if (root.tagName() != "board") {
-			message(QString("file '%1' was not generated by brd2xml.ulp").arg(xmlname));
-			qDebug() << "";
-			continue;
-		}
+	OutputWriter::start(m_fsync ? OutputWriter::SyncAtEnd : OutputWriter::NoSync);
 
-		qDebug() << "parsing" << xmlname;
+	QStringList nameFilters;
+	nameFilters << "*.brd";
+	QStringList fileList = brdFolder.entryList(nameFilters, QDir::Files | QDir::NoDotAndDotDot);
 
-		m_boardBounds = m_trueBounds = getDimensions(root, m_maxElement, DimensionsLayer, false);
-		if (m_maxElement.isNull()) {
-			qDebug() << "No board bounds found!";
+	// a board whose .brd changed since it was last converted gets its xml exported again;
+	// boards not in the manifest yet fall back on comparing timestamps
+	QString manifestPath = workingFolder.absoluteFilePath("brd2svg.manifest");
+	BuildManifest manifest;
+	manifest.load(manifestPath);
+	QHash<QString, QString> brdHashes;
+	foreach (QString filename, fileList) {
+		QString brdPath = brdFolder.absoluteFilePath(filename);
+		QString brdHash = BuildManifest::hashFile(brdPath);
+		brdHashes.insert(filename, brdHash);
+
+		QFileInfo xmlInfo(xmlFolder.absoluteFilePath(QFileInfo(filename).completeBaseName() + ".xml"));
+		if (!xmlInfo.exists()) continue;
+
+		bool stale = manifest.contains(filename) 
+			? manifest.entry(filename).brdHash.compare(brdHash) != 0
+			: xmlInfo.lastModified() < QFileInfo(brdPath).lastModified();
+		if (stale) {
+			qDebug() << QString("%1 changed, exporting xml again").arg(filename);
+			QFile::remove(xmlInfo.absoluteFilePath());
 		}
+	}
 
-		//qDebug() << "true bounds:" << m_trueBounds;
-
-		if (!m_genericSMD) {
-			getPackagesBounds(root, m_trueBounds, "", false, false);
-			//qDebug() << "adjusted true bounds:" << m_trueBounds;
+	QStringList eagleList = fileList;
+	if (m_nativeReader) {
+		eagleList.clear();
+		foreach (QString filename, fileList) {
+			if (!genNativeXml(brdFolder, filename, xmlFolder)) {
+				eagleList << filename;
+			}
 		}
+		// without -e there is nothing to fall back on
+		if (m_eaglePath.isEmpty()) eagleList.clear();
+	}
 
-		QString paramsPath = paramsFolder.absoluteFilePath(basename + ".params");
-		QFile paramsFile(paramsPath);
-
-		QDomDocument paramsDoc;
-		if (paramsFile.exists()) {
-			paramsDoc = loadParams(paramsFile, basename);
+	if (m_batchXml) {
+		genXmlBatch(workingFolder, andFolder, eagleList, xmlFolder);
+	}
+	else {
+		foreach (QString filename, eagleList) {
+			genXml(workingFolder, andFolder, filename, xmlFolder);
 		}
-        QDomElement paramsRoot = paramsDoc.documentElement();
-		QDomElement connectors = paramsRoot.firstChildElement("connectors");
-		QDomElement renames = connectors.firstChildElement("renames");
-		QDomElement rename = renames.firstChildElement("rename");
-		while (!rename.isNull()) {
-			Renamer * renamer =  new Renamer(rename);
-			Renamers.insert(renamer->signal, renamer);
+	}
 
-			rename = rename.nextSiblingElement("rename");
-		}
+	// the boards are loaded from the xml files just written
+	OutputWriter::flush();
 
-		QList<QDomElement> packages;
-		collectPackages(root, packages);
-		foreach (QDomElement package, packages) {
-			QString name = package.attribute("name", "").toLower();
-			packageNames.insert(name);
-		}
+	//QString txt = TextUtils::escapeAnd(this->loadDescription("ThermalPrinter", "http://www.sparkfun.com/products/10438", descriptionsFolder));
 
-		m_shrinkHolesFactor = 1.0;
-		QString shf = paramsRoot.attribute("shrink-holes-factor", "");
-		if (!shf.isEmpty()) {
-			bool ok;
-			qreal shfn = shf.toDouble(&ok);
-			if (ok) {
-				m_shrinkHolesFactor = shfn;
+	// skip the boards whose inputs and outputs are where the manifest left them
+	BuildManifest nextManifest;
+	QString commonHash = commonInputsHash(AllPackagesPath, run);
+	QStringList convertList;
+	QSet<QString> packageNames;
+	foreach (QString filename, fileList) {
+		if (manifest.contains(filename)) {
+			ManifestEntry entry = manifest.entry(filename);
+			if (entry.inputsHash.compare(boardInputsHash(filename, brdHashes.value(filename), run, entry.subparts, commonHash)) == 0 && outputsExist(filename, run)) {
+				foreach (QString name, entry.packageNames) {
+					packageNames.insert(name);
+				}
+				nextManifest.setEntry(filename, entry);
+				continue;
 			}
 		}
 
+		convertList << filename;
+	}
+	qDebug() << QString("%1 of %2 boards up to date").arg(fileList.count() - convertList.count()).arg(fileList.count());
 
-		//qDebug() << "generating schematic";
-        QString schematicsvg = genSchematic(root, paramsRoot, difParam);
-		SvgFileSplitter splitter;
-		splitter.load(schematicsvg);
-        double factor;
-		splitter.normalize(72, "", false, factor);
-		saveFile(splitter.toString(), schematicFolder.absoluteFilePath(basename + "_schematic.svg"));
-
-		//qDebug() << "generating pcb";
-        QString pcbsvg = genPCB(root, paramsRoot);
-		splitter.load(pcbsvg);
-		splitter.normalize(72, "", false, factor);
-		saveFile(splitter.toString(), pcbFolder.absoluteFilePath(basename + "_pcb.svg"));
-
-		//qDebug() << "generating breadboard";
-
-		QString breadboardsvg;
-		if (m_genericSMD) {
-			breadboardsvg = genGenericBreadboard(root, paramsRoot, difParam, workingFolder);
-		}
-		else {
-			breadboardsvg = genBreadboard(root, paramsRoot, difParam, ICs, SubpartAliases);
+	// each board gets its own BoardContext; results come back in convertList order either way
+	QList<BoardResult> results;
+	if (m_jobs > 1 && convertList.count() > 1) {
+		QThreadPool::globalInstance()->setMaxThreadCount(m_jobs);
+		results = QtConcurrent::blockingMapped< QList<BoardResult> >(convertList, ConvertBoard(run));
+	}
+	else {
+		ConvertBoard convertBoard(run);
+		foreach (QString filename, convertList) {
+			results.append(convertBoard(filename));
 		}
-		splitter.load(breadboardsvg);
-		splitter.normalize(72, "", false, factor);
-		saveFile(splitter.toString(), breadboardFolder.absoluteFilePath(basename + "_breadboard.svg"));
-
-		//qDebug() << "generating fzp";
-		QString gender = paramsRoot.attribute("gender", "female");
-        QString fzp = genFZP(root, paramsRoot, difParam, basename, gender, descriptionsFolder);
-		QString fzpName = basename + ".fzp";
-		if (m_genericSMD) fzpName = "SMD_" + fzpName;
-		saveFile(fzp, fzpFolder.absoluteFilePath(fzpName));
+	}
 
-		if (!paramsFile.exists()) {
-			qDebug() << "generating params";
-			QString params = genParams(root, basename);
-			saveFile(params, paramsPath);
+	foreach (BoardResult result, results) {
+		foreach (QString name, result.packageNames) {
+			packageNames.insert(name);
 		}
-
-		qDebug() << "";
 	}
 
 		
@@ -438,16 +534,398 @@ void BrdApplication::start() {
 		saveFile(packageString, AllPackagesPath);
 	}
 
+	// hash after all.packages.txt and any new .params files have been written, 
+	// so the next run doesn't see them as changes
+	OutputWriter::flush();
+	commonHash = commonInputsHash(AllPackagesPath, run);
+	QSet<QString> failures = OutputWriter::failures().toSet();
+	for (int i = 0; i < convertList.count(); i++) {
+		const BoardResult & result = results.at(i);
+		if (!result.converted) continue;			// try again next time
+
+		QString filename = convertList.at(i);
+		bool written = true;
+		foreach (QString path, result.outputs) {
+			if (failures.contains(path)) written = false;
+		}
+		if (!written) {
+			qDebug() << "unable to write every file for" << filename << "so it will be converted again next time";
+			continue;
+		}
+
+		ManifestEntry entry;
+		entry.brdHash = brdHashes.value(filename);
+		entry.subparts = result.subparts;
+		entry.packageNames = result.packageNames;
+		entry.inputsHash = boardInputsHash(filename, entry.brdHash, run, entry.subparts, commonHash);
+		nextManifest.setEntry(filename, entry);
+	}
+	nextManifest.save(manifestPath);
+
+	qDebug() << "subpart cache:" << SubpartCache::hits() << "hits" << SubpartCache::misses() << "misses";
+
 	qDebug() << "generating bin";
 	qDebug() << "";
     QString binName = workingFolder.dirName();
 	genBin(fileList, binName, binsFolder.absoluteFilePath(binName + ".fzb"));
 
+	if (m_fzpzArchive) {
+		// boards skipped as up to date contribute the entries of the .fzpz they already have
+		qDebug() << "generating fzbz";
+		QHash<QString, int> converted;
+		for (int i = 0; i < convertList.count(); i++) {
+			converted.insert(convertList.at(i), i);
+		}
+		QList<ZipEntry> archive;
+		foreach (QString filename, fileList) {
+			int ix = converted.value(filename, -1);
+			if (ix >= 0 && results.at(ix).converted) {
+				archive.append(results.at(ix).bundle);
+				continue;
+			}
+
+			QString fzpzName = QFileInfo(fzpFilename(QFileInfo(filename).completeBaseName(), m_genericSMD)).completeBaseName() + ".fzpz";
+			if (!ZipWriter::read(QDir(run.fzpzPath).absoluteFilePath(fzpzName), archive)) {
+				qDebug() << "unable to add" << fzpzName << "to the fzbz";
+			}
+		}
+		QFile binFile(binsFolder.absoluteFilePath(binName + ".fzb"));
+		if (binFile.open(QIODevice::ReadOnly)) {
+			archive.append(ZipWriter::compress(binName + ".fzb", binFile.readAll()));
+			binFile.close();
+		}
+		QString fzbzPath = binsFolder.absoluteFilePath(binName + ".fzbz");
+		OutputWriter::write(fzbzPath, ZipWriter::archive(archive), false);
+		OutputWriter::flush();
+		if (OutputWriter::failures().contains(fzbzPath)) {
+			qDebug() << "unable to write the fzbz" << fzbzPath;
+		}
+	}
+
+	OutputWriter::finish();
+	qDebug() << OutputWriter::stats();
+	foreach (QString path, OutputWriter::failures()) {
+		qDebug() << "not written:" << path;
+	}
+
 	qDebug() << "done";
 	qDebug() << "";
 }
 
-void BrdApplication::getPackagesBounds(QDomElement & root, QRectF & bounds, const QString & layer, bool reset, bool deep) {
+QString BrdApplication::commonInputsHash(const QString & allPackagesPath, const BoardRun & run)
+{
+	// what every board depends on: the converter itself, its options, all.packages.txt and the set of subparts
+	// in both folders a package can be matched against
+	QStringList inputs;
+	inputs << BuildManifest::hashFile(QCoreApplication::applicationFilePath());
+	inputs << m_core << QString::number(m_genericSMD ? 1 : 0) << QString::number(SvgWriter::precision()) << QString::number(m_fzpz ? 1 : 0) << QString::number(SvgWriter::compact() ? 1 : 0) << QString::number(m_simplifyTolerance);
+	inputs << BuildManifest::hashFile(allPackagesPath);
+	inputs << run.subparts.files();
+	inputs << run.breadboardSubparts.files();
+	return BuildManifest::hashStrings(inputs);
+}
+
+QString BrdApplication::boardInputsHash(const QString & brdname, const QString & brdHash, const BoardRun & run, const QStringList & subparts, const QString & commonHash)
+{
+	QString basename = QFileInfo(brdname).completeBaseName();
+	QStringList inputs;
+	inputs << commonHash << brdHash;
+	inputs << BuildManifest::hashFile(QDir(run.paramsPath).absoluteFilePath(basename + ".params"));
+
+	DifParam * difParam = run.difParams.value(basename.toLower(), NULL);
+	if (difParam) {
+		inputs << difParam->filename << difParam->title << difParam->description << difParam->author;
+		inputs << difParam->boardColor << difParam->url << difParam->tags.join(",");
+		QStringList keys = difParam->properties.keys();
+		qSort(keys);
+		foreach (QString key, keys) {
+			inputs << key << difParam->properties.value(key);
+		}
+	}
+
+	foreach (QString subpart, subparts) {
+		inputs << subpart << BuildManifest::hashFile(subpart);
+	}
+
+	return BuildManifest::hashStrings(inputs);
+}
+
+bool BrdApplication::outputsExist(const QString & brdname, const BoardRun & run)
+{
+	QString basename = QFileInfo(brdname).completeBaseName();
+	QString fzpName = fzpFilename(basename, run.genericSMD);
+	if (run.fzpz) {
+		return QFile::exists(QDir(run.fzpzPath).absoluteFilePath(QFileInfo(fzpName).completeBaseName() + ".fzpz"));
+	}
+
+	return QFile::exists(QDir(run.schematicPath).absoluteFilePath(basename + "_schematic.svg")) &&
+			QFile::exists(QDir(run.pcbPath).absoluteFilePath(basename + "_pcb.svg")) &&
+			QFile::exists(QDir(run.breadboardPath).absoluteFilePath(basename + "_breadboard.svg")) &&
+			QFile::exists(QDir(run.fzpPath).absoluteFilePath(fzpName));
+}
+
+///////////////////////////////////////////////////////
+
+BoardContext::BoardContext(const BoardRun & run) : m_run(run)
+{
+	m_genericSMD = run.genericSMD;
+	m_cxLast = m_cyLast = 0;
+	m_shrinkHolesFactor = 1.0;
+	m_networkAccessManager = NULL;
+	m_dimensionsHits = m_dimensionsMisses = 0;
+	m_svgScale = 1;
+	m_segmentsRemoved = 0;
+}
+
+BoardContext::~BoardContext()
+{
+	Renamers.setLocalData(QMultiHash<QString, Renamer *>());
+	qDeleteAll(m_renamers);
+	delete m_networkAccessManager;
+}
+
+bool BoardContext::convert(const QString & filename, QStringList & packageNames)
+{
+	QString errorStr;
+	int errorLine;
+	int errorColumn;
+
+	QDir xmlFolder(m_run.xmlPath);
+	QDir paramsFolder(m_run.paramsPath);
+	QDir workingFolder(m_run.workingPath);
+	QDir descriptionsFolder(m_run.descriptionsPath);
+
+	QFileInfo fileInfo(filename);
+	QString basename = fileInfo.completeBaseName();
+	QString xmlname = basename + ".xml";
+
+	DifParam * difParam = m_run.difParams.value(basename.toLower(), NULL);
+	// only the tPlace polygons are ever drawn with their fillings (see genPCB and genBreadboard)
+	BoardLoader boardLoader;
+	boardLoader.setFillingsLayers(QStringList() << TopPlaceLayer);
+	if (!boardLoader.load(xmlFolder.absoluteFilePath(xmlname), m_boardDoc, errorStr, errorLine, errorColumn)) {
+		BrdApplication::message(QString("unable to parse board xml '%1': %2 line:%3 col:%4").arg(xmlname).arg(errorStr).arg(errorLine).arg(errorColumn));
+		qDebug() << "";
+		return false;
+	}
+
+	QDomElement root = m_boardDoc.documentElement();
+	if (root.isNull()) {
+		BrdApplication::message(QString("file '%1' has no root").arg(xmlname));
+		qDebug() << "";
+		return false;
+	}
+
+	if (root.tagName() != "board") {
+		BrdApplication::message(QString("file '%1' was not generated by brd2xml.ulp").arg(xmlname));
+		qDebug() << "";
+		return false;
+	}
+
+	qDebug() << "parsing" << xmlname;
+	if (boardLoader.skippedWires() > 0) {
+		qDebug() << "skipped" << boardLoader.skippedWires() << "polygon filling wires";
+	}
+
+	m_model.load(root);
+
+	m_boardBounds = m_trueBounds = getDimensions(root, m_maxElement, DimensionsLayer, false);
+	if (m_maxElement.isNull()) {
+		qDebug() << "No board bounds found!";
+	}
+
+	//qDebug() << "true bounds:" << m_trueBounds;
+
+	if (!m_genericSMD) {
+		getPackagesBounds(root, m_trueBounds, "", false, false);
+		//qDebug() << "adjusted true bounds:" << m_trueBounds;
+	}
+
+	QString paramsPath = paramsFolder.absoluteFilePath(basename + ".params");
+	QFile paramsFile(paramsPath);
+
+	QDomDocument paramsDoc;
+	if (paramsFile.exists()) {
+		paramsDoc = loadParams(paramsFile, basename);
+	}
+    QDomElement paramsRoot = paramsDoc.documentElement();
+	loadRenames(paramsRoot);
+
+	QList<QDomElement> packages;
+	collectPackages(root, packages);
+	foreach (QDomElement package, packages) {
+		packageNames.append(package.attribute("name", "").toLower());
+	}
+
+	m_shrinkHolesFactor = 1.0;
+	QString shf = paramsRoot.attribute("shrink-holes-factor", "");
+	if (!shf.isEmpty()) {
+		bool ok;
+		qreal shfn = shf.toDouble(&ok);
+		if (ok) {
+			m_shrinkHolesFactor = shfn;
+		}
+	}
+
+	// the schematic and the generic breadboard come from shared code that writes at 1000 dpi,
+	// the pcb and breadboard are written at OutputDPI directly
+
+	//qDebug() << "generating schematic";
+    QString schematicsvg = normalizeSvg(genSchematic(root, paramsRoot, difParam));
+	if (SvgWriter::compact()) {
+		schematicsvg = MiscUtils::compactSvg(schematicsvg);
+	}
+	saveOutput(schematicsvg, m_run.schematicPath, basename + "_schematic.svg", "svg.schematic.");
+
+	//qDebug() << "generating pcb";
+	m_svgScale = OutputDPI / 1000;
+	m_segmentsRemoved = 0;
+    QString pcbsvg = genPCB(root, paramsRoot);
+	int pcbSegmentsRemoved = m_segmentsRemoved;
+	if (m_run.verifySvg) {
+		m_svgScale = 1;
+		verifySvg(pcbsvg, genPCB(root, paramsRoot), basename + "_pcb.svg");
+	}
+	saveOutput(pcbsvg, m_run.pcbPath, basename + "_pcb.svg", "svg.pcb.");
+
+	//qDebug() << "generating breadboard";
+
+	QString breadboardsvg;
+	int breadboardSegmentsRemoved = 0;
+	m_segmentsRemoved = 0;
+	if (m_genericSMD) {
+		m_svgScale = 1;
+		breadboardsvg = normalizeSvg(genGenericBreadboard(root, paramsRoot, difParam, workingFolder));
+	}
+	else {
+		m_svgScale = OutputDPI / 1000;
+		breadboardsvg = genBreadboard(root, paramsRoot, difParam, m_run.ICs);
+		breadboardSegmentsRemoved = m_segmentsRemoved;
+		if (m_run.verifySvg) {
+			m_svgScale = 1;
+			verifySvg(breadboardsvg, genBreadboard(root, paramsRoot, difParam, m_run.ICs), basename + "_breadboard.svg");
+		}
+	}
+	m_svgScale = 1;
+	if (SvgWriter::compact()) {
+		// the pcb keeps its explicit attributes, which Fritzing's gerber export reads element by element
+		breadboardsvg = MiscUtils::compactSvg(breadboardsvg);
+		if (m_run.verifySvg && !breadboardsvg.contains("<style")) {
+			// a breadboard repeats the same fill and stroke all over, so it should always get classes
+			qDebug() << "\tverify" << basename + "_breadboard.svg" << "compact svg has no style classes";
+		}
+	}
+	saveOutput(breadboardsvg, m_run.breadboardPath, basename + "_breadboard.svg", "svg.breadboard.");
+
+	//qDebug() << "generating fzp";
+	QString gender = paramsRoot.attribute("gender", "female");
+    QString fzp = genFZP(root, paramsRoot, difParam, basename, gender, descriptionsFolder);
+	QString fzpName = fzpFilename(basename, m_genericSMD);
+	saveOutput(fzp, m_run.fzpPath, fzpName, "part.");
+	if (m_run.fzpz) {
+		// fzp and svgs in one file, named the way Fritzing bundles parts
+		QString fzpzPath = QDir(m_run.fzpzPath).absoluteFilePath(QFileInfo(fzpName).completeBaseName() + ".fzpz");
+		m_outputs.append(fzpzPath);
+		OutputWriter::write(fzpzPath, ZipWriter::archive(m_bundle), false);
+	}
+
+	if (!paramsFile.exists()) {
+		qDebug() << "generating params";
+		QString params = genParams(root, basename);
+		BrdApplication::saveFile(params, paramsPath);
+	}
+
+	if (m_run.simplifyTolerance > 0) {
+		qDebug() << "segments removed by simplifying: pcb" << pcbSegmentsRemoved << "breadboard" << breadboardSegmentsRemoved;
+	}
+	qDebug() << "dimensions cache:" << m_dimensionsHits << "hits" << m_dimensionsMisses << "misses";
+	qDebug() << "";
+	return true;
+}
+
+const QStringList & BoardContext::subparts() const
+{
+	return m_subparts;
+}
+
+const QList<ZipEntry> & BoardContext::bundle() const
+{
+	return m_bundle;
+}
+
+const QStringList & BoardContext::outputs() const
+{
+	return m_outputs;
+}
+
+void BoardContext::saveOutput(const QString & content, const QString & folderPath, const QString & filename, const QString & bundleName)
+{
+	if (m_run.fzpz) {
+		m_bundle.append(ZipWriter::compress(bundleName + filename, content.toUtf8()));
+		return;
+	}
+
+	QString path = QDir(folderPath).absoluteFilePath(filename);
+	m_outputs.append(path);
+	BrdApplication::saveFile(content, path);
+}
+
+QString BoardContext::normalizeSvg(const QString & svg)
+{
+	SvgFileSplitter splitter;
+	splitter.load(svg);
+    double factor;
+	splitter.normalize(OutputDPI, "", false, factor);
+	return splitter.toString();
+}
+
+void BoardContext::verifySvg(const QString & direct, const QString & svg1000, const QString & name)
+{
+	// compare what was written at OutputDPI with the 1000 dpi svg put through the old normalize pass
+	SvgFileSplitter splitter;
+	if (!splitter.load(svg1000)) {
+		qDebug() << "\tverify" << name << "unable to load the 1000 dpi svg";
+		return;
+	}
+
+    double factor;
+	splitter.normalize(OutputDPI, "", false, factor);
+	QDomDocument normalized = splitter.domDocument();
+
+	QDomDocument doc;
+	QString errorStr;
+	int errorLine;
+	int errorColumn;
+	if (!doc.setContent(direct, &errorStr, &errorLine, &errorColumn)) {
+		qDebug() << "\tverify" << name << "unable to parse:" << errorStr << errorLine << errorColumn;
+		return;
+	}
+
+	QString difference;
+	if (sameSvgElement(doc.documentElement(), normalized.documentElement(), difference)) {
+		qDebug() << "\tverified" << name;
+	}
+	else {
+		qDebug() << "\tverify" << name << "differs from the normalized svg:" << difference;
+	}
+}
+
+void BoardContext::loadRenames(QDomElement & paramsRoot)
+{
+	QDomElement connectors = paramsRoot.firstChildElement("connectors");
+	QDomElement renames = connectors.firstChildElement("renames");
+	QDomElement rename = renames.firstChildElement("rename");
+	while (!rename.isNull()) {
+		Renamer * renamer =  new Renamer(rename);
+		m_renamers.insert(renamer->signal, renamer);
+
+		rename = rename.nextSiblingElement("rename");
+	}
+
+	Renamers.setLocalData(m_renamers);
+}
+
+void BoardContext::getPackagesBounds(QDomElement & root, QRectF & bounds, const QString & layer, bool reset, bool deep) {
 	if (reset) {
 		bounds.setCoords(std::numeric_limits<int>::max(), std::numeric_limits<int>::max(), std::numeric_limits<int>::min(), std::numeric_limits<int>::min());
 	}
@@ -541,14 +1019,14 @@ void BrdApplication::genBin(QStringList & fileList, const QString & titleString,
 	}
 }
 
-QDomDocument BrdApplication::loadParams(QFile & paramsFile, const QString & basename) {
+QDomDocument BoardContext::loadParams(QFile & paramsFile, const QString & basename) {
 	QDomDocument paramsDoc;
 	QString errorStr;
 	int errorLine;
 	int errorColumn;
 
 	if (!paramsDoc.setContent(&paramsFile, true, &errorStr, &errorLine, &errorColumn)) {
-		message(QString("unable to parse params file '%1': %2 line:%3 col:%4").arg(basename).arg(errorStr).arg(errorLine).arg(errorColumn));
+		BrdApplication::message(QString("unable to parse params file '%1': %2 line:%3 col:%4").arg(basename).arg(errorStr).arg(errorLine).arg(errorColumn));
 	}
 
 	return paramsDoc;
@@ -556,18 +1034,22 @@ QDomDocument BrdApplication::loadParams(QFile & paramsFile, const QString & base
 
 void BrdApplication::saveFile(const QString & content, const QString & path) 
 {
-	QFile file(path);
-	if (file.open(QIODevice::WriteOnly | QIODevice::Text)) {
-		QTextStream out(&file);
-		out.setCodec("UTF-8");
-		out << content;
-		file.close();
-	}
+	// one utf-8 conversion of the whole document, written behind
+	OutputWriter::write(path, content.toUtf8());
 }
 
 bool BrdApplication::initArguments() {
 	m_workingPath = m_eaglePath = "";
 	m_genericSMD = false;
+	m_batchXml = false;
+	m_nativeReader = false;
+	m_verifySvg = false;
+	m_dumpSubpartsIndex = false;
+	m_fzpz = m_fzpzArchive = false;
+	m_fsync = false;
+	m_simplifyTolerance = 0;
+	m_jobs = 1;
+	m_benchmarkNumbers = false;
     QStringList args = QApplication::arguments();
     for (int i = 0; i < args.length(); i++) {
         if ((args[i].compare("-h", Qt::CaseInsensitive) == 0) ||
@@ -585,6 +1067,71 @@ bool BrdApplication::initArguments() {
 			 continue;
         }
 
+		if ((args[i].compare("-x", Qt::CaseInsensitive) == 0) ||
+            (args[i].compare("-batch", Qt::CaseInsensitive) == 0)||
+            (args[i].compare("--batch", Qt::CaseInsensitive) == 0))
+        {
+             m_batchXml = true;
+			 continue;
+        }
+
+		if ((args[i].compare("-verify-svg", Qt::CaseInsensitive) == 0)||
+            (args[i].compare("--verify-svg", Qt::CaseInsensitive) == 0))
+        {
+             m_verifySvg = true;
+			 continue;
+        }
+
+		if ((args[i].compare("-fzpz", Qt::CaseInsensitive) == 0)||
+            (args[i].compare("--fzpz", Qt::CaseInsensitive) == 0))
+        {
+             m_fzpz = true;
+			 continue;
+        }
+
+		if ((args[i].compare("-fzbz", Qt::CaseInsensitive) == 0)||
+            (args[i].compare("--fzbz", Qt::CaseInsensitive) == 0))
+        {
+             m_fzpz = m_fzpzArchive = true;
+			 continue;
+        }
+
+		if ((args[i].compare("-compact-svg", Qt::CaseInsensitive) == 0)||
+            (args[i].compare("--compact-svg", Qt::CaseInsensitive) == 0))
+        {
+             SvgWriter::setCompact(true);
+			 continue;
+        }
+
+		if ((args[i].compare("-fsync", Qt::CaseInsensitive) == 0)||
+            (args[i].compare("--fsync", Qt::CaseInsensitive) == 0))
+        {
+             m_fsync = true;
+			 continue;
+        }
+
+		if ((args[i].compare("-subparts-index", Qt::CaseInsensitive) == 0)||
+            (args[i].compare("--subparts-index", Qt::CaseInsensitive) == 0))
+        {
+             m_dumpSubpartsIndex = true;
+			 continue;
+        }
+
+		if ((args[i].compare("-benchmark-numbers", Qt::CaseInsensitive) == 0)||
+            (args[i].compare("--benchmark-numbers", Qt::CaseInsensitive) == 0))
+        {
+			m_benchmarkNumbers = true;
+			return true;
+        }
+
+		if ((args[i].compare("-n", Qt::CaseInsensitive) == 0) ||
+            (args[i].compare("-native", Qt::CaseInsensitive) == 0)||
+            (args[i].compare("--native", Qt::CaseInsensitive) == 0))
+        {
+             m_nativeReader = true;
+			 continue;
+        }
+
 		if (i + 1 < args.length()) {
 			if ((args[i].compare("-w", Qt::CaseInsensitive) == 0) ||
 				(args[i].compare("-working", Qt::CaseInsensitive) == 0)||
@@ -616,11 +1163,43 @@ bool BrdApplication::initArguments() {
 			{
 				m_fritzingSubpartsPath = args[++i];
 			}
+			else if ((args[i].compare("-j", Qt::CaseInsensitive) == 0) ||
+				(args[i].compare("-jobs", Qt::CaseInsensitive) == 0)||
+				(args[i].compare("--jobs", Qt::CaseInsensitive) == 0))
+			{
+				bool ok;
+				m_jobs = args[++i].toInt(&ok);
+				if (!ok || m_jobs < 1) {
+					message(QString("-j expects a positive number of jobs, not '%1'").arg(args[i]));
+					return false;
+				}
+			}
+			else if ((args[i].compare("-precision", Qt::CaseInsensitive) == 0)||
+				(args[i].compare("--precision", Qt::CaseInsensitive) == 0))
+			{
+				bool ok;
+				int precision = args[++i].toInt(&ok);
+				if (!ok || !SvgWriter::validPrecision(precision)) {
+					message(QString("--precision expects a number of decimal places from 0 to %1, not '%2'").arg(SvgWriter::MaxPrecision).arg(args[i]));
+					return false;
+				}
+				SvgWriter::setPrecision(precision);
+			}
+			else if ((args[i].compare("-simplify-tolerance", Qt::CaseInsensitive) == 0)||
+				(args[i].compare("--simplify-tolerance", Qt::CaseInsensitive) == 0))
+			{
+				bool ok;
+				m_simplifyTolerance = args[++i].toDouble(&ok);
+				if (!ok || m_simplifyTolerance < 0) {
+					message(QString("--simplify-tolerance expects a distance in mils, not '%1'").arg(args[i]));
+					return false;
+				}
+			}
 
 		}
     }
 
-    if (m_eaglePath.isEmpty()) {
+    if (m_eaglePath.isEmpty() && !m_nativeReader) {
         message("-e <path to eagle executable> parameter missing");
         return false;
     }
@@ -636,6 +1215,9 @@ bool BrdApplication::initArguments() {
         return false;
     }
 
+    // with -n, eagle is optional and only used for boards that aren't EAGLE 6 xml
+    if (m_eaglePath.isEmpty()) return true;
+
     QFileInfo file(m_eaglePath);
     if (!file.exists()) {
         message(QString("eagle executable '%1' not found").arg(m_eaglePath));
@@ -663,6 +1245,17 @@ void BrdApplication::usage() {
                 "-s <path to subparts folder> "
                 "-p <path to second subparts folder> "
                 "-a <path to 'and' folder> "
+                "-j <number of boards to convert in parallel> "
+                "-x (export all boards in one eagle session per job) "
+                "-n (read EAGLE 6+ xml boards directly; -e becomes optional) "
+                "--precision <decimal places for svg coordinates, 0 to 9> "
+                "--verify-svg (check the pcb and breadboard svgs against the old normalize pass, and that compact breadboards get style classes) "
+                "--fzpz (write each part as one .fzpz in the fzpz folder instead of the parts folders) "
+                "--fzbz (--fzpz, plus all the parts and the bin in one .fzbz in the bins folder) "
+                "--compact-svg (relative path commands, and classes instead of repeated styles in the breadboard and schematic) "
+                "--fsync (sync every file written to disk before exiting) "
+                "--simplify-tolerance <mils; drop silkscreen and polygon points closer than this to a straight line> "
+                "--subparts-index (list the subparts and aliases brd2svg will use, then exit) "
                 "\n"
     );
 }
@@ -675,272 +1268,86 @@ void BrdApplication::message(const QString & msg) {
 	qDebug() << msg;
  }
 
-void BrdApplication::collectLayerElements(QList<QDomElement> & from, QList<QDomElement> & to, const QString & layerID) {
-	foreach (QDomElement element, from) {
-		if (element.isNull()) continue;
+static void extendDimensions(const QRectF & r, const QDomElement & element, qreal & left, qreal & top, qreal & right, qreal & bottom, QDomElement & maxElement)
+{
+	if (r.isNull()) return;
 
-		QDomElement child = element.firstChildElement();
-		while (!child.isNull()) {
-			QString layer = child.attribute("layer", "");
-			
-			if (layer.compare(layerID) == 0 || layerID.isEmpty()) {
-				to.append(child);
-			}
-			child = child.nextSiblingElement();
-		}
+	if (r.left() < left) {
+		left = r.left();
+		maxElement = element;
+	}
+	if (r.right() > right) {
+		right = r.right();
+		maxElement = element;
+	}
+	if (r.top() < top) {
+		top = r.top();
+		maxElement = element;
+	}
+	if (r.bottom() > bottom) {
+		bottom = r.bottom();
+		maxElement = element;
 	}
 }
 
-QRectF BrdApplication::getDimensions(QDomElement & root, QDomElement & maxElement, const QString & layer, bool deep) 
+QRectF BoardContext::getDimensions(QDomElement & root, QDomElement & maxElement, const QString & layer, bool deep) 
+{
+	// every view asks for the same package bounds, so compute each one once per board
+	QString key = QString("%1/%2/%3").arg(root.attribute("groupIndex")).arg(layer).arg(deep ? 1 : 0);
+	QHash<QString, CachedDimensions>::const_iterator it = m_dimensionsCache.constFind(key);
+	if (it != m_dimensionsCache.constEnd()) {
+		m_dimensionsHits++;
+		if (!it.value().maxElement.isNull()) maxElement = it.value().maxElement;
+		return it.value().bounds;
+	}
+
+	m_dimensionsMisses++;
+	CachedDimensions cached;
+	cached.bounds = calcDimensions(root, cached.maxElement, layer, deep);
+	m_dimensionsCache.insert(key, cached);
+	if (!cached.maxElement.isNull()) maxElement = cached.maxElement;
+	return cached.bounds;
+}
+
+QRectF BoardContext::calcDimensions(QDomElement & root, QDomElement & maxElement, const QString & layer, bool deep) 
 {
 	qreal left = std::numeric_limits<int>::max();
 	qreal right = std::numeric_limits<int>::min();
 	qreal top = std::numeric_limits<int>::max();
 	qreal bottom = std::numeric_limits<int>::min();
 
-	QList<QDomElement> from;
-	from.append(root.firstChildElement("wires"));
-	from.append(root.firstChildElement("circles"));
-	from.append(root.firstChildElement("polygons"));
-	from.append(root.firstChildElement("rects"));
-	QList<QDomElement> to;
-	collectLayerElements(from, to, layer);
-
-	if (deep) {
-		addElements(root, to, 0);
-		QDomElement contacts = root.firstChildElement("contacts");
-		QDomElement contact = contacts.firstChildElement("contact");
-		while (!contact.isNull()) {
-			QDomElement pad = contact.firstChildElement("pad");
-			if (!pad.isNull()) {
-				to.append(pad);
-			}
-			else {
-				QDomElement smd = contact.firstChildElement("smd");
-				if (!smd.isNull()) to.append(smd);
-			}
+	const ModelGroup * group = m_model.group(root);
+	if (group == NULL) return QRectF(left, top, right - left, bottom - top);
 
-			contact = contact.nextSiblingElement("contact");
+	foreach (const ModelWire & wire, group->wires) {
+		if (layer.isEmpty() || wire.layer.compare(layer) == 0) {
+			extendDimensions(wire.bounds, wire.element, left, top, right, bottom, maxElement);
 		}
 	}
-
-	foreach (QDomElement element, to) {
-		if (element.isNull()) continue;
-
-        QString string;
-        QTextStream stream(&string);
-        element.save(stream, 0);
-
-		QRectF r = getPlainBounds(element, layer);
-		if (!r.isNull()) {
-			if (r.left() < left) {
-				left = r.left();
-				maxElement = element;
-			}
-			if (r.right() > right) {
-				right = r.right();
-				maxElement = element;
-			}
-			if (r.top() < top) {
-				top = r.top();
-				maxElement = element;
-			}
-			if (r.bottom() > bottom) {
-				bottom = r.bottom();
-				maxElement = element;
-			}
+	foreach (const ModelCircle & circle, group->circles) {
+		if (layer.isEmpty() || circle.layer.compare(layer) == 0) {
+			extendDimensions(circle.bounds, circle.element, left, top, right, bottom, maxElement);
 		}
 	}
-
-	return QRectF(left, top, right - left, bottom - top);
-}
-
-QRectF BrdApplication::getPlainBounds(QDomElement & element, const QString & layer) {
-	QString tagName = element.tagName();
-
-	QRectF bounds;
-	if (tagName.compare("circle") == 0) {
-		qreal cx, cy, radius, width;
-		if (!cxcyrw(element, cx, cy, radius, width)) return bounds;
-
-		bounds.setCoords(cx - radius, cy - radius, cx + radius, cy + radius);
-		return bounds;
-	}
-
-	if (tagName.compare("wire") == 0) {
-		qreal left = std::numeric_limits<int>::max();
-		qreal right = std::numeric_limits<int>::min();
-		qreal top = std::numeric_limits<int>::max();
-		qreal bottom = std::numeric_limits<int>::min();
-
-		QDomElement piece = element.firstChildElement("piece");
-		while (!piece.isNull()) {
-			QDomElement line = piece.firstChildElement("line");
-			qreal x1, y1, x2, y2;
-			bool ok = false;
-			if (!line.isNull()) {
-				ok = MiscUtils::x1y1x2y2(line, x1, y1, x2, y2);
-			}
-			else {
-				QDomElement arc = piece.firstChildElement("arc");
-				if (!arc.isNull()) {
-					ok = getArcBounds(element, arc, x1, y1, x2, y2);
-				}
-			}
-
-			if (ok) {
-				left = qMin(left, qMin(x1, x2));
-				right = qMax(right, qMax(x1, x2));
-				top = qMin(top, qMin(y1, y2));
-				bottom = qMax(bottom, qMax(y1, y2));
-			}
-
-			piece = piece.nextSiblingElement("piece");
-		}
-
-		bounds.setCoords(left, top, right, bottom);
-		return bounds;
-	}
-
-	if (tagName.compare("rect") == 0) {
-		qreal x1, y1, x2, y2;
-		if (!MiscUtils::x1y1x2y2(element, x1, y1, x2, y2)) return bounds;
-
-		if (x2 < x1) {
-			qreal temp = x1;
-			x1 = x2;
-			x2 = temp;
-		}
-
-		if (y2 < y1) {
-			qreal temp = y1;
-			y1 = y2;
-			y2 = temp;
-		}
-
-		bounds.setCoords(x1, y1, x2, y2);
-		return bounds;
-	}
-
-	if (tagName.compare("polygon") == 0 ) {
-		qreal left = std::numeric_limits<int>::max();
-		qreal right = std::numeric_limits<int>::min();
-		qreal top = std::numeric_limits<int>::max();
-		qreal bottom = std::numeric_limits<int>::min();
-
-		QList<QDomElement> wires;
-		collectWires(element, wires, false);
-		bool gotOne = false;
-		foreach (QDomElement wire, wires) {
-			QRectF r = getPlainBounds(wire, layer);
-			if (!r.isNull()) {
-				left = qMin(left, r.left());
-				right = qMax(right, r.right());
-				top = qMin(top, r.top());
-				bottom = qMax(bottom, r.bottom());
-				gotOne = true;
-			}
+	foreach (const ModelPolygon & polygon, group->polygons) {
+		if (layer.isEmpty() || polygon.layer.compare(layer) == 0) {
+			extendDimensions(polygon.bounds, polygon.element, left, top, right, bottom, maxElement);
 		}
-		if (gotOne) {
-			bounds.setCoords(left, top, right, bottom);
-		}
-		return bounds;
 	}
-
-	if (tagName.compare("pad") == 0) {
-		bool ok = true;
-		qreal cx = MiscUtils::strToMil(element.attribute("x", ""), ok);
-		if (!ok) return bounds;
-
-		qreal cy =  MiscUtils::strToMil(element.attribute("y", ""), ok);
-		if (!ok) return bounds;
-
-		qreal diameter = 0;
-		QDomElement layer = element.firstChildElement("layer");
-		while (!layer.isNull()) {
-			qreal diameter = MiscUtils::strToMil(element.attribute("diameter", "0"), ok);
-			if (diameter != 0) break;
+	foreach (const ModelRect & rect, group->rects) {
+		if (layer.isEmpty() || rect.layer.compare(layer) == 0) {
+			extendDimensions(rect.bounds, rect.element, left, top, right, bottom, maxElement);
 		}
-
-		return QRectF(cx - (diameter / 2), cy - (diameter / 2), diameter, diameter);
-	}
-
-	if (tagName.compare("smd") == 0) {
-		bool ok = true;
-		qreal cx = MiscUtils::strToMil(element.attribute("x", ""), ok);
-		if (!ok) return bounds;
-
-		qreal cy =  MiscUtils::strToMil(element.attribute("y", ""), ok);
-		if (!ok) return bounds;
-
-		qreal w = MiscUtils::strToMil(element.attribute("dx", ""), ok);
-		if (!ok) return bounds;
-
-		qreal h = MiscUtils::strToMil(element.attribute("dy", ""), ok);
-		if (!ok) return bounds;
-
-		return QRectF(cx - (w / 2), cy - (h / 2), w, h);
 	}
 
-	if (tagName.compare("element") == 0) {
-		QDomElement maxElement;
-		getDimensions(element, maxElement, layer, false);
-		QDomElement package = element.firstChildElement("package");
-		if (!package.isNull()) {
-			getDimensions(package, maxElement, layer, false);
+	if (deep) {
+		foreach (int ix, group->contacts) {
+			const ModelPad & pad = m_model.pad(ix);
+			extendDimensions(pad.bounds, pad.element, left, top, right, bottom, maxElement);
 		}
-		return bounds;
 	}
 
-	qDebug() << "getPlainBounds missed tag" << tagName;
-	return bounds;
-}
-
-bool BrdApplication::getArcBounds(QDomElement wire, QDomElement arc, qreal & x1, qreal & y1, qreal & x2, qreal & y2)
-{
-	qreal ax1, ay1, ax2, ay2;
-	if (!MiscUtils::x1y1x2y2(arc, ax1, ay1, ax2, ay2)) return false;
-
-	qreal radius, width, angle1, angle2;
-	if (!MiscUtils::rwaa(arc, radius, width, angle1, angle2)) return false;
-
-	bool ok;
-	qreal xc = MiscUtils::strToMil(arc.attribute("xc", ""), ok);
-	if (!ok) return false;
-
-	qreal yc = MiscUtils::strToMil(arc.attribute("yc", ""), ok);
-	if (!ok) return false;
-
-	// from http://groups.google.com/group/comp.graphics.algorithms/browse_thread/thread/1adbcc734e44d024/79201c57a09149fe?lnk=gst&q=arc+bounding+box#79201c57a09149fe
-	// Assuming that the arc is the counterclockwise arc from s to e. 
-	// Precondition: 0 <= s < 360  and 0 <= e < 360 
-	if (angle2 < angle1) angle2 = angle2 + 360; 
-	x1 = qMin(ax1, ax2);
-	y1 = qMin(ay1, ay2);
-	x2 = qMax(ax1, ax2);
-	y2 = qMax(ay1, ay2);
-
-	if (angle2 > 90) { 
-		if (angle1 < 90) y2 = yc + radius; 
-		if (angle2 > 180) { 
-			if (angle1 < 180) x1 = xc - radius; 
-			if (angle2 > 270) { 
-				if (angle1 < 270) y1 = yc - radius; 
-				if (angle2 > 360) { 
-					x2 = xc + radius; 
-					if (angle2 > 450) { 
-						y2 = yc + radius; 
-						if (angle2 > 540) { 
-							x1 = xc - radius; 
-							if (angle2 > 630) y1 = yc - radius; 
-						} 
-					} 
-				} 
-			} 
-		} 
-	} 
-
-	return true;
+	return QRectF(left, top, right - left, bottom - top);
 }
 
 void BrdApplication::genXml(QDir & workingFolder, QDir & ulpDir, const QString & brdname, QDir & xmlFolder) {
@@ -988,7 +1395,105 @@ void BrdApplication::genXml(QDir & workingFolder, QDir & ulpDir, const QString &
 	}
 }
 
-QString BrdApplication::genParams(QDomElement & root, const QString & prefix) 
+bool BrdApplication::genNativeXml(QDir & brdFolder, const QString & brdname, QDir & xmlFolder) {
+	QFileInfo fileInfo(brdname);
+	QString targetname = xmlFolder.absoluteFilePath(fileInfo.completeBaseName() + ".xml");
+	if (QFile::exists(targetname)) return true;
+
+	BrdReader brdReader;
+	QDomDocument boardDoc;
+	QString errorStr;
+	if (!brdReader.translate(brdFolder.absoluteFilePath(brdname), boardDoc, errorStr)) {
+		message(QString("unable to read '%1' directly: %2").arg(brdname).arg(errorStr));
+		return false;
+	}
+
+	saveFile(boardDoc.toString(), targetname);
+	qDebug() << QString("wrote %1 xml").arg(brdname);
+	return true;
+}
+
+void BrdApplication::genXmlBatch(QDir & workingFolder, QDir & ulpDir, const QStringList & brdnames, QDir & xmlFolder) {
+	QDir brdFolder(workingFolder);
+	brdFolder.cd("brds");
+
+	QStringList stale;
+	foreach (QString brdname, brdnames) {
+		QFileInfo fileInfo(brdname);
+		if (QFile::exists(xmlFolder.absoluteFilePath(fileInfo.completeBaseName() + ".xml"))) continue;
+
+		stale << brdname;
+	}
+
+	if (stale.isEmpty()) return;
+
+	// one eagle session per job, each with its own script so they don't clobber each other
+	int sessions = qMin(m_jobs, stale.count());
+	QList<QStringList> scripts;
+	for (int i = 0; i < sessions; i++) {
+		scripts.append(QStringList());
+	}
+	for (int i = 0; i < stale.count(); i++) {
+		QFileInfo fileInfo(stale.at(i));
+		// note the single quotes around filenames--this is eagle's non-standard way of dealing with spaces
+		scripts[i % sessions] << QString("EDIT '%1';\nRUN '%3' '%2';\n")
+										.arg(brdFolder.absoluteFilePath(stale.at(i)))
+										.arg(xmlFolder.absoluteFilePath(fileInfo.completeBaseName() + ".xml"))
+										.arg(ulpDir.absoluteFilePath("brd2xml.ulp"));
+	}
+
+	QList<QProcess *> processes;
+	QStringList scriptPaths;
+	for (int i = 0; i < sessions; i++) {
+		QString scriptPath = workingFolder.absoluteFilePath(QString("brd2xml_%1.scr").arg(i));
+		QFile file(scriptPath);
+		file.remove();
+		if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+			qDebug() << "unable to open" << scriptPath;
+			continue;
+		}
+
+		QTextStream out(&file);
+		out << scripts.at(i).join("") << "QUIT;\n";
+		file.close();
+		scriptPaths << scriptPath;
+
+		QProcess * process = new QProcess;
+		process->setWorkingDirectory(brdFolder.absolutePath());
+		process->start(m_eaglePath, QStringList() << "-C" << QString("SCRIPT %1").arg(scriptPath) << "doesntexist.brd");
+		if (!process->waitForStarted()) {
+			qDebug() << QString("unable to start eagle session %1").arg(i);
+			delete process;
+			continue;
+		}
+
+		processes << process;
+	}
+
+	foreach (QProcess * process, processes) {
+		// a session exports many boards, so don't apply the default 30 second timeout
+		if (!process->waitForFinished(-1)) {
+			qDebug() << "unable to finish eagle session";
+		}
+		delete process;
+	}
+
+	foreach (QString scriptPath, scriptPaths) {
+		QFile::remove(scriptPath);
+	}
+
+	foreach (QString brdname, stale) {
+		QFileInfo fileInfo(brdname);
+		if (QFile::exists(xmlFolder.absoluteFilePath(fileInfo.completeBaseName() + ".xml"))) {
+			qDebug() << QString("wrote %1 xml").arg(brdname);
+		}
+		else {
+			qDebug() << QString("unable to export %1").arg(brdname);
+		}
+	}
+}
+
+QString BoardContext::genParams(QDomElement & root, const QString & prefix) 
 {
 	QString params = "<?xml version='1.0' encoding='UTF-8'?>\n";
 	params += QString("<board-params board='%1' include-vias='false' shrink-holes-factor='1.0' >\n").arg(prefix);
@@ -1105,7 +1610,7 @@ QString BrdApplication::genParams(QDomElement & root, const QString & prefix)
 	return params;
 }
 
-QString BrdApplication::genContact(QDomElement & contact) {
+QString BoardContext::genContact(QDomElement & contact) {
 	QString type;
 	QString signal = contact.attribute("signal");
 	if (!contact.firstChildElement("pad").isNull()) type = "pad";
@@ -1121,7 +1626,7 @@ QString BrdApplication::genContact(QDomElement & contact) {
 			;
 }
 
-QString BrdApplication::genFZP(QDomElement & root, QDomElement & paramsRoot, DifParam* difParam, const QString & prefix, const QString & connectorType, const QDir & descriptionsFolder) 
+QString BoardContext::genFZP(QDomElement & root, QDomElement & paramsRoot, DifParam* difParam, const QString & prefix, const QString & connectorType, const QDir & descriptionsFolder) 
 {
 	QString fzp = "<?xml version='1.0' encoding='UTF-8'?>\n";
 	fzp += QString("<module fritzingVersion='%2' moduleId='%1'>\n").arg(prefix).arg(FritzingVersion);
@@ -1418,14 +1923,14 @@ QString BrdApplication::genFZP(QDomElement & root, QDomElement & paramsRoot, Dif
 	return fzp;
 }
 
-void BrdApplication::replaceXY(QString & string) {
-	string.replace("cx=''", QString("cx='%1'").arg(m_cxLast - m_trueBounds.left()));
-	string.replace("cy=''", QString("cy='%1'").arg(flipy(m_cyLast)));
+void BoardContext::replaceXY(QString & string) {
+	string.replace("cx=''", QString("cx='%1'").arg(SvgWriter::formatNumber((m_cxLast - m_trueBounds.left()) * m_svgScale)));
+	string.replace("cy=''", QString("cy='%1'").arg(SvgWriter::formatNumber(flipy(m_cyLast) * m_svgScale)));
 }
 
-QString BrdApplication::genPCB(QDomElement & root, QDomElement & paramsRoot) {
+QString BoardContext::genPCB(QDomElement & root, QDomElement & paramsRoot) {
 
-	QString svg = TextUtils::makeSVGHeader(1000, 1000, m_trueBounds.width(), m_trueBounds.height());
+	QString svg = TextUtils::makeSVGHeader(1000, 1000 * m_svgScale, m_trueBounds.width(), m_trueBounds.height());
 	svg += "<desc>Fritzing footprint generated by brd2svg</desc>\n";
 	svg += "<g id='silkscreen'>\n";
 	svg += genMaxShape(root, paramsRoot, "none", "white", 8);
@@ -1433,46 +1938,46 @@ QString BrdApplication::genPCB(QDomElement & root, QDomElement & paramsRoot) {
 	qreal minArea = qMin(m_trueBounds.width() * m_trueBounds.height() / 16, MinPCBPackageArea);
 	genLayerElements(root, skipParams, svg, TopPlaceLayer, true, minArea, true, "#ffffff");   
 	QStringList noICs;
-    QHash<QString, QString> noSubparts;
 	FillStroke fs;
 	fs.fill = "none";
 	fs.fillOpacity = 1.0;
 	fs.stroke = "white";
 	fs.strokeWidth = 8;
-    genOverlaps(root, fs, fs, svg, true, noICs, noSubparts, false);
+    genOverlaps(root, fs, fs, svg, true, noICs, false);
 	svg += "</g>\n";
-	QString c1, c0;
-	genCopperElements(root, paramsRoot, c1, TopLayer, "#F7BD13", "pad", false);   
+	QList<CopperPad> c1, c0, none;
+	genCopperPads(root, paramsRoot, c1, TopLayer, "#F7BD13", "pad", false, none);   
 	if (!m_genericSMD) {
-		genCopperElements(root, paramsRoot, c0, BottomLayer, "#F7BD13", "pad", false);
+		genCopperPads(root, paramsRoot, c0, BottomLayer, "#F7BD13", "pad", false, c1);
 	}
+
+	QSet<QString> topKeys, bottomKeys, noSkip;
+	foreach (const CopperPad & copperPad, c1) topKeys.insert(copperPad.key);
+	foreach (const CopperPad & copperPad, c0) bottomKeys.insert(copperPad.key);
+
 	if (!c1.isEmpty() && !c0.isEmpty()) {
 		svg += "<g id='copper1'>\n";
-		// TODO: this could be a much more sophisticated comparison
-		if (c1.compare(c0) == 0) {
+		if (topKeys.contains(bottomKeys)) {
+			// every bottom pad is drawn the same on top, so copper1 only adds the pads the bottom lacks
+			appendCopper(svg, c1, bottomKeys);
 			svg += "<g id='copper0'>\n";
-			replaceXY(c1);
-			svg += c1;
+			appendCopper(svg, c0, noSkip);
 			svg += "</g>\n";
 		}
 		else {
-			replaceXY(c1);
-			replaceXY(c0);
-			svg += c1;
+			appendCopper(svg, c1, noSkip);
 			svg += "</g>\n";
 			svg += "<g id='copper0'>\n";
-			svg += c0;
+			appendCopper(svg, c0, noSkip);
 		}
 	}
 	else if (!c1.isEmpty()) {
 		svg += "<g id='copper1'>\n";
-		replaceXY(c1);
-		svg += c1;
+		appendCopper(svg, c1, noSkip);
 	}
 	else if (!c0.isEmpty()) {
 		svg += "<g id='copper0'>\n";
-		replaceXY(c0);
-		svg += c0;
+		appendCopper(svg, c0, noSkip);
 	}
 
 	svg += "</g>\n";
@@ -1488,7 +1993,7 @@ bool viasFirst(QDomElement & contact1, QDomElement & contact2)
 }
 
 
-QString BrdApplication::genGenericBreadboard(QDomElement & root, QDomElement & paramsRoot, DifParam * difParam, QDir & workingFolder) 
+QString BoardContext::genGenericBreadboard(QDomElement & root, QDomElement & paramsRoot, DifParam * difParam, QDir & workingFolder) 
 {
 	QString boardColor = "#1F7A34";
 
@@ -1526,9 +2031,9 @@ QString BrdApplication::genGenericBreadboard(QDomElement & root, QDomElement & p
 	return MiscUtils::makeGeneric(workingFolder, boardColor, powers, copper, getBoardName(root), innerChipRect.size(), innerChipRect.size(), getConnectorName, getConnectorIndex, false);
 }
 
-QString BrdApplication::genBreadboard(QDomElement & root, QDomElement & paramsRoot, DifParam * difParam, const QStringList & ICs, QHash<QString, QString> & subpartAliases) 
+QString BoardContext::genBreadboard(QDomElement & root, QDomElement & paramsRoot, DifParam * difParam, const QStringList & ICs) 
 {
-	QString svg = TextUtils::makeSVGHeader(1000, 1000, m_trueBounds.width(), m_trueBounds.height());
+	QString svg = TextUtils::makeSVGHeader(1000, 1000 * m_svgScale, m_trueBounds.width(), m_trueBounds.height());
 	svg += "<desc>Fritzing breadboard generated by brd2svg</desc>\n";
 	svg += "<g id='breadboard'>\n";
 	svg += "<g id='icon'>\n";						// make sure we can use this image for icon view
@@ -1577,24 +2082,23 @@ QString BrdApplication::genBreadboard(QDomElement & root, QDomElement & paramsRo
 	fs2.stroke = "none";
 	fs2.strokeWidth = 0;
 
-	genOverlaps(root, fs1, fs2, svg, false, ICs, subpartAliases, true);
+	genOverlaps(root, fs1, fs2, svg, false, ICs, true);
 	genCopperElements(root, paramsRoot, svg, TopLayer, "#9A916C", "pin", true);
 
 	svg += "</g>\n";
 	svg += "</g>\n";
 	svg += "</svg>\n";
 
-	addSubparts(root, paramsRoot, svg, subpartAliases);
+	addSubparts(root, paramsRoot, svg);
 	return svg;
 }
 
 
-void BrdApplication::addSubparts(QDomElement & root, QDomElement & paramsRoot, QString & svg, QHash<QString, QString> & subpartAliases)
+void BoardContext::addSubparts(QDomElement & root, QDomElement & paramsRoot, QString & svg)
 {
-	QDir subpartsFolder(m_fritzingSubpartsPath);
-	subpartsFolder.cd("breadboard");
-	if (!subpartsFolder.exists()) {
-		qDebug() << "subparts folder" << subpartsFolder.absolutePath() << "not found";
+	const SubpartIndex & subpartsIndex = m_run.breadboardSubparts;
+	if (!subpartsIndex.exists()) {
+		qDebug() << "subparts folder" << subpartsIndex.folderPath() << "not found";
 		return;
 	}
 
@@ -1603,7 +2107,7 @@ void BrdApplication::addSubparts(QDomElement & root, QDomElement & paramsRoot, Q
 	collectPackages(root, packages);
 	foreach (QDomElement package, packages) {
         QString name = package.attribute("name", "");
-        QString sname = findSubpart(name, subpartAliases, subpartsFolder);
+        QString sname = findSubpart(name, subpartsIndex);
 		if (!sname.isEmpty()) {
             qDebug() << "\tfound subpart (1)" << name << sname;
 			gotPackage = true;
@@ -1619,8 +2123,12 @@ void BrdApplication::addSubparts(QDomElement & root, QDomElement & paramsRoot, Q
 
 	if (!gotPackage && !gotIncludes) return;
 
-	QDomDocument doc;
-	TextUtils::mergeSvg(doc, svg, "breadboard");
+	// collect every subpart and include first, then splice them all into the board in one pass
+	QList<SubpartUse> subparts;
+	QList<QDomDocument> fragments;
+
+	// the subparts are scaled to match the board svg
+	qreal dpi = 1000 * m_svgScale;
 
 	if (gotPackage) {
 		foreach (QDomElement package, packages) {
@@ -1635,8 +2143,8 @@ void BrdApplication::addSubparts(QDomElement & root, QDomElement & paramsRoot, Q
 				if (nudge.attribute("package").compare(name, Qt::CaseInsensitive) == 0) {
 					QDomElement parent = package.parentNode().toElement();
 					if (parent.attribute("name").compare(nudge.attribute("element"), Qt::CaseInsensitive) == 0) {
-						offsetX = TextUtils::convertToInches(nudge.attribute("x", "0")) * 1000;
-						offsetY = TextUtils::convertToInches(nudge.attribute("y", "0")) * 1000;
+						offsetX = TextUtils::convertToInches(nudge.attribute("x", "0")) * dpi;
+						offsetY = TextUtils::convertToInches(nudge.attribute("y", "0")) * dpi;
 						if (!nudge.attribute("angle").isEmpty()) {
 							nudgeAngle = nudge.attribute("angle").toDouble();
 						}
@@ -1651,7 +2159,7 @@ void BrdApplication::addSubparts(QDomElement & root, QDomElement & paramsRoot, Q
 			if (!show) continue;
 
 			//qDebug() << subpartsFolder.absoluteFilePath(name + ".svg");
-			QString sname = findSubpart(name, subpartAliases, subpartsFolder);
+			QString sname = findSubpart(name, subpartsIndex);
 			if (sname.isEmpty()) continue;
 
             qDebug() << "\tfound subpart (2)" << name << sname;
@@ -1659,16 +2167,10 @@ void BrdApplication::addSubparts(QDomElement & root, QDomElement & paramsRoot, Q
 			qreal x1,y1,x2,y2;
 			if (!MiscUtils::x1y1x2y2(package, x1, y1, x2, y2)) continue;
 
-			SvgFileSplitter splitter;
-            QFile file(subpartsFolder.absoluteFilePath(sname + ".svg"));
-			if (!splitter.load(&file)) continue;
-
-            double factor;
-			splitter.normalize(1000, "", false, factor);
-
-			qreal sWidth, sHeight, vbWidth, vbHeight;
-			QDomDocument dd = splitter.domDocument();
-			TextUtils::getSvgSizes(dd, sWidth, sHeight, vbWidth, vbHeight);
+			SubpartUse use;
+			use.path = subpartsIndex.path(sname);
+			qreal sWidth, sHeight;
+			if (!SubpartCache::size(use.path, dpi, sWidth, sHeight)) continue;
 
 			bool ok = true;
 			qreal angle = package.parentNode().toElement().attribute("angle").toDouble(&ok);
@@ -1677,65 +2179,77 @@ void BrdApplication::addSubparts(QDomElement & root, QDomElement & paramsRoot, Q
 				ok = true;
 			}
 
-			qreal subx = (sWidth * 1000 / 2);
-			qreal suby =  (sHeight * 1000 / 2);
+			qreal subx = (sWidth * dpi / 2);
+			qreal suby =  (sHeight * dpi / 2);
 
 			if (angle != 0 && ok) {
 				QMatrix matrix;
 				matrix.translate(subx, suby);
 				matrix.rotate(angle);
 				matrix.translate(-subx, -suby);  
-				QHash<QString, QString> attributes;
-				attributes.insert("transform", TextUtils::svgMatrix(matrix));
-				splitter.gWrap(attributes);
+				SvgWrapper rotation;
+				rotation.insert("transform", TextUtils::svgMatrix(matrix));
+				use.wrappers.append(rotation);
 			}
 
-			QHash<QString, QString> attributes;
+			SvgWrapper attributes;
 			attributes.insert("id", TextUtils::escapeAnd(name));
 			attributes.insert("transform", QString("translate(%1,%2)")
-				.arg(((x2 + x1) / 2) - m_trueBounds.left() - subx + offsetX)  
-				.arg(flipy((y2 + y1) / 2)  - suby + offsetY) 
+				.arg((((x2 + x1) / 2) - m_trueBounds.left()) * m_svgScale - subx + offsetX)  
+				.arg(flipy((y2 + y1) / 2) * m_svgScale - suby + offsetY) 
 				);
 
-			splitter.gWrap(attributes);
-			TextUtils::mergeSvg(doc, splitter.toString(), "breadboard");
+			use.wrappers.append(attributes);
+			subparts.append(use);
 		}
 	}
 
 	while (gotIncludes && !include.isNull()) {
 		QString name = include.attribute("src");
         QFileInfo info(name);
+		// the board is out of date when an included svg changes, just like a subpart
+		if (!m_subparts.contains(name)) m_subparts << name;
 		qreal x = TextUtils::convertToInches(include.attribute("x"));
 		qreal y = TextUtils::convertToInches(include.attribute("y"));
-		includeSvg(doc, name, info.fileName(), 
-			(x * 1000) - m_trueBounds.left() + m_boardBounds.left(), 
-			(y * 1000) - m_trueBounds.top() + m_boardBounds.top());
+		fragments.append(includeSvg(name, info.fileName(), 
+			((x * 1000) - m_trueBounds.left() + m_boardBounds.left()) * m_svgScale, 
+			((y * 1000) - m_trueBounds.top() + m_boardBounds.top()) * m_svgScale);
 		include = include.nextSiblingElement("include");
 	}
 
+	QDomDocument doc;
+	TextUtils::mergeSvg(doc, svg, "breadboard");
+	QDomElement target = MiscUtils::mergeTarget(doc, "breadboard");
+	foreach (SubpartUse use, subparts) {
+		SubpartCache::splice(use.path, dpi, use.wrappers, target, "breadboard");
+	}
+	foreach (QDomDocument fragment, fragments) {
+		MiscUtils::spliceSvg(target, fragment, "breadboard");
+	}
+
 	svg = TextUtils::mergeSvgFinish(doc);
 }
 
-void BrdApplication::includeSvg(QDomDocument & doc, const QString & path, const QString & name, qreal x, qreal y) {
+QDomDocument BoardContext::includeSvg(const QString & path, const QString & name, qreal x, qreal y) {
 	QFile file(path);
 	if (!file.exists()) {
 		qDebug() << "file '" << path << "' not found.";
-		return;
+		return QDomDocument();
 	}
 
 	SvgFileSplitter splitter;
-	if (!splitter.load(&file)) return;
+	if (!splitter.load(&file)) return QDomDocument();
 
     double factor;
-	splitter.normalize(1000, "", false, factor);
+	splitter.normalize(1000 * m_svgScale, "", false, factor);
 	QHash<QString, QString> attributes;
 	attributes.insert("id", TextUtils::escapeAnd(name));
 	attributes.insert("transform", QString("translate(%1,%2)").arg(x).arg(y));
 	splitter.gWrap(attributes);
-	TextUtils::mergeSvg(doc, splitter.toString(), "breadboard");
+	return splitter.domDocument();
 }
 
-QString BrdApplication::genSchematic(QDomElement & root, QDomElement & paramsRoot, DifParam * difParam) 
+QString BoardContext::genSchematic(QDomElement & root, QDomElement & paramsRoot, DifParam * difParam) 
 {
 	QList<QDomElement> powers;
 	QList<QDomElement> grounds;
@@ -1765,7 +2279,7 @@ QString BrdApplication::genSchematic(QDomElement & root, QDomElement & paramsRoo
     return SchematicRectConstants::genSchematicDIP(powers, grounds, lefts, rights, vias, busNames, boardName, usingParam, m_genericSMD, getConnectorName);
 }
 
-QString BrdApplication::getBoardName(QDomElement & root) 
+QString BoardContext::getBoardName(QDomElement & root) 
 {
 	QDomElement title = root.firstChildElement("title");
 	QString boardName;
@@ -1774,7 +2288,7 @@ QString BrdApplication::getBoardName(QDomElement & root)
 	return fileInfo.completeBaseName();
 }
 
-void BrdApplication::getSides(QDomElement & root, QDomElement & paramsRoot, 
+void BoardContext::getSides(QDomElement & root, QDomElement & paramsRoot, 
 							QList<QDomElement> & powers, QList<QDomElement> & grounds, 
 							QList<QDomElement> & lefts, QList<QDomElement> & rights, 
 							QList<QDomElement> & unused, QList<QDomElement> & vias, 
@@ -1956,7 +2470,20 @@ void BrdApplication::getSides(QDomElement & root, QDomElement & paramsRoot,
 	} 
 }
 
-void BrdApplication::genCopperElements(QDomElement &root, QDomElement & paramsRoot, QString & svg, const QString & layerID, const QString & copperColor, const QString & padString, bool integrateVias) {
+void BoardContext::genCopperElements(QDomElement &root, QDomElement & paramsRoot, QString & svg, const QString & layerID, const QString & copperColor, const QString & padString, bool integrateVias) {
+	QList<CopperPad> copperPads, none;
+	genCopperPads(root, paramsRoot, copperPads, layerID, copperColor, padString, integrateVias, none);
+	foreach (const CopperPad & copperPad, copperPads) {
+		svg += copperPad.svg;
+	}
+}
+
+void BoardContext::genCopperPads(QDomElement &root, QDomElement & paramsRoot, QList<CopperPad> & copperPads, const QString & layerID, const QString & copperColor, const QString & padString, bool integrateVias, const QList<CopperPad> & otherLayer) {
+	QHash<QString, int> otherKeys;
+	for (int i = 0; i < otherLayer.count(); i++) {
+		otherKeys.insert(otherLayer.at(i).key, i);
+	}
+
 	QList<QDomElement> contacts;
 	QStringList busNames;
 	collectContacts(root, paramsRoot, contacts, busNames);
@@ -1969,11 +2496,73 @@ void BrdApplication::genCopperElements(QDomElement &root, QDomElement & paramsRo
 	foreach (QDomElement contact, contacts) {
 		if (!isUsed(contact)) continue;
 
-		genPad(contact, svg, layerID, copperColor, padString, integrateVias);
+		CopperPad copperPad;
+		copperPad.key = copperKey(contact, layerID);
+		int ix = otherKeys.value(copperPad.key, -1);
+		if (ix >= 0) {
+			// drawn the same on the other layer: reuse it, but keep the last pad center genPad() would have left
+			copperPad = otherLayer.at(ix);
+			if (copperPad.setsCenter) {
+				m_cxLast = copperPad.cx;
+				m_cyLast = copperPad.cy;
+			}
+		}
+		else {
+			genPad(contact, copperPad.svg, layerID, copperColor, padString, integrateVias);
+			copperPad.setsCenter = !contact.firstChildElement("pad").isNull();
+			copperPad.cx = m_cxLast;
+			copperPad.cy = m_cyLast;
+		}
+		if (copperPad.svg.isEmpty()) continue;
+
+		copperPads.append(copperPad);
+	}
+}
+
+QString BoardContext::copperKey(QDomElement & contact, const QString & layerID) {
+	// identifies what genPad() draws for the contact on the given layer
+	QString connectorIndex = contact.attribute("connectorIndex");
+	QDomElement pad = contact.firstChildElement("pad");
+	QString padLayer = layerID;
+	if (pad.isNull()) {
+		if (contact.tagName().compare("via") != 0) {
+			// smds don't depend on the layer
+			return QString("%1/%2/smd").arg(connectorIndex).arg(contact.firstChildElement("smd").attribute("padIndex"));
+		}
+
+		pad = contact;
+		padLayer = TopLayer;			// vias are always drawn from their top layer
+	}
+
+	QString key = QString("%1/%2").arg(connectorIndex).arg(pad.attribute("padIndex"));
+	const ModelPad * model = m_model.pad(pad);
+	if (model == NULL) return key;
+
+	foreach (const ModelPadLayer & layer, model->layers) {
+		if (layer.layer.compare(padLayer) == 0) {
+			return QString("%1/%2/%3/%4").arg(key).arg(layer.diameterOK).arg(layer.diameter, 0, 'g', 15).arg(layer.shape);
+		}
+	}
+
+	return key;
+}
+
+void BoardContext::appendCopper(QString & svg, const QList<CopperPad> & copperPads, const QSet<QString> & skip) {
+	foreach (const CopperPad & copperPad, copperPads) {
+		if (skip.contains(copperPad.key)) continue;
+
+		if (copperPad.svg.contains("cx=''")) {
+			QString string = copperPad.svg;
+			replaceXY(string);
+			svg += string;
+		}
+		else {
+			svg += copperPad.svg;
+		}
 	}
 }
 
-void BrdApplication::collectContacts(QDomElement & root, QDomElement & paramsRoot, QList<QDomElement> & contactsList, QStringList & busNames) {
+void BoardContext::collectContacts(QDomElement & root, QDomElement & paramsRoot, QList<QDomElement> & contactsList, QStringList & busNames) {
 	QList<QDomElement> packages;
 	collectPackages(root, packages);
 	foreach(QDomElement package, packages) {
@@ -2131,26 +2720,20 @@ void BrdApplication::collectContacts(QDomElement & root, QDomElement & paramsRoo
 	}
 }
 
-void BrdApplication::collectPackages(QDomElement &root, QList<QDomElement> & packages)
+void BoardContext::collectPackages(QDomElement &root, QList<QDomElement> & packages)
 {
-	QDomElement elements = root.firstChildElement("elements");
-	if (!elements.isNull()) {
-		QDomElement element = elements.firstChildElement("element");
-		while (!element.isNull()) {
-			QDomElement package = element.firstChildElement("package");
-			if (!package.isNull()) {
-				//QString name = package.attribute("name");
-				//qDebug() << name;
-				if (inBounds(package)) {
-					packages.append(package);
-				}
-			}
-			element = element.nextSiblingElement("element");
+	const ModelGroup * group = m_model.group(root);
+	if (group == NULL) return;
+
+	foreach (int ix, m_model.elementsNear(*group, m_trueBounds)) {
+		const ModelElement & element = m_model.element(ix);
+		if (inBounds(m_model.group(element.packageGroup))) {
+			packages.append(element.package);
 		}
 	}
 }
 
-void BrdApplication::collectConnectors(QDomElement &paramsRoot, QList<QDomElement> & connectorList, bool collectSpaces)
+void BoardContext::collectConnectors(QDomElement &paramsRoot, QList<QDomElement> & connectorList, bool collectSpaces)
 {
 	QDomElement connectors = paramsRoot.firstChildElement("connectors");
 	QDomElement lrtbu = connectors.firstChildElement();
@@ -2174,7 +2757,7 @@ void BrdApplication::collectConnectors(QDomElement &paramsRoot, QList<QDomElemen
 	}
 }
 
-void BrdApplication::collectFakeVias(QDomElement &paramsRoot, QList<QDomElement> & connectorList)
+void BoardContext::collectFakeVias(QDomElement &paramsRoot, QList<QDomElement> & connectorList)
 {
 	QDomElement fakeVias = paramsRoot.firstChildElement("fake-vias");
 	QDomElement connector = fakeVias.firstChildElement();
@@ -2184,34 +2767,25 @@ void BrdApplication::collectFakeVias(QDomElement &paramsRoot, QList<QDomElement>
 	}
 }
 
-void BrdApplication::genSmd(QDomElement & contact, QString & svg, const QString & layerID, const QString & copperColor, const QString & padString) 
+void BoardContext::genSmd(QDomElement & contact, QString & svg, const QString & layerID, const QString & copperColor, const QString & padString) 
 {
 	QDomElement smd = contact.firstChildElement("smd");
 	if (smd.isNull()) {
 		return; 
 	}
 
-	bool ok = true;
-	qreal cx = MiscUtils::strToMil(smd.attribute("x", ""), ok);
-	if (!ok) return;
-
-	qreal cy =  MiscUtils::strToMil(smd.attribute("y", ""), ok);
-	if (!ok) return;
-
-	qreal w = MiscUtils::strToMil(smd.attribute("dx", ""), ok);
-	if (!ok) return;
-
-	qreal h = MiscUtils::strToMil(smd.attribute("dy", ""), ok);
-	if (!ok) return;
-
-	qreal angle = smd.attribute("angle", "").toDouble(&ok);
-	if (!ok) return;
+	const ModelPad * model = m_model.pad(smd);
+	if (model == NULL || !model->smdOK) return;
 
-	qreal roundness = smd.attribute("roundness", "").toDouble(&ok);
-	if (!ok) return;
+	qreal cx = model->x;
+	qreal cy = model->y;
+	qreal w = model->dx;
+	qreal h = model->dy;
+	qreal angle = model->smdAngle;
+	qreal roundness = model->roundness;
 
-	qreal subx = cx - m_trueBounds.left();
-	qreal suby = flipy(cy);
+	qreal subx = (cx - m_trueBounds.left()) * m_svgScale;
+	qreal suby = flipy(cy) * m_svgScale;
 	if (angle != 0) {
 		QMatrix matrix;
 		matrix.translate(subx, suby);
@@ -2222,24 +2796,28 @@ void BrdApplication::genSmd(QDomElement & contact, QString & svg, const QString
 
 	qreal rx = qMin(w, h) * roundness / 200;			// the 200 is a magic figure that comes from eagle2svg.ulp
 	qreal ry = rx;										// want rounded rect, not full ellipse
-	QString rstring = (rx == 0 && ry == 0) ? "" : QString(" rx='%1' ry='%2' ").arg(rx).arg(ry);
-
-	svg += QString("<rect fill='%5' stroke='none' x='%1' y='%2' width='%3' height='%4' stroke-width='0' id='connector%6%7' %8/>\n")
-							.arg(cx - (w / 2) - m_trueBounds.left())
-							.arg(flipy(cy + (h / 2)))			
-							.arg(w)
-							.arg(h)
-							.arg(copperColor)
-							.arg(contact.attribute("connectorIndex"))
-							.arg(padString)
-							.arg(rstring);
+
+	SvgWriter writer(svg, m_svgScale);
+	writer.start("rect")
+		.attribute("fill", copperColor)
+		.attribute("stroke", "none")
+		.attribute("x", cx - (w / 2) - m_trueBounds.left())
+		.attribute("y", flipy(cy + (h / 2)))
+		.attribute("width", w)
+		.attribute("height", h)
+		.attribute("stroke-width", "0")
+		.startAttribute("id").raw("connector").raw(contact.attribute("connectorIndex")).raw(padString).endAttribute();
+	if (rx != 0 || ry != 0) {
+		writer.attribute("rx", rx).attribute("ry", ry);
+	}
+	writer.end();
 
 	if (angle != 0) {
 		svg += "</g>\n";
 	}
 }
 
-void BrdApplication::genPad(QDomElement & contact, QString & svg, const QString & layerID, const QString & copperColor, const QString & padString, bool integrateVias) 
+void BoardContext::genPad(QDomElement & contact, QString & svg, const QString & layerID, const QString & copperColor, const QString & padString, bool integrateVias) 
 {
 
 	QDomElement pad = contact.firstChildElement("pad");
@@ -2256,28 +2834,22 @@ void BrdApplication::genPad(QDomElement & contact, QString & svg, const QString
 	genSmd(contact, svg, layerID, copperColor, padString);
 }
 
-void BrdApplication::genPadAux(QDomElement & contact, QDomElement & pad, QString & svg, const QString & layerID, const QString & copperColor, const QString & padString, bool integrateVias) 
+void BoardContext::genPadAux(QDomElement & contact, QDomElement & pad, QString & svg, const QString & layerID, const QString & copperColor, const QString & padString, bool integrateVias) 
 {
-	QDomElement layer = pad.firstChildElement("layer");
-	while (!layer.isNull()) {
-		QString lid = layer.attribute("layer", "");
-		if (lid.compare(layerID) == 0) {
-			bool ok = true;
-			qreal cx = MiscUtils::strToMil(pad.attribute("x", ""), ok);
-			if (!ok) return;
-
-			qreal cy = MiscUtils::strToMil(pad.attribute("y", ""), ok);
-			if (!ok) return;
-
-			qreal drill = MiscUtils::strToMil(pad.attribute("drill", ""), ok);
-			if (!ok) return;
+	const ModelPad * model = m_model.pad(pad);
+	if (model == NULL) return;
 
-			qreal diameter = MiscUtils::strToMil(layer.attribute("diameter", ""), ok);
-			if (!ok) return;
+	foreach (const ModelPadLayer & layer, model->layers) {
+		if (layer.layer.compare(layerID) == 0) {
+			if (!model->holeOK) return;
+			if (!layer.diameterOK) return;
 
-			int elongation = layer.attribute("elongation", "0").toInt();
+			qreal cx = model->x;
+			qreal cy = model->y;
+			qreal drill = model->drill;
+			qreal diameter = layer.diameter;
 
-			QString shape = layer.attribute("shape", "");
+			const QString & shape = layer.shape;
 			if (shape.isEmpty()) return;
 
 			if (m_shrinkHolesFactor != 1) {
@@ -2294,56 +2866,62 @@ void BrdApplication::genPadAux(QDomElement & contact, QDomElement & pad, QString
 			else {
 				m_cxLast = cx;
 				m_cyLast = cy;
-				cxString = QString::number(cx - m_trueBounds.left());
-				cyString = QString::number(flipy(cy));
+				cxString = SvgWriter::formatNumber((cx - m_trueBounds.left()) * m_svgScale);
+				cyString = SvgWriter::formatNumber(flipy(cy) * m_svgScale);
 			}
 
 			qreal width = (diameter - drill) / 2;				// division by 2 doesn't make sense, but it's the closest I've gotten to the right size
 			qreal dr = (diameter / 2) - (width / 2);
 			// for the moment only draw circular pads
 
-			svg += QString("<circle fill='none' cx='%1' cy='%2' r='%3' stroke='%8' stroke-width='%4' id='connector%5%6' connectorname='%7'/>\n")
-				.arg(cxString)
-				.arg(cyString)
-				.arg(dr)
-				.arg(SW(width))
-				.arg(contact.attribute("connectorIndex"))
-				.arg(padString)
-				.arg(getConnectorName(pad))
-				.arg(copperColor);
+			SvgWriter writer(svg, m_svgScale);
+			writer.start("circle")
+				.attribute("fill", "none")
+				.attribute("cx", cxString)
+				.attribute("cy", cyString)
+				.attribute("r", dr)
+				.attribute("stroke", copperColor)
+				.attribute("stroke-width", width)
+				.startAttribute("id").raw("connector").raw(contact.attribute("connectorIndex")).raw(padString).endAttribute()
+				.attribute("connectorname", getConnectorName(pad))
+				.end();
 
 			if (shape == "square") {				
-				svg += QString("<rect fill='none' stroke='%6' x='%1' y='%2' width='%3' height='%4' stroke-width='%5' />\n")
-							.arg(cx - dr - m_trueBounds.left())
-							.arg(flipy(cy + dr))			// note "+ dr" rather than "- dr" because we flip all the y values
-							.arg(dr * 2)
-							.arg(dr * 2)
-							.arg(SW(width))
-							.arg(copperColor);
+				writer.start("rect")
+					.attribute("fill", "none")
+					.attribute("stroke", copperColor)
+					.attribute("x", cx - dr - m_trueBounds.left())
+					.attribute("y", flipy(cy + dr))			// note "+ dr" rather than "- dr" because we flip all the y values
+					.attribute("width", dr * 2)
+					.attribute("height", dr * 2)
+					.attribute("stroke-width", width)
+					.end();
 			}
 			else if (shape == "long") {
-				qreal angle = pad.attribute("angle", "0").toDouble();
+				qreal angle = model->angle;
 				qreal rx = dr * 2.3;
 				qreal ry = dr;
 				if (angle == 90 || angle == 270) {
 					rx = dr;
 					ry = dr * 2.3;
 				}
-				QString hole = genHole2(cx, cy, dr, 0);
-
-				svg += QString("<path stroke='none' stroke-width='0' d='m%1,%2 %3,0 0,%4 -%3,0 0,-%4%6' fill='%5' />\n")
-							.arg(cx - rx - m_trueBounds.left())
-							.arg(flipy(cy + ry))			// note "+ dr" rather than "- dr" because we flip all the y values
-							.arg(rx * 2)
-							.arg(ry * 2)
-							.arg(copperColor)
-							.arg(hole)
-							;
+				writer.start("path")
+					.attribute("stroke", "none")
+					.attribute("stroke-width", "0")
+					.startAttribute("d")
+						.raw("m").number(cx - rx - m_trueBounds.left())
+						.raw(",").number(flipy(cy + ry))			// note "+ dr" rather than "- dr" because we flip all the y values
+						.raw(" ").number(rx * 2).raw(",0 0,").number(ry * 2)
+						.raw(" -").number(rx * 2).raw(",0 0,-").number(ry * 2)
+						.raw(genHole2(cx, cy, dr, 0))
+						.endAttribute()
+					.attribute("fill", copperColor)
+					.end();
 			}
 			else if (shape == "offset") {
 				QString color = copperColor;
 				QRectF rect(cx - dr, cy + dr, dr * 2, dr * 2);  // note "+ dr" rather than "- dr" because we flip all the y values
-				int angle = pad.attribute("angle", "0").toDouble();
+				int angle = model->angle;
 				if (angle == 0) {
 					rect.setWidth(rect.width() + dr);
 				}
@@ -2363,110 +2941,131 @@ void BrdApplication::genPadAux(QDomElement & contact, QDomElement & pad, QString
 					return;
 				}
 				
-				QString hole = genHole2(cx, cy, dr, 0);
-				svg += QString("<path stroke='none' stroke-width='0' d='m%1,%2 %3,0 0,%4 -%3,0 0,-%4%6z' fill='%5' />\n")
-							.arg(rect.left() - m_trueBounds.left())
-							.arg(flipy(rect.top()))			// note "+ dr" rather than "- dr" because we flip all the y values
-							.arg(rect.width())
-							.arg(rect.height())
-							.arg(color)
-							.arg(hole)
-							;
+				writer.start("path")
+					.attribute("stroke", "none")
+					.attribute("stroke-width", "0")
+					.startAttribute("d")
+						.raw("m").number(rect.left() - m_trueBounds.left())
+						.raw(",").number(flipy(rect.top()))			// note "+ dr" rather than "- dr" because we flip all the y values
+						.raw(" ").number(rect.width()).raw(",0 0,").number(rect.height())
+						.raw(" -").number(rect.width()).raw(",0 0,-").number(rect.height())
+						.raw(genHole2(cx, cy, dr, 0))
+						.raw("z")
+						.endAttribute()
+					.attribute("fill", color)
+					.end();
 			}
 
 			return;
 		}
-		layer = layer.nextSiblingElement("layer");
 	}
 }
 
-void BrdApplication::genLayerElements(QDomElement &root, QDomElement &paramsRoot, QString & svg, const QString & layerID, bool skipText, qreal minArea, bool doFillings, const QString & textColor) {
-	QList<QDomElement> from;
-	from.append(root.firstChildElement("wires"));
-	from.append(root.firstChildElement("circles"));
-	from.append(root.firstChildElement("polygons"));
-	from.append(root.firstChildElement("rects"));
-	from.append(root.firstChildElement("texts"));
-
-	QList<QDomElement> to;
-	collectLayerElements(from, to, layerID);
+void BoardContext::genLayerElements(QDomElement &root, QDomElement &paramsRoot, QString & svg, const QString & layerID, bool skipText, qreal minArea, bool doFillings, const QString & textColor) {
+	const ModelGroup * group = m_model.group(root);
+	if (group == NULL) return;
 
-	addElements(root, to, minArea);
-
-	foreach (QDomElement element,  to) {
-		genLayerElement(paramsRoot, element, svg, layerID, skipText, minArea, doFillings, textColor);
-	}
-}
+	// with --simplify-tolerance, lines that join end to end are drawn as one simplified path
+	QList<ModelLine> run;
+	foreach (const ModelWire & wire, group->wires) {
+		if (!layerID.isEmpty() && wire.layer.compare(layerID) != 0) continue;
 
-void BrdApplication::addElements(QDomElement & root, QList<QDomElement> & to, qreal minArea) {
-	QDomElement elements = root.firstChildElement("elements");
-	if (!elements.isNull()) {
-		QDomElement element = elements.firstChildElement("element");
-		while (!element.isNull()) {
-			QDomElement package = element.firstChildElement("package");
-			if (!package.isNull()) {
-				if (inBounds(package) && bigEnough(package, minArea)) {
-					to.append(element);
+		foreach (const ModelPiece & piece, wire.pieces) {
+			if (piece.isArc) {
+				genLines(run, svg);
+				genArc(piece.arc, svg);
+			}
+			else if (m_run.simplifyTolerance > 0) {
+				ModelLine line = piece.line;
+				if (!run.isEmpty() && !joins(run.last(), line)) {
+					genLines(run, svg);
 				}
+				run.append(line);
 			}
 			else {
-				qDebug() << "element without package" << element.attribute("name", "");
+				genLine(piece.line, svg);
 			}
-			element = element.nextSiblingElement("element");
 		}
 	}
-}
+	genLines(run, svg);
+
+	foreach (const ModelCircle & circle, group->circles) {
+		if (!layerID.isEmpty() && circle.layer.compare(layerID) != 0) continue;
+
+		genCircle(circle, svg, false, "none", "white", 0);
+	}
+
+	bool hackfill = (layerID.compare(TopLayer) == 0) || (layerID.compare(BottomPlaceLayer) == 0);
+	foreach (const ModelPolygon & polygon, group->polygons) {
+		if (!layerID.isEmpty() && polygon.layer.compare(layerID) != 0) continue;
+
+		QDomElement element = polygon.element;
+		genPath(element, svg, hackfill ? "white" : "none", hackfill ? "none" : "white", doFillings);
+	}
+
+	foreach (const ModelRect & rect, group->rects) {
+		if (!layerID.isEmpty() && rect.layer.compare(layerID) != 0) continue;
+
+		genRect(rect, svg, false);
+	}
+
+	if (!skipText) {
+		foreach (const ModelText & text, group->texts) {
+			if (!layerID.isEmpty() && text.layer.compare(layerID) != 0) continue;
+
+			svg += QString("<g><title>text:%1</title>\n").arg(TextUtils::escapeAnd(text.text));
+			genText(text, svg, paramsRoot, textColor);
+			svg += QString("</g>\n");
+		}
+	}
 
+	foreach (int ix, m_model.elementsNear(*group, m_trueBounds)) {
+		const ModelElement & element = m_model.element(ix);
+		const ModelGroup & package = m_model.group(element.packageGroup);
+		if (inBounds(package) && bigEnough(package, minArea)) {
+			genLayerElement(paramsRoot, element, svg, layerID, skipText, minArea, doFillings, textColor);
+		}
+	}
+}
 
-void BrdApplication::genText(QDomElement & element, const QString & text, QString & svg, QDomElement & paramsRoot, const QString & textColor) 
+void BoardContext::genText(const ModelText & text, QString & svg, QDomElement & paramsRoot, const QString & textColor) 
 {
 	bool checkedWires = false;
-	QDomElement wires = element.firstChildElement("wires");
-	QDomElement wire = wires.firstChildElement("wire");
-	while (!wire.isNull()) {
+	foreach (const QLineF & line, text.wires) {
 		// ensure text is on board
-		qreal x1, y1, x2, y2;
-		MiscUtils::x1y1x2y2(wire, x1, y1, x2, y2);
-		if (x1 < m_boardBounds.left() || x1 > m_boardBounds.right()) return;
-		if (y1 < m_boardBounds.top() || y1 > m_boardBounds.bottom()) return;
-		if (x2 < m_boardBounds.left() || x2 > m_boardBounds.right()) return;
-		if (y2 < m_boardBounds.top() || y2 > m_boardBounds.bottom()) return;
+		if (line.x1() < m_boardBounds.left() || line.x1() > m_boardBounds.right()) return;
+		if (line.y1() < m_boardBounds.top() || line.y1() > m_boardBounds.bottom()) return;
+		if (line.x2() < m_boardBounds.left() || line.x2() > m_boardBounds.right()) return;
+		if (line.y2() < m_boardBounds.top() || line.y2() > m_boardBounds.bottom()) return;
 
 		checkedWires = true;
-		wire = wire.nextSiblingElement("wire");
 	}
 
-	bool ok = true;
-	qreal x = MiscUtils::strToMil(element.attribute("x", ""), ok);
-	if (!ok) return;
-
-	qreal y = MiscUtils::strToMil(element.attribute("y", ""), ok);
-	if (!ok) return;
+	if (!text.positionOK) return;
 
-	qreal width = MiscUtils::strToMil(element.attribute("width", ""), ok);
-	if (!ok) {
-		qDebug() << "text width not provided for" << text;
+	if (!text.widthOK) {
+		qDebug() << "text width not provided for" << text.text;
 		return;
 	}
 
-	qreal angle = element.attribute("angle", "").toDouble(&ok);
-	if (!ok) return;
-
-	int mirror = element.attribute("mirror", "").toInt(&ok);
-	if (!ok) return;
+	if (!text.restOK) return;
 
-	int spin = element.attribute("spin", "").toInt(&ok);
-	if (!ok) return;
-
-	qreal size = MiscUtils::strToMil(element.attribute("size", ""), ok);
-	if (!ok) return;
+	qreal x = text.x;
+	qreal y = text.y;
+	qreal width = text.width;
+	qreal angle = text.angle;
+	int mirror = text.mirror;
+	int spin = text.spin;
+	qreal size = text.size;
 
+	bool ok;
+	QDomElement element = text.element;
 	QString elementName;
 	QDomElement bb = paramsRoot.firstChildElement("breadboard");
 	QDomElement nudges = bb.firstChildElement("nudges");
 	QDomElement nudge = nudges.firstChildElement("nudge");
 	while (!nudge.isNull()) {
-		if (nudge.attribute("text").compare(text) == 0) {
+		if (nudge.attribute("text").compare(text.text) == 0) {
 			if (elementName.isEmpty()) {
 				QDomElement parent = element.parentNode().toElement();
 				while (!parent.isNull()) {
@@ -2524,245 +3123,239 @@ void BrdApplication::genText(QDomElement & element, const QString & text, QStrin
 	if (!checkedWires) {
 		QRectF r(x, y, width, size);
 		if (!m_boardBounds.contains(r)) {
-			//qDebug() << "clip text:" << text;
+			//qDebug() << "clip text:" << text.text;
 			return;
 		}
 	}
 
+	SvgWriter writer(svg, m_svgScale);
 	if (angle != 0) {
-		svg += QString("<g transform='translate(%1,%2)'><g transform='rotate(%3)'>\n")
-			.arg(x - m_trueBounds.left())
-			.arg(flipy(y))
-			.arg(angle);
+		writer.raw("<g transform='translate(").number(x - m_trueBounds.left())
+			.raw(",").number(flipy(y))
+			.raw(")'><g transform='rotate(").raw(SvgWriter::formatNumber(angle))
+			.raw(")'>\n");
 		x = m_trueBounds.left();
 		y = m_trueBounds.bottom();
 	}
-	svg += QString("<text font-family='OCRA' stroke='none' stroke-width='%6' fill='%7' font-size='%1' x='%2' y='%3' text-anchor='%4'>%5</text>\n")
-						.arg(size)
-						.arg(x - m_trueBounds.left())
-						.arg(flipy(y))
-						.arg(anchorAtStart ? "start" : "end")
-						.arg(TextUtils::escapeAnd(text))
-						.arg(0)  // SW(width)
-						.arg(textColor)
-					;
+	writer.start("text")
+		.attribute("font-family", "OCRA")
+		.attribute("stroke", "none")
+		.attribute("stroke-width", "0")  // SW(width)
+		.attribute("fill", textColor)
+		.attribute("font-size", size)
+		.attribute("x", x - m_trueBounds.left())
+		.attribute("y", flipy(y))
+		.attribute("text-anchor", anchorAtStart ? "start" : "end")
+		.endStart()
+		.text(text.text)
+		.close("text");
 	if (angle != 0) {
-		svg += "</g></g>\n";
+		writer.raw("</g></g>\n");
 	}
 }
 
-
-void BrdApplication::genLayerElement(QDomElement & paramsRoot, QDomElement & element, QString & svg, const QString & layerID, bool skipText, qreal minArea, bool doFillings, const QString & textColor) 
+void BoardContext::genLayerElement(QDomElement & paramsRoot, const ModelElement & modelElement, QString & svg, const QString & layerID, bool skipText, qreal minArea, bool doFillings, const QString & textColor) 
 {
-	QString tagName = element.tagName();
-
-	if (tagName.compare("circle") == 0) {
-		genCircle(element, svg, false, "none", "white", 0);
-		return;
-	}
-
-	if (tagName.compare("rect") == 0) {
-		genRect(element, svg, false);
-		return;
-	}
-
-	if (tagName.compare("wire") == 0) {
-		QDomElement piece = element.firstChildElement("piece");
-		while (!piece.isNull()) {
-			QDomElement line = piece.firstChildElement("line");
-			if (!line.isNull()) {
-				genLine(line, svg);
-			}
-			else {
-				QDomElement arc = piece.firstChildElement("arc");
-				if (!arc.isNull()) {
-					genArc(arc, svg);
-				}
-			}
-
-			piece = piece.nextSiblingElement("piece");
-		}
-		return;
-	}
-
-	if (tagName.compare("polygon") == 0 ) {
-		bool hackfill = (layerID.compare(TopLayer) == 0) || (layerID.compare(BottomPlaceLayer) == 0);
-		genPath(element, svg, hackfill ? "white" : "none", hackfill ? "none" : "white", doFillings);
-		return;
-	}
-
-	if (tagName.compare("text") == 0) {
-		if (skipText) return;
-
-		QString t;
-		TextUtils::findText(element, t);
-		svg += QString("<g><title>text:%1</title>\n").arg(TextUtils::escapeAnd(t));
-		QDomElement child = element.firstChildElement("wires");
-		if (!child.isNull() && false) {
-			genPath(element, svg, "none", "white", doFillings);
-		}
-		else {
-			genText(element, t, svg, paramsRoot, textColor);
-		}
-		svg += QString("</g>\n");
-		
-		return;
-	}
-
-	if (tagName.compare("element") == 0) {
-		QString elementName = element.attribute("name", "");
-		QDomElement package = element.firstChildElement("package");
-		QString packageName = package.attribute("name", "");
-		if (!package.isNull()) {		
-			QDomElement bb = paramsRoot.firstChildElement("breadboard");
-			QDomElement nudges = bb.firstChildElement("nudges");
-			QDomElement nudge = nudges.firstChildElement("nudge");
-			while (!nudge.isNull()) {
-				if (nudge.attribute("package").compare(packageName, Qt::CaseInsensitive) == 0 && 
-					nudge.attribute("element").compare(elementName, Qt::CaseInsensitive) == 0) 
-				{
-					if (nudge.attribute("lines").compare("no") == 0) {
-						// don't draw the layer element
-						return;
-					}
-					break;
-				}
-					
-				nudge = nudge.nextSiblingElement("nudge");
+	const QString & elementName = modelElement.name;
+	const QString & packageName = modelElement.packageName;
+	QDomElement bb = paramsRoot.firstChildElement("breadboard");
+	QDomElement nudges = bb.firstChildElement("nudges");
+	QDomElement nudge = nudges.firstChildElement("nudge");
+	while (!nudge.isNull()) {
+		if (nudge.attribute("package").compare(packageName, Qt::CaseInsensitive) == 0 && 
+			nudge.attribute("element").compare(elementName, Qt::CaseInsensitive) == 0) 
+		{
+			if (nudge.attribute("lines").compare("no") == 0) {
+				// don't draw the layer element
+				return;
 			}
+			break;
 		}
-
-		svg += QString("<g><title>element:%1</title>\n").arg(TextUtils::escapeAnd(elementName));
-		QDomElement skipParams;
-		genLayerElements(element, paramsRoot, svg, layerID, skipText, minArea, doFillings, textColor);
-		if (!package.isNull()) {
-			svg += QString("<g><title>package:%1</title>\n").arg(TextUtils::escapeAnd(packageName));
-			genLayerElements(package, paramsRoot, svg, layerID, skipText, minArea, doFillings, textColor);
-			svg += QString("</g>\n");
-		}
-		svg += QString("</g>\n");
-		return;
+			
+		nudge = nudge.nextSiblingElement("nudge");
 	}
 
-	qDebug() << "unknown layer element" << tagName;
+	svg += QString("<g><title>element:%1</title>\n").arg(TextUtils::escapeAnd(elementName));
+	QDomElement element = modelElement.element;
+	genLayerElements(element, paramsRoot, svg, layerID, skipText, minArea, doFillings, textColor);
+	svg += QString("<g><title>package:%1</title>\n").arg(TextUtils::escapeAnd(packageName));
+	QDomElement package = modelElement.package;
+	genLayerElements(package, paramsRoot, svg, layerID, skipText, minArea, doFillings, textColor);
+	svg += QString("</g>\n");
+	svg += QString("</g>\n");
 }
 
-void BrdApplication::genCircle(QDomElement & element, QString & svg, bool forDimension, const QString & fill, const QString & stroke, qreal strokeWidth) 
+void BoardContext::genCircle(const ModelCircle & circle, QString & svg, bool forDimension, const QString & fill, const QString & stroke, qreal strokeWidth) 
 {
-	qreal cx, cy, radius, width;
-	if (!cxcyrw(element, cx, cy, radius, width)) return;
+	if (!circle.ok) return;
 
 	if (strokeWidth <= 0) {
-		strokeWidth = width;
+		strokeWidth = circle.width;
 	}
 
 	qreal dr = (forDimension) ? strokeWidth / 2 : 0;
 
-	svg += QString("<circle fill='%5' cx='%1' cy='%2' r='%3' stroke='%6' stroke-width='%4' />\n")
-				.arg(cx - m_trueBounds.left())
-				.arg(flipy(cy))
-				.arg(radius - dr)
-				.arg(SW(strokeWidth))
-				.arg(fill)
-				.arg(stroke);
+	SvgWriter(svg, m_svgScale).start("circle")
+		.attribute("fill", fill)
+		.attribute("cx", circle.cx - m_trueBounds.left())
+		.attribute("cy", flipy(circle.cy))
+		.attribute("r", circle.radius - dr)
+		.attribute("stroke", stroke)
+		.attribute("stroke-width", strokeWidth)
+		.end();
 }
 
-void BrdApplication::genRect(QDomElement & element, QString & svg, bool forDimension) 
+void BoardContext::genRect(const ModelRect & rect, QString & svg, bool forDimension) 
 {
 	// TODO: handle rotation
-	qreal x1, y1, x2, y2;
-	if (!MiscUtils::x1y1x2y2(element, x1, y1, x2, y2)) return;
+	if (!rect.coordsOK) return;
 
+	qreal x1 = rect.x1;
+	qreal y1 = rect.y1;
+	qreal x2 = rect.x2;
+	qreal y2 = rect.y2;
 	if (!forDimension) {
 		if (!inBounds(x1, y1, x2, y2)) return;
 	}
 
-	bool ok = true;
-	qreal width = 0;
-	qreal temp = MiscUtils::strToMil(element.attribute("width", ""), ok);
-	if (ok) width = temp;
-
+	qreal width = rect.width;
 	qreal dr = (forDimension) ? width / 2 : 0;
-	QString stroke = "white";
-	QString fill = "none";
+	const char * stroke = "white";
+	const char * fill = "none";
 	if (width == 0) {
 		stroke = "none";
 		fill = "white";
 	}
 
-	svg += QString("<rect x='%1' y='%2' width='%3' height='%4' stroke-width='%5' fill='%6' stroke='%7' />\n")
-				.arg(x1 + dr - m_trueBounds.left())
-				.arg(flipy(y1 + dr))
-				.arg(x2 - x1 - dr - dr)
-				.arg(y2 - y1 - dr - dr)
-				.arg(SW(width))
-				.arg(fill)
-				.arg(stroke);
+	SvgWriter(svg, m_svgScale).start("rect")
+		.attribute("x", x1 + dr - m_trueBounds.left())
+		.attribute("y", flipy(y1 + dr))
+		.attribute("width", x2 - x1 - dr - dr)
+		.attribute("height", y2 - y1 - dr - dr)
+		.attribute("stroke-width", width)
+		.attribute("fill", fill)
+		.attribute("stroke", stroke)
+		.end();
 }
 
-void BrdApplication::genLine(QDomElement & element, QString & svg) 
+void BoardContext::genLine(const ModelLine & line, QString & svg) 
 {
-	qreal x1, y1, x2, y2;
-	if (!MiscUtils::x1y1x2y2(element, x1, y1, x2, y2)) return;
-
-	if (!inBounds(x1, y1, x2, y2)) return;
+	if (!line.coordsOK) return;
 
-	bool ok = true;
-	qreal width = MiscUtils::strToMil(element.attribute("width", ""), ok);
-	if (!ok) return;
+	if (!inBounds(line.x1, line.y1, line.x2, line.y2)) return;
 
-	int cap = element.attribute("cap", "1").toInt();
+	if (!line.widthOK) return;
 
-	svg += QString("<line stroke='white' x1='%1' y1='%2' x2='%3' y2='%4' stroke-width='%5' stroke-linecap='%6' />\n")
-				.arg(x1 - m_trueBounds.left())
-				.arg(flipy(y1))
-				.arg(x2 - m_trueBounds.left())
-				.arg(flipy(y2))
-				.arg(SW(width))
-				.arg((cap == 0) ? "butt" : "round");  
+	SvgWriter(svg, m_svgScale).start("line")
+		.attribute("stroke", "white")
+		.attribute("x1", line.x1 - m_trueBounds.left())
+		.attribute("y1", flipy(line.y1))
+		.attribute("x2", line.x2 - m_trueBounds.left())
+		.attribute("y2", flipy(line.y2))
+		.attribute("stroke-width", line.width)
+		.attribute("stroke-linecap", (line.cap == 0) ? "butt" : "round")
+		.end();
 }
 
+bool BoardContext::joins(const ModelLine & previous, ModelLine & line)
+{
+	if (!previous.coordsOK || !previous.widthOK || !line.coordsOK || !line.widthOK) return false;
+	if (previous.width != line.width || previous.cap != line.cap) return false;
+	if (!inBounds(previous.x1, previous.y1, previous.x2, previous.y2)) return false;
+	if (!inBounds(line.x1, line.y1, line.x2, line.y2)) return false;
+
+	if (line.x2 == previous.x2 && line.y2 == previous.y2) {
+		qSwap(line.x1, line.x2);
+		qSwap(line.y1, line.y2);
+	}
+	return line.x1 == previous.x2 && line.y1 == previous.y2;
+}
 
-void BrdApplication::genArc(QDomElement & element, QString & svg) 
+void BoardContext::genLines(QList<ModelLine> & run, QString & svg)
 {
-	qreal x1, y1, x2, y2;
-	if (!MiscUtils::x1y1x2y2(element, x1, y1, x2, y2)) return;
-	if (!inBounds(x1, y1, x2, y2)) return;
+	if (run.count() == 1) {
+		genLine(run.first(), svg);
+	}
+	else if (run.count() > 1) {
+		QVector<QPointF> points;
+		points.append(QPointF(run.first().x1, run.first().y1));
+		foreach (const ModelLine & line, run) {
+			points.append(QPointF(line.x2, line.y2));
+		}
+
+		QVector<int> kept = MiscUtils::simplifyPolyline(points, m_run.simplifyTolerance);
+		m_segmentsRemoved += run.count() - (kept.count() - 1);
+
+		QString d;
+		QPointF pen;
+		SvgWriter(d, m_svgScale).raw("M").absolute(points.first().x() - m_trueBounds.left(), flipy(points.first().y()), pen);
+		for (int i = 1; i < kept.count(); i++) {
+			const QPointF & p = points.at(kept.at(i));
+			SvgWriter(d, m_svgScale).raw(SvgWriter::command('L')).point(p.x() - m_trueBounds.left(), flipy(p.y()), pen);
+		}
 
-	qreal radius, width, angle1, angle2;
-	if (!MiscUtils::rwaa(element, radius, width, angle1, angle2)) return;
+		bool round = (run.first().cap != 0);
+		SvgWriter(svg, m_svgScale).start("path")
+			.attribute("stroke", "white")
+			.attribute("fill", "none")
+			.attribute("stroke-width", run.first().width)
+			.attribute("stroke-linecap", round ? "round" : "butt")
+			.attribute("stroke-linejoin", round ? "round" : "miter")
+			.attribute("d", d)
+			.end();
+	}
+
+	run.clear();
+}
 
-	svg += QString("<path fill='none' stroke='white' d='M%1,%2 A%3,%3 0 %4 0 %5,%6' stroke-width='%7'/>\n")
-				.arg(x1 - m_trueBounds.left())
-				.arg(flipy(y1))
-				.arg(radius)
-				.arg((qAbs(angle2 - angle1) < 180.0) ? 0 : 1)
-				.arg(x2 - m_trueBounds.left())
-				.arg(flipy(y2))
-				.arg(SW(width));
+void BoardContext::genArc(const ModelArc & arc, QString & svg) 
+{
+	if (!arc.coordsOK) return;
+	if (!inBounds(arc.x1, arc.y1, arc.x2, arc.y2)) return;
+
+	if (!arc.rwaaOK) return;
+
+	SvgWriter(svg, m_svgScale).start("path")
+		.attribute("fill", "none")
+		.attribute("stroke", "white")
+		.startAttribute("d")
+			.raw("M").number(arc.x1 - m_trueBounds.left())
+			.raw(",").number(flipy(arc.y1))
+			.raw(" A").number(arc.radius).raw(",").number(arc.radius)
+			.raw((qAbs(arc.angle2 - arc.angle1) < 180.0) ? " 0 0 0 " : " 0 1 0 ")
+			.number(arc.x2 - m_trueBounds.left())
+			.raw(",").number(flipy(arc.y2))
+			.endAttribute()
+		.attribute("stroke-width", arc.width)
+		.end();
 }
 
-qreal BrdApplication::flipy(qreal y) {
+qreal BoardContext::flipy(qreal y) {
 	return m_trueBounds.height() - (y - m_trueBounds.top());
 }
 
-bool BrdApplication::inBounds(QDomElement & package) {
-	qreal x1, y1, x2, y2;
-	if (!MiscUtils::x1y1x2y2(package, x1, y1, x2, y2)) return false;
+bool BoardContext::inBounds(QDomElement & package) {
+	const ModelGroup * group = m_model.group(package);
+	if (group == NULL) return false;
 
-	return inBounds(x1, y1, x2, y2);
+	return inBounds(*group);
 }
 
-bool BrdApplication::bigEnough(QDomElement & package, qreal minArea) {
+bool BoardContext::inBounds(const ModelGroup & package) {
+	if (!package.areaOK) return false;
+
+	return inBounds(package.x1, package.y1, package.x2, package.y2);
+}
+
+bool BoardContext::bigEnough(const ModelGroup & package, qreal minArea) {
 	if (minArea <= 0) return true;
 
-	qreal x1, y1, x2, y2;
-	if (!MiscUtils::x1y1x2y2(package, x1, y1, x2, y2)) return false;
+	if (!package.areaOK) return false;
 
-	return qAbs(x2 - x1) * qAbs(y2 - y1) >= minArea;
+	return qAbs(package.x2 - package.x1) * qAbs(package.y2 - package.y1) >= minArea;
 }
 
-bool BrdApplication::inBounds(qreal x1, qreal y1, qreal x2, qreal y2) {
+bool BoardContext::inBounds(qreal x1, qreal y1, qreal x2, qreal y2) {
 
 	if (m_trueBounds.contains(QPointF(x1, y1))) {
 		return true;
@@ -2787,7 +3380,7 @@ bool BrdApplication::inBounds(qreal x1, qreal y1, qreal x2, qreal y2) {
 	return false;
 }
 
-void BrdApplication::genPath(QDomElement & element, QString & svg, const QString & fillArg, const QString & stroke, bool doFillings) {
+void BoardContext::genPath(QDomElement & element, QString & svg, const QString & fillArg, const QString & stroke, bool doFillings) {
 
 	svg += QString("<g><title>polygon</title>\n");
 
@@ -2812,7 +3405,7 @@ void BrdApplication::genPath(QDomElement & element, QString & svg, const QString
 	}
 
 	svg += QString("<path stroke-linecap='round' stroke-width='%1' fill='%2' stroke='%3' d='")
-		.arg(SW(width))
+		.arg(SW(width * m_svgScale))
 		.arg(fill)
 		.arg(stroke);
 	svg += path;
@@ -2820,20 +3413,25 @@ void BrdApplication::genPath(QDomElement & element, QString & svg, const QString
 	svg += QString("</g>\n");
 }
 
-QString BrdApplication::genPolyString(QList<WireTree *> & wireTrees, QDomElement & element, qreal & width) 
+QString BoardContext::genPolyString(QList<WireTree *> & wireTrees, QDomElement & element, qreal & width) 
 {
 	bool ok;
 	width = MiscUtils::strToMil(element.attribute("width", ""), ok);
 	bool needsWidth = !ok;
 	QString path;
+	QPointF pen;
 
+	// walk the loop first, so runs of straight wires can be simplified before they are written
+	QList<WireTree *> units;
+	QVector<QPointF> ends;
+	QVector<qreal> drs;
 	WireTree * current = NULL;
 	WireTree * first = NULL;
 	while (wireTrees.count() > 0) {
 		if (current == NULL) {
 			first = current = wireTrees.first();
 			QPointF p(current->x1, current->y1);
-			path += QString("M%1,%2").arg(p.x() - m_trueBounds.left()).arg(flipy(p.y()));
+			SvgWriter(path, m_svgScale).raw("M").absolute(p.x() - m_trueBounds.left(), flipy(p.y()), pen);
 		}
 
 		if (needsWidth) {
@@ -2841,11 +3439,9 @@ QString BrdApplication::genPolyString(QList<WireTree *> & wireTrees, QDomElement
 			needsWidth = !ok;
 		}
 
-		qreal dr = width / 2;
-
-		QPointF p(current->x2, current->y2);
-		path += addPathUnit(current, p, dr);
-
+		units.append(current);
+		ends.append(QPointF(current->x2, current->y2));
+		drs.append(width / 2);
 
 		WireTree * next = current->right;
 		if (next == first) break;
@@ -2861,31 +3457,60 @@ QString BrdApplication::genPolyString(QList<WireTree *> & wireTrees, QDomElement
 		current = next;
 	}
 
+	int i = 0;
+	while (i < units.count()) {
+		if (units.at(i)->curve != 0 || m_run.simplifyTolerance <= 0) {
+			path += addPathUnit(units.at(i), ends.at(i), drs.at(i), pen);
+			i++;
+			continue;
+		}
+
+		// a run of straight wires; the arcs on either side keep their ends
+		int j = i;
+		QVector<QPointF> points;
+		points.append((i == 0) ? QPointF(first->x1, first->y1) : ends.at(i - 1));
+		while (j < units.count() && units.at(j)->curve == 0) {
+			points.append(ends.at(j++));
+		}
+
+		QVector<int> kept = MiscUtils::simplifyPolyline(points, m_run.simplifyTolerance);
+		m_segmentsRemoved += (j - i) - (kept.count() - 1);
+		for (int k = 1; k < kept.count(); k++) {
+			int unit = i + kept.at(k) - 1;
+			path += addPathUnit(units.at(unit), ends.at(unit), drs.at(unit), pen);
+		}
+		i = j;
+	}
+
 	return path;
 }
 
-QString BrdApplication::addPathUnit(WireTree * wireTree, QPointF p, qreal rDelta) 
+QString BoardContext::addPathUnit(WireTree * wireTree, QPointF p, qreal rDelta, QPointF & pen) 
 {
+	QString unit;
+	SvgWriter writer(unit, m_svgScale);
 	if (wireTree->curve == 0) {
-		return QString("L%1,%2\n").arg(p.x() - m_trueBounds.left()).arg(flipy(p.y()));
+		writer.raw(SvgWriter::command('L')).point(p.x() - m_trueBounds.left(), flipy(p.y()), pen).raw("\n");
+		return unit;
 	}
 
-	return QString("A%1,%1 0 %2 %3 %4,%5\n")
-						.arg(wireTree->radius - rDelta)
-						.arg((qAbs(wireTree->angle2 - wireTree->angle1) < 180.0) ? 0 : 1)
-						.arg(wireTree->sweep)
-						.arg(p.x() - m_trueBounds.left())
-						.arg(flipy(p.y())
-					);
+	qreal r = wireTree->radius - rDelta;
+	writer.raw(SvgWriter::command('A')).number(r).raw(",").number(r)
+		.raw((qAbs(wireTree->angle2 - wireTree->angle1) < 180.0) ? " 0 0 " : " 0 1 ")
+		.raw(SvgWriter::formatNumber(wireTree->sweep))
+		.raw(" ").point(p.x() - m_trueBounds.left(), flipy(p.y()), pen)
+		.raw("\n");
+	return unit;
 }
 
-QString BrdApplication::genPolyString(QList<QDomElement> & wires, QDomElement & element, qreal & width) 
+QString BoardContext::genPolyString(QList<QDomElement> & wires, QDomElement & element, qreal & width) 
 {
 	bool ok;
 	width = MiscUtils::strToMil(element.attribute("width", ""), ok);
 	bool needsWidth = !ok;
 
 	QString path;
+	QPointF pen;
 
 	foreach (QDomElement wire, wires) {
 		if (needsWidth) {
@@ -2898,7 +3523,10 @@ QString BrdApplication::genPolyString(QList<QDomElement> & wires, QDomElement &
 			QDomElement line = piece.firstChildElement("line");
 			if (!line.isNull()) {
 				if (MiscUtils::x1y1x2y2(line, x1, y1, x2, y2)) {
-					path += QString("M%1,%2L%3,%4\n").arg(x1 - m_trueBounds.left()).arg(flipy(y1)).arg(x2 - m_trueBounds.left()).arg(flipy(y2));
+					SvgWriter(path, m_svgScale)
+						.raw("M").absolute(x1 - m_trueBounds.left(), flipy(y1), pen)
+						.raw(SvgWriter::command('L')).point(x2 - m_trueBounds.left(), flipy(y2), pen)
+						.raw("\n");
 				}
 			}
 			else {
@@ -2906,13 +3534,12 @@ QString BrdApplication::genPolyString(QList<QDomElement> & wires, QDomElement &
 				if (!arc.isNull()) {
 					qreal radius, width, angle1, angle2;
 					if (MiscUtils::x1y1x2y2(line, x1, y1, x2, y2) && MiscUtils::rwaa(element, radius, width, angle1, angle2)) {
-						path += QString("M%1,%2 A%3,%3 0 %4 0 %5,%6\n")
-										.arg(x1 - m_trueBounds.left())
-										.arg(flipy(y1))
-										.arg(radius)
-										.arg((qAbs(angle2 - angle1) < 180.0) ? 0 : 1)
-										.arg(x2 - m_trueBounds.left())
-										.arg(flipy(y2));
+						SvgWriter(path, m_svgScale)
+							.raw("M").absolute(x1 - m_trueBounds.left(), flipy(y1), pen)
+							.raw(" ").raw(SvgWriter::command('A')).number(radius).raw(",").number(radius)
+							.raw((qAbs(angle2 - angle1) < 180.0) ? " 0 0 0 " : " 0 1 0 ")
+							.point(x2 - m_trueBounds.left(), flipy(y2), pen)
+							.raw("\n");
 					}
 				}				
 			}
@@ -2924,7 +3551,7 @@ QString BrdApplication::genPolyString(QList<QDomElement> & wires, QDomElement &
 	return path;
 }
 
-void BrdApplication::collectWires(QDomElement & element, QList<QDomElement> & wiresList, bool useFillings) {
+void BoardContext::collectWires(QDomElement & element, QList<QDomElement> & wiresList, bool useFillings) {
 	QDomElement contours = element.firstChildElement("contours");
 	if (contours.isNull()) {
 		// wires from text
@@ -2968,7 +3595,7 @@ bool cxcyrw(QDomElement & element, qreal & cx, qreal & cy, qreal & radius, qreal
 	return ok;
 }
 
-void BrdApplication::collectPadSmdPackages(QDomElement & root, QList<QDomElement> & padSmdPackages) {
+void BoardContext::collectPadSmdPackages(QDomElement & root, QList<QDomElement> & padSmdPackages) {
 	QList<QDomElement> packages;
 	collectPackages(root, packages);
 	foreach(QDomElement package, packages) {
@@ -2978,28 +3605,16 @@ void BrdApplication::collectPadSmdPackages(QDomElement & root, QList<QDomElement
 			continue;
 		}
 
-		QDomElement contacts = package.firstChildElement("contacts");
-		QDomElement contact = contacts.firstChildElement("contact");
-		bool hasContact = false;
-		while (!contact.isNull()) {
-			if (!contact.firstChildElement("pad").isNull()) {
-				hasContact = true;
-				break;
-			}
-			else if (!contact.firstChildElement("smd").isNull()) {
-				hasContact = true;
-				break;
-			}
-			contact = contact.nextSiblingElement("contact");
-		}
-		if (hasContact) {
+		// the model only keeps contacts with a pad or smd
+		const ModelGroup * group = m_model.group(package);
+		if (group != NULL && !group->contacts.isEmpty()) {
 			padSmdPackages.append(package);
 		}
 	}
 }
 
 
-bool BrdApplication::polyFromWires(QDomElement & root, const QString & boardColor, const QString & stroke, qreal strokeWidth, QString & svg, bool & clockwise) {
+bool BoardContext::polyFromWires(QDomElement & root, const QString & boardColor, const QString & stroke, qreal strokeWidth, QString & svg, bool & clockwise) {
 	// note path is not closed here
 	
 	bool noStroke = stroke.compare("none") == 0;
@@ -3021,7 +3636,7 @@ bool BrdApplication::polyFromWires(QDomElement & root, const QString & boardColo
 		return false;
 	}
 
-	QString path = QString("<path fill='%1' stroke='%2' stroke-width='%3' d='").arg(boardColor).arg(stroke).arg(SW(strokeWidth));
+	QString path = QString("<path fill='%1' stroke='%2' stroke-width='%3' d='").arg(boardColor).arg(stroke).arg(SW(strokeWidth * m_svgScale));
 	WireTree * first = wireTrees.first();
 	WireTree * current = first;
 	QMatrix matrix;
@@ -3034,12 +3649,13 @@ bool BrdApplication::polyFromWires(QDomElement & root, const QString & boardColo
 	}
 	QPointF p(current->x1, current->y1);
 	QPointF q = matrix.map(p);
-	path += QString("M%1,%2").arg(q.x() - m_trueBounds.left()).arg(flipy(q.y()));
+	QPointF pen;
+	SvgWriter(path, m_svgScale).raw("M").absolute(q.x() - m_trueBounds.left(), flipy(q.y()), pen);
 	bool firstTime = true;
 	while (true) {
 		QPointF p(current->x2, current->y2);
 		QPointF q = matrix.map(p);
-		path += addPathUnit(current, q, dr);
+		path += addPathUnit(current, q, dr, pen);
 
 		WireTree * next = current->right;
 		if (next == first) break;
@@ -3069,7 +3685,7 @@ bool BrdApplication::polyFromWires(QDomElement & root, const QString & boardColo
 	return true;
 }
 
-QString BrdApplication::genMaxShape(QDomElement & root, QDomElement & paramsRoot, const QString & boardColor, const QString & stroke, qreal strokeWidth) 
+QString BoardContext::genMaxShape(QDomElement & root, QDomElement & paramsRoot, const QString & boardColor, const QString & stroke, qreal strokeWidth) 
 {
 	QString path;
 	bool noStroke = stroke.compare("none") == 0;
@@ -3089,14 +3705,18 @@ QString BrdApplication::genMaxShape(QDomElement & root, QDomElement & paramsRoot
 			}
 
 			// counterclockwise
-			path = QString("<path fill='%1' stroke='%2' stroke-width='%3' d='M%4,%5a%6,%6 0 1 0 %7,0 %6,%6 0 1 0 -%7,0z\n")
-				.arg(boardColor)
-				.arg(stroke)
-				.arg(SW(strokeWidth))
-				.arg(cx - m_trueBounds.left() - radius)
-				.arg(flipy(cy))
-				.arg(radius)
-				.arg(2 * radius);
+			SvgWriter(path, m_svgScale).start("path")
+				.attribute("fill", boardColor)
+				.attribute("stroke", stroke)
+				.attribute("stroke-width", strokeWidth)
+				.startAttribute("d")
+				.raw("M").number(cx - m_trueBounds.left() - radius)
+				.raw(",").number(flipy(cy))
+				.raw("a").number(radius).raw(",").number(radius)
+				.raw(" 0 1 0 ").number(2 * radius)
+				.raw(",0 ").number(radius).raw(",").number(radius)
+				.raw(" 0 1 0 -").number(2 * radius)
+				.raw(",0z\n");
 
 			//qDebug() << "max shape is circle";
 			gotMaxShape = true;
@@ -3114,14 +3734,19 @@ QString BrdApplication::genMaxShape(QDomElement & root, QDomElement & paramsRoot
 		clockwise = true;
 		//qDebug() << "max shape is rect";
 		qreal dr = noStroke ? 0 : strokeWidth / 2;
-		path = QString("<path fill='%1' stroke='%2' stroke-width='%3' d='M%4,%5l%6,0 0,%7 -%6,0 0,-%7z\n")
-				.arg(boardColor)
-				.arg(stroke)
-				.arg(SW(strokeWidth))
-				.arg(m_boardBounds.left() - m_trueBounds.left() + dr)
-				.arg(m_boardBounds.top() - m_trueBounds.top() + dr)
-				.arg(m_boardBounds.width() - dr - dr)
-				.arg(m_boardBounds.height() -dr - dr);
+		path.clear();
+		SvgWriter(path, m_svgScale).start("path")
+			.attribute("fill", boardColor)
+			.attribute("stroke", stroke)
+			.attribute("stroke-width", strokeWidth)
+			.startAttribute("d")
+			.raw("M").number(m_boardBounds.left() - m_trueBounds.left() + dr)
+			.raw(",").number(m_boardBounds.top() - m_trueBounds.top() + dr)
+			.raw("l").number(m_boardBounds.width() - dr - dr)
+			.raw(",0 0,").number(m_boardBounds.height() - dr - dr)
+			.raw(" -").number(m_boardBounds.width() - dr - dr)
+			.raw(",0 0,-").number(m_boardBounds.height() - dr - dr)
+			.raw("z\n");
 	}
 
 	QDomNodeList nodeList = root.elementsByTagName("hole");
@@ -3159,27 +3784,40 @@ QString BrdApplication::genMaxShape(QDomElement & root, QDomElement & paramsRoot
 	return path;
 }
 
-void BrdApplication::genOverlaps(QDomElement & root, const FillStroke & fsNormal, const FillStroke & fsIC, 
-									QString & svg, bool offBoardOnly, const QStringList & ICs, QHash<QString, QString> & subpartAliases, bool includeSubparts) 
+void BoardContext::overlapLine(QString & svg, qreal x1, qreal y1, qreal x2, qreal y2, const FillStroke & fs) 
+{
+	SvgWriter(svg, m_svgScale).start("line")
+		.attribute("x1", x1 - m_trueBounds.left())
+		.attribute("y1", flipy(y1))
+		.attribute("x2", x2 - m_trueBounds.left())
+		.attribute("y2", flipy(y2))
+		.attribute("fill", fs.fill)
+		.attribute("fill-opacity", SvgWriter::formatNumber(fs.fillOpacity))
+		.attribute("stroke", fs.stroke)
+		.attribute("stroke-width", fs.strokeWidth)
+		.end();
+}
+
+void BoardContext::genOverlaps(QDomElement & root, const FillStroke & fsNormal, const FillStroke & fsIC, 
+									QString & svg, bool offBoardOnly, const QStringList & ICs, bool includeSubparts) 
 {
-	QDir subpartsFolder(m_fritzingSubpartsPath);
 
 	QList<QDomElement> padSmdPackages;
 	collectPadSmdPackages(root, padSmdPackages);
 	foreach (QDomElement package, padSmdPackages) {
 		QString packageName = package.attribute("name", "").toLower();
 		if (!offBoardOnly && includeSubparts) {
-            QString sname = findSubpart(packageName, subpartAliases, subpartsFolder);
+            QString sname = findSubpart(packageName, m_run.subparts);
 			if (!sname.isEmpty()) {
                 qDebug() << "\tfound subpart (3)" << packageName << sname;
                 continue;									// package will be drawn as a subpart
             }
 		}
 
-		qreal x1, y1, x2, y2;
-		if (!MiscUtils::x1y1x2y2(package, x1, y1, x2, y2)) continue;
+		const ModelGroup * group = m_model.group(package);
+		if (group == NULL || !group->areaOK) continue;
 		
-		QRectF overlap(x1, y1, x2 - x1, y2 - y1);
+		QRectF overlap(group->x1, group->y1, group->x2 - group->x1, group->y2 - group->y1);
 		bool offBoard = !m_boardBounds.contains(overlap);
 		if (offBoardOnly && !offBoard) continue;
 
@@ -3250,27 +3888,17 @@ void BrdApplication::genOverlaps(QDomElement & root, const FillStroke & fsNormal
 			r.setTop(qMax(m_trueBounds.top() + dr, r.top()));
 			r.setBottom(qMin(m_trueBounds.bottom() - dr, r.bottom()));
 
-			QString lineString = QString("<line x1='%1' y1='%2' x2='%3' y2='%4' fill='%5' fill-opacity='%6' stroke='%7' stroke-width='%8' />\n");
-
 			if (drawTop) {
-				svg += lineString
-					.arg(r.left() - m_trueBounds.left()).arg(flipy(r.top())).arg(r.right() - m_trueBounds.left()).arg(flipy(r.top()))
-					.arg(fsNormal.fill).arg(fsNormal.fillOpacity) .arg(fsNormal.stroke) .arg(SW(fsNormal.strokeWidth));
+				overlapLine(svg, r.left(), r.top(), r.right(), r.top(), fsNormal);
 			}
 			if (drawBottom) {
-				svg += lineString
-					.arg(r.left() - m_trueBounds.left()).arg(flipy(r.bottom())).arg(r.right() - m_trueBounds.left()).arg(flipy(r.bottom()))
-					.arg(fsNormal.fill).arg(fsNormal.fillOpacity) .arg(fsNormal.stroke) .arg(SW(fsNormal.strokeWidth));
+				overlapLine(svg, r.left(), r.bottom(), r.right(), r.bottom(), fsNormal);
 			}
 			if (drawLeft) {
-				svg += lineString
-					.arg(r.left() - m_trueBounds.left()).arg(flipy(r.top())).arg(r.left() - m_trueBounds.left()).arg(flipy(r.bottom()))
-					.arg(fsNormal.fill).arg(fsNormal.fillOpacity) .arg(fsNormal.stroke) .arg(SW(fsNormal.strokeWidth));
+				overlapLine(svg, r.left(), r.top(), r.left(), r.bottom(), fsNormal);
 			}
 			if (drawRight) {
-				svg += lineString
-					.arg(r.right() - m_trueBounds.left()).arg(flipy(r.top())).arg(r.right() - m_trueBounds.left()).arg(flipy(r.bottom()))
-					.arg(fsNormal.fill).arg(fsNormal.fillOpacity) .arg(fsNormal.stroke) .arg(SW(fsNormal.strokeWidth));
+				overlapLine(svg, r.right(), r.top(), r.right(), r.bottom(), fsNormal);
 			}
 
 			continue;
@@ -3288,74 +3916,70 @@ void BrdApplication::genOverlaps(QDomElement & root, const FillStroke & fsNormal
 		}
 
 		double angle = package.parentNode().toElement().attribute("angle", "0").toDouble();
+		SvgWriter writer(svg, m_svgScale);
 		if ((qRound(angle) / 45) % 2 == 1) {
-			QString points = QString("%1,%2, %3,%4 %5,%2 %3,%6")
-					.arg(r.left() - m_trueBounds.left())
-					.arg(flipy(r.center().y()))
-					.arg(r.center().x() - m_trueBounds.left())
-					.arg(flipy(r.top()))
-					.arg(r.right() - m_trueBounds.left())
-					.arg(flipy(r.bottom()))
-					;
-			svg += QString("<polygon fill='%1' fill-opacity='%2' stroke='%3' stroke-width='%4' points='%5' />\n")
-					.arg(fs->fill)
-					.arg(fs->fillOpacity)
-					.arg(fs->stroke)
-					.arg(SW(fs->strokeWidth))
-					.arg(points)
-					;	
+			writer.start("polygon")
+				.attribute("fill", fs->fill)
+				.attribute("fill-opacity", SvgWriter::formatNumber(fs->fillOpacity))
+				.attribute("stroke", fs->stroke)
+				.attribute("stroke-width", fs->strokeWidth)
+				.startAttribute("points")
+					.number(r.left() - m_trueBounds.left()).raw(",").number(flipy(r.center().y()))
+					.raw(", ").number(r.center().x() - m_trueBounds.left()).raw(",").number(flipy(r.top()))
+					.raw(" ").number(r.right() - m_trueBounds.left()).raw(",").number(flipy(r.center().y()))
+					.raw(" ").number(r.center().x() - m_trueBounds.left()).raw(",").number(flipy(r.bottom()))
+					.endAttribute()
+				.end();
 		}
 		else {
-			svg += QString("<rect x='%1' y='%2' width='%3' height='%4' fill='%5' fill-opacity='%6' stroke='%7' stroke-width='%8' />\n")
-					.arg(r.left() - m_trueBounds.left())
-					.arg(y)
-					.arg(r.width())
-					.arg(r.height())
-					.arg(fs->fill)
-					.arg(fs->fillOpacity)
-					.arg(fs->stroke)
-					.arg(SW(fs->strokeWidth))
-					;	
+			writer.start("rect")
+				.attribute("x", r.left() - m_trueBounds.left())
+				.attribute("y", y)
+				.attribute("width", r.width())
+				.attribute("height", r.height())
+				.attribute("fill", fs->fill)
+				.attribute("fill-opacity", SvgWriter::formatNumber(fs->fillOpacity))
+				.attribute("stroke", fs->stroke)
+				.attribute("stroke-width", fs->strokeWidth)
+				.end();
 		}
 	}
 }
 
-bool BrdApplication::isUsed(QDomElement & contact) {
+bool BoardContext::isUsed(QDomElement & contact) {
 	return (contact.attribute("used", "0").compare("1") == 0);
 }
 
-bool BrdApplication::isBus(QDomElement & contact) {
+bool BoardContext::isBus(QDomElement & contact) {
 	return (contact.attribute("bus", "0").compare("1") == 0);
 }
 
-QString BrdApplication::genHole2(qreal cx, qreal cy, qreal r, int sweepFlag)
+QString BoardContext::genHole2(qreal cx, qreal cy, qreal r, int sweepFlag)
 {
-	return QString("M%1,%2a%3,%3 0 1 %5 %4,0 %3,%3 0 1 %5 -%4,0z\n")
-				.arg(cx - m_trueBounds.left() - r)
-				.arg(flipy(cy))
-				.arg(r)
-				.arg(2 * r)
-				.arg(sweepFlag);
+	QString hole;
+	const char * flags = (sweepFlag == 0) ? " 0 1 0 " : " 0 1 1 ";
+	SvgWriter(hole, m_svgScale)
+		.raw("M").number(cx - m_trueBounds.left() - r)
+		.raw(",").number(flipy(cy))
+		.raw("a").number(r).raw(",").number(r)
+		.raw(flags).number(2 * r)
+		.raw(",0 ").number(r).raw(",").number(r)
+		.raw(flags).raw("-").number(2 * r)
+		.raw(",0z\n");
+	return hole;
 }
 
-QString BrdApplication::genHole(QDomElement hole, qreal inset, bool clockwise) {
-	bool ok;
-	qreal x = MiscUtils::strToMil(hole.attribute("x", ""), ok);
-	if (!ok) return "";
-
-	qreal y = MiscUtils::strToMil(hole.attribute("y", ""), ok);
-	if (!ok) return "";
-
-	qreal drill = MiscUtils::strToMil(hole.attribute("drill", ""), ok);
-	if (!ok) return "";
+QString BoardContext::genHole(QDomElement hole, qreal inset, bool clockwise) {
+	const ModelPad * model = m_model.pad(hole);
+	if (model == NULL || !model->holeOK) return "";
 
-	drill *= m_shrinkHolesFactor;
+	qreal drill = model->drill * m_shrinkHolesFactor;
 
 	qreal radius = (drill / 2.0) - inset;
 
 	int sweepflag = clockwise ? 1 : 0;
 
-	return genHole2(x, y, radius, sweepflag);
+	return genHole2(model->x, model->y, radius, sweepflag);
 }
 
 void BrdApplication::loadDifParams(QDir & workingFolder, QHash<QString, DifParam *> & difParams)
@@ -3561,7 +4185,7 @@ void BrdApplication::loadDifParams(QDir & workingFolder, QHash<QString, DifParam
 }
 
 
-QString BrdApplication::loadDescription(const QString & prefix, const QString & url, const QDir & descriptionsFolder) 
+QString BoardContext::loadDescription(const QString & prefix, const QString & url, const QDir & descriptionsFolder) 
 {
 	QFile file(descriptionsFolder.absoluteFilePath(prefix + ".txt"));
 	if (file.open(QIODevice::ReadOnly)) {
@@ -3572,12 +4196,13 @@ QString BrdApplication::loadDescription(const QString & prefix, const QString &
 	if (url.isEmpty()) return "";
 
 	if (m_networkAccessManager == NULL) {
-		m_networkAccessManager = new QNetworkAccessManager(this);
+		// no parent: the manager must live and die on the thread converting this board
+		m_networkAccessManager = new QNetworkAccessManager();
 	}
 
 	// execute an event loop to process the request (nearly-synchronous)
 	QEventLoop eventLoop;
-	connect(m_networkAccessManager, SIGNAL(finished(QNetworkReply *)), &eventLoop, SLOT(quit()));
+	QObject::connect(m_networkAccessManager, SIGNAL(finished(QNetworkReply *)), &eventLoop, SLOT(quit()));
 
 	QNetworkReply * reply = m_networkAccessManager->get(QNetworkRequest(QUrl(url + ".json")));
 
@@ -3608,11 +4233,11 @@ QString BrdApplication::loadDescription(const QString & prefix, const QString &
 
 	textString = descr;
 
-	saveFile(textString, descriptionsFolder.absoluteFilePath(prefix + ".txt"));
+	BrdApplication::saveFile(textString, descriptionsFolder.absoluteFilePath(prefix + ".txt"));
 	return textString;
 }
 
-QString BrdApplication::translateBoardColor(const QString & color)
+QString BoardContext::translateBoardColor(const QString & color)
 {
 	QHash<QString,QString> colors;
 	colors.insert("blue", "#147390");
@@ -3624,7 +4249,7 @@ QString BrdApplication::translateBoardColor(const QString & color)
 	return colors.value(color, color);
 }
 
-bool BrdApplication::match(QDomElement & contact, QDomElement & connector, bool doDebug)
+bool BoardContext::match(QDomElement & contact, QDomElement & connector, bool doDebug)
 {
 	QDomElement parent = contact.parentNode().toElement();
 	while (!parent.isNull()) {
@@ -3665,7 +4290,7 @@ bool BrdApplication::match(QDomElement & contact, QDomElement & connector, bool
 }
 
 
-bool BrdApplication::matchAnd(QDomElement & contact, QDomElement & connector) {
+bool BoardContext::matchAnd(QDomElement & contact, QDomElement & connector) {
 	if (match(contact, connector, false)) return true;
 
 	if (connector.tagName().compare("via") != 0) return false;
@@ -3674,21 +4299,13 @@ bool BrdApplication::matchAnd(QDomElement & contact, QDomElement & connector) {
 	return (connector.attribute("signal").compare(contact.attribute("signal")) == 0);
 }
 
-QString BrdApplication::findSubpart(const QString & name, QHash<QString, QString> & subpartAliases, QDir & subpartsFolder) {
-	QFile file(subpartsFolder.absoluteFilePath(name + ".svg"));
-	if (file.exists()) {
-        return name;
-	}
-
-    QString aname = subpartAliases.value(name.toLower(), "");
-    if (aname.isEmpty()) return "";
-
-    QFile file2(subpartsFolder.absoluteFilePath(aname + ".svg"));
-	if (file2.exists()) {
-        return aname;
-	}
+QString BoardContext::findSubpart(const QString & name, const SubpartIndex & subpartsIndex) {
+	QString sname = subpartsIndex.find(name);
+	if (sname.isEmpty()) return "";
 
-    return "";
+	QString path = subpartsIndex.path(sname);
+	if (!m_subparts.contains(path)) m_subparts << path;
+    return sname;
 }
 
 bool BrdApplication::registerFonts() {
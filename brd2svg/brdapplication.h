@@ -6,9 +6,15 @@
 #include <QRectF>
 #include <QDir>
 #include <QHash>
+#include <QSet>
 #include <QNetworkAccessManager>
 #include <QNetworkReply>
 
+#include "boardmodel.h"
+#include "subpartcache.h"
+#include "subpartindex.h"
+#include "zipwriter.h"
+
 struct FillStroke {
 	QString fill;
 	qreal fillOpacity;
@@ -16,43 +22,141 @@ struct FillStroke {
 	qreal strokeWidth;
 };
 
+// what one contact draws on one copper layer
+struct CopperPad {
+	QString key;			// connector, pad and the pad's shape on the layer
+	QString svg;
+	bool setsCenter;		// a through-hole pad, which moves m_cxLast/m_cyLast
+	qreal cx;
+	qreal cy;
+};
+
+struct SubpartUse {
+	QString path;
+	QList<SvgWrapper> wrappers;		// innermost first
+};
+
+struct CachedDimensions {
+	QRectF bounds;
+	QDomElement maxElement;
+};
+
 class BrdApplication : public QApplication
 {
 public:
     BrdApplication(int &argc, char **argv[]);
     void start();
 
+	static void message(const QString &);
+	static void saveFile(const QString & content, const QString & path);
+
 protected:
     void usage();
-    void message(const QString &);
     bool initArguments();
+	void genBin(QStringList & fileList, const QString & title, const QString & binPath);
+	void genXml(QDir & brdFolder, QDir & ulpFolder, const QString & brdname, QDir & xmlFolder);
+	bool genNativeXml(QDir & brdFolder, const QString & brdname, QDir & xmlFolder);
+	void genXmlBatch(QDir & brdFolder, QDir & ulpFolder, const QStringList & brdnames, QDir & xmlFolder);
+	void loadDifParams(QDir & workingFolder, QHash<QString, class DifParam *> & csvParams);
+    bool registerFonts();
+	QString commonInputsHash(const QString & allPackagesPath, const struct BoardRun &);
+	QString boardInputsHash(const QString & brdname, const QString & brdHash, const struct BoardRun &, const QStringList & subparts, const QString & commonHash);
+	bool outputsExist(const QString & brdname, const struct BoardRun &);
+
+protected:
+    QString m_workingPath;
+    QString m_andPath;
+    QString m_eaglePath;
+    QString m_fritzingSubpartsPath;
+	bool m_genericSMD;
+	bool m_batchXml;
+	bool m_nativeReader;
+	QString m_core;
+	int m_jobs;
+	bool m_benchmarkNumbers;
+	bool m_verifySvg;
+	bool m_dumpSubpartsIndex;
+	bool m_fzpz;
+	bool m_fzpzArchive;
+	bool m_fsync;
+	qreal m_simplifyTolerance;
+};
+
+// read-only state shared by every board converted in one run
+struct BoardRun {
+	QString workingPath;
+	QString xmlPath;
+	QString paramsPath;
+	QString descriptionsPath;
+	QString fzpPath;
+	QString breadboardPath;
+	QString schematicPath;
+	QString pcbPath;
+	bool genericSMD;
+	bool verifySvg;
+	bool fzpz;							// one .fzpz per board instead of the parts folders
+	bool fzpzArchive;					// and keep the bundles for the run's .fzbz
+	QString fzpzPath;
+	qreal simplifyTolerance;			// mils; 0 leaves silkscreen and polygon paths as they are
+	QHash<QString, class DifParam *> difParams;
+	QStringList ICs;
+	SubpartIndex subparts;					// the -s folder
+	SubpartIndex breadboardSubparts;		// its breadboard folder
+};
+
+struct BoardResult {
+	bool converted;
+	QStringList packageNames;
+	QStringList subparts;
+	QList<ZipEntry> bundle;				// only kept for the .fzbz
+	QStringList outputs;				// the part files, checked for failed writes before the board goes in the manifest
+};
+
+// everything that changes while converting a single board, so boards can be converted in parallel
+class BoardContext
+{
+public:
+	BoardContext(const BoardRun &);
+	~BoardContext();
+
+	bool convert(const QString & brdname, QStringList & packageNames);
+	const QStringList & subparts() const;
+	const QList<ZipEntry> & bundle() const;
+	const QStringList & outputs() const;
+
+protected:
 	QRectF getDimensions(QDomElement & root, QDomElement & maxElement, const QString & layer, bool deep);
-	QRectF getPlainBounds(QDomElement & root, const QString & layer);
+	QRectF calcDimensions(QDomElement & root, QDomElement & maxElement, const QString & layer, bool deep);
+	QString normalizeSvg(const QString & svg);
+	void verifySvg(const QString & direct, const QString & svg1000, const QString & name);
+	void saveOutput(const QString & content, const QString & folderPath, const QString & filename, const QString & bundleName);
 	QString genPCB(QDomElement & root, QDomElement & paramsRoot);
 	QString genSchematic(QDomElement & root, QDomElement & paramsRoot, class DifParam *);
-	QString genBreadboard(QDomElement & root, QDomElement & paramsRoot, class DifParam *, const QStringList & ICs, QHash<QString, QString> & subpartAliases);
+	QString genBreadboard(QDomElement & root, QDomElement & paramsRoot, class DifParam *, const QStringList & ICs);
 	QString genGenericBreadboard(QDomElement & root, QDomElement & paramsRoot, class DifParam *, QDir & brdFolder);
 	QString genFZP(QDomElement & root, QDomElement & paramsRoot, class DifParam *, const QString & prefix, const QString & connectorType, const QDir & descrsFolder);
 	QString genParams(QDomElement & root, const QString & prefix); 
-	void genBin(QStringList & fileList, const QString & title, const QString & binPath);
-	void genXml(QDir & brdFolder, QDir & ulpFolder, const QString & brdname, QDir & xmlFolder);
-	void collectLayerElements(QList<QDomElement> & from, QList<QDomElement> & to, const QString & layerID);
 	void genLayerElements(QDomElement &root, QDomElement & paramsRoot, QString & svg, const QString & layerID, bool skipText, qreal minArea, bool doFillings, const QString & textColor);
-	void genLayerElement(QDomElement & paramsRoot, QDomElement &, QString & svg, const QString & layerID, bool skipText, qreal minArea, bool doFillings, const QString & textColor);
-	void genCircle(QDomElement & element, QString & svg, bool forDimension, const QString & fill, const QString & stroke, qreal strokeWidth);
+	void genLayerElement(QDomElement & paramsRoot, const ModelElement &, QString & svg, const QString & layerID, bool skipText, qreal minArea, bool doFillings, const QString & textColor);
+	void genCircle(const ModelCircle &, QString & svg, bool forDimension, const QString & fill, const QString & stroke, qreal strokeWidth);
 	void genPath(QDomElement & element, QString & svg, const QString & fill, const QString & stroke, bool doFillings);
-	void genRect(QDomElement & element, QString & svg, bool forDimension);
-	void genLine(QDomElement & element, QString & svg);
-	void genArc(QDomElement & element, QString & svg);
+	void genRect(const ModelRect &, QString & svg, bool forDimension);
+	void genLine(const ModelLine &, QString & svg);
+	void genLines(QList<ModelLine> &, QString & svg);
+	bool joins(const ModelLine & previous, ModelLine & line);
+	void genArc(const ModelArc &, QString & svg);
 	void genPad(QDomElement & contact, QString & svg, const QString & layerID, const QString & copperColor, const QString & padString, bool integrateVias);
 	void genPadAux(QDomElement & contact, QDomElement & pad, QString & svg, const QString & layerID, const QString & copperColor, const QString & padString, bool integrateVias);
 	void genSmd(QDomElement & contact, QString & svg, const QString & layerID, const QString & copperColor, const QString & padString);
 	void genCopperElements(QDomElement &root, QDomElement & paramsRoot, QString & svg, const QString & layerID, const QString & copperColor, const QString & padString, bool integrateVias);
-	void genText(QDomElement & element, const QString & text, QString & svg, QDomElement & paramsRoot, const QString & textColor);
+	void genCopperPads(QDomElement &root, QDomElement & paramsRoot, QList<CopperPad> &, const QString & layerID, const QString & copperColor, const QString & padString, bool integrateVias, const QList<CopperPad> & otherLayer);
+	QString copperKey(QDomElement & contact, const QString & layerID);
+	void appendCopper(QString & svg, const QList<CopperPad> &, const QSet<QString> & skip);
+	void genText(const ModelText &, QString & svg, QDomElement & paramsRoot, const QString & textColor);
 	qreal flipy(qreal y);
 	bool inBounds(QDomElement & package);
+	bool inBounds(const ModelGroup & package);
 	bool inBounds(qreal x1, qreal y1, qreal x2, qreal y2);
-	void saveFile(const QString & content, const QString & suffix);
 	void collectContacts(QDomElement &root, QDomElement & paramsRoot, QList<QDomElement> & contacts, QStringList & busNames);
 	void collectPackages(QDomElement &root, QList<QDomElement> & packages);
 	void getSides(QDomElement & root, QDomElement & paramsRoot, 
@@ -63,48 +167,52 @@ protected:
 	void collectConnectors(QDomElement &paramsRoot, QList<QDomElement> & connectorList, bool collectSpaces);
 	void collectFakeVias(QDomElement &paramsRoot, QList<QDomElement> & connectorList);
 	QDomDocument loadParams(QFile & paramsFile, const QString & basename);
+	void loadRenames(QDomElement & paramsRoot);
 	void collectPadSmdPackages(QDomElement & root, QList<QDomElement> & padSmdPackages);
 	bool polyFromWires(QDomElement & root, const QString & boardColor, const QString & stroke, qreal strokeWidth, QString & svg, bool & clockwise);
 	QString genMaxShape(QDomElement & root, QDomElement & paramsRoot, const QString & boardColor, const QString & stroke, qreal strokeWidth); 
+	void overlapLine(QString & svg, qreal x1, qreal y1, qreal x2, qreal y2, const FillStroke &);
 	void genOverlaps(QDomElement & root, const FillStroke & normal, const FillStroke & IC, 
-						QString & svg, bool offBoardOnly, const QStringList & ICs, QHash<QString, QString> & subpartAliases, bool includeSubparts); 
+						QString & svg, bool offBoardOnly, const QStringList & ICs, bool includeSubparts); 
 	bool isUsed(QDomElement & contact);
 	bool isBus(QDomElement & contact);
 	QString genHole(QDomElement hole, qreal inset, bool clockwise);
 	QString genHole2(qreal cx, qreal cy, qreal r, int sweepFlag);
-	void addSubparts(QDomElement & root, QDomElement & paramsRoot, QString & svg, QHash<QString, QString> & subpartAliases);
-	bool bigEnough(QDomElement & package, qreal minArea);
-	void loadDifParams(QDir & workingFolder, QHash<QString, class DifParam *> & csvParams);
-	bool getArcBounds(QDomElement wire, QDomElement arc, qreal & x1, qreal & y1, qreal & x2, qreal & y2);
-	void includeSvg(QDomDocument & doc, const QString & path, const QString & name, qreal x, qreal y);
+	void addSubparts(QDomElement & root, QDomElement & paramsRoot, QString & svg);
+	bool bigEnough(const ModelGroup & package, qreal minArea);
+	QDomDocument includeSvg(const QString & path, const QString & name, qreal x, qreal y);
 	void getPackagesBounds(QDomElement & root, QRectF & bounds, const QString & layer, bool reset, bool deep);
-	void addElements(QDomElement & root, QList<QDomElement> & to, qreal minArea);
 	QString getBoardName(QDomElement & root);
 	QString loadDescription(const QString & prefix, const QString & url, const QDir & descrsFolder);
 	QString genPolyString(QList<QDomElement> &, QDomElement & element, qreal & width);
 	QString genPolyString(QList<struct WireTree *> &, QDomElement & element, qreal & width);
-	QString addPathUnit(WireTree * wireTree, QPointF p, qreal rDelta);
+	QString addPathUnit(WireTree * wireTree, QPointF p, qreal rDelta, QPointF & pen);
 	void replaceXY(QString & string);
 	QString translateBoardColor(const QString & color);
 	bool match(QDomElement & contact, QDomElement & connector, bool doDebug);
 	bool matchAnd(QDomElement & contact, QDomElement & connector);
-    QString findSubpart(const QString & name, QHash<QString, QString> & subpartAliases, QDir & subpartsFolder);
-    bool registerFonts();
+    QString findSubpart(const QString & name, const SubpartIndex &);
 
 protected:
-    QString m_workingPath;
-    QString m_andPath;
-    QString m_eaglePath;
-    QString m_fritzingSubpartsPath;
+	const BoardRun & m_run;
 	QDomDocument m_boardDoc;
+	BoardModel m_model;
+	QHash<QString, CachedDimensions> m_dimensionsCache;	// groupIndex/layer/deep
+	int m_dimensionsHits;
+	int m_dimensionsMisses;
+	QStringList m_subparts;				// paths of the subpart and <include> svgs this board used
+	QList<ZipEntry> m_bundle;			// the board's .fzpz entries with --fzpz
+	QStringList m_outputs;				// paths of the part files queued for writing
+	qreal m_svgScale;					// output units per mil for the view being generated
+	int m_segmentsRemoved;				// by --simplify-tolerance, in the view being generated
 	QRectF m_trueBounds;
 	QRectF m_boardBounds;
 	QDomElement m_maxElement;
 	bool m_genericSMD;
-	QString m_core;
 	qreal m_cxLast;
 	qreal m_cyLast;
 	qreal m_shrinkHolesFactor;
+	QMultiHash<QString, class Renamer *> m_renamers;
 	QNetworkAccessManager * m_networkAccessManager;
 };
 
@@ -0,0 +1,966 @@
+#include "brdreader.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QRegExp>
+#include <QStringList>
+#include <QtDebug>
+#include <qmath.h>
+
+/////////////////////////////////
+//
+//	EAGLE 6+ .brd files are xml, in millimeters, with library packages placed by reference.
+//	brd2xml.ulp writes mils, with every package primitive already transformed into board coordinates.
+//	BrdReader does that transformation itself, using the same element and attribute names as the ulp.
+//
+//	not reproduced:
+//
+//		polygon fillings (EAGLE computes those when it loads the board, so <fillings> is left empty)
+//		vector font strokes for texts (text width is derived from size and ratio instead)
+//		dashed wire pieces (each wire becomes a single piece)
+//		frame column and row of an element
+//
+/////////////////////////////////
+
+static const qreal MilsPerMM = 1000 / 25.4;
+static const qreal EagleUnitsPerMil = 254;			// the ulp's bare integers are eagle's internal 0.1 micron units
+
+static const int PadLayers[] = { 1, 16, 17, 29, 30 };
+static const int ViaLayers[] = { 1, 16, 18, 29, 30 };
+
+static qreal toRadians(qreal degrees) {
+	return degrees * M_PI / 180;
+}
+
+static qreal toDegrees(qreal radians) {
+	return radians * 180 / M_PI;
+}
+
+static QString mil(qreal value) {
+	if (qAbs(value) < 0.0000005) value = 0;				// avoid "-0.000000mil"
+	return QString::number(value, 'f', 6) + "mil";
+}
+
+static QString num(qreal value) {
+	if (qAbs(value) < 0.0000005) value = 0;
+	return QString::number(value, 'f', 6);
+}
+
+static qreal mmToMil(const QString & value) {
+	return value.toDouble() * MilsPerMM;
+}
+
+static qreal toMil(const QString & value, qreal defaultValue) {
+	// design rule values carry their own units
+	QRegExp units("^([-+0-9.eE]+)(mil|mm|mic|inch|in)$");
+	if (!units.exactMatch(value.trimmed())) return defaultValue;
+
+	bool ok;
+	qreal v = units.cap(1).toDouble(&ok);
+	if (!ok) return defaultValue;
+
+	QString unit = units.cap(2);
+	if (unit == "mil") return v;
+	if (unit == "mm") return v * MilsPerMM;
+	if (unit == "mic") return v * MilsPerMM / 1000;
+	return v * 1000;
+}
+
+static int capValue(const QString & cap) {
+	return (cap.compare("flat") == 0) ? 0 : 1;
+}
+
+static int styleValue(const QString & style) {
+	if (style.compare("longdash") == 0) return 1;
+	if (style.compare("shortdash") == 0) return 2;
+	if (style.compare("dashdot") == 0) return 3;
+	return 0;
+}
+
+static int fontValue(const QString & font) {
+	if (font.compare("vector") == 0) return 0;
+	if (font.compare("fixed") == 0) return 2;
+	return 1;
+}
+
+static int yesNo(const QString & value, bool defaultValue) {
+	if (value.isEmpty()) return defaultValue ? 1 : 0;
+	return (value.compare("yes") == 0) ? 1 : 0;
+}
+
+static QString headline(const QString & description) {
+	QString text = description;
+	text.replace(QRegExp("<[^>]*>"), "\n");
+	foreach (QString line, text.split("\n", QString::SkipEmptyParts)) {
+		line = line.trimmed();
+		if (!line.isEmpty()) return line;
+	}
+
+	return "";
+}
+
+///////////////////////////////////////////////////////
+
+void BrdReader::Area::add(qreal x, qreal y, qreal margin) {
+	if (empty) {
+		x1 = x - margin;
+		x2 = x + margin;
+		y1 = y - margin;
+		y2 = y + margin;
+		empty = false;
+		return;
+	}
+
+	x1 = qMin(x1, x - margin);
+	x2 = qMax(x2, x + margin);
+	y1 = qMin(y1, y - margin);
+	y2 = qMax(y2, y + margin);
+}
+
+///////////////////////////////////////////////////////
+
+BrdReader::BrdReader()
+{
+	m_inPackage = false;
+}
+
+bool BrdReader::translate(const QString & brdPath, QDomDocument & boardDoc, QString & errorStr)
+{
+	QFile file(brdPath);
+	QDomDocument brdDoc;
+	int errorLine;
+	int errorColumn;
+	if (!brdDoc.setContent(&file, true, &errorStr, &errorLine, &errorColumn)) {
+		errorStr = QString("%1 line:%2 col:%3 (boards saved by EAGLE 5 or earlier are binary, use -e)").arg(errorStr).arg(errorLine).arg(errorColumn);
+		return false;
+	}
+
+	QDomElement eagle = brdDoc.documentElement();
+	if (eagle.tagName().compare("eagle") != 0) {
+		errorStr = "not an EAGLE xml file";
+		return false;
+	}
+
+	QDomElement board = eagle.firstChildElement("drawing").firstChildElement("board");
+	if (board.isNull()) {
+		errorStr = "no <board> found";
+		return false;
+	}
+
+	m_doc = QDomDocument();
+	m_packages.clear();
+	m_contactSignals.clear();
+	m_classNames.clear();
+	m_designRules.clear();
+	m_usedLayers.clear();
+	m_boardArea = Area();
+	m_inPackage = false;
+
+	loadDesignRules(board);
+	loadLibraries(board);
+	loadSignals(board);
+
+	m_doc.appendChild(m_doc.createProcessingInstruction("xml", "version=\"1.0\" encoding=\"UTF-8\""));
+	QDomElement root = m_doc.createElement("board");
+	m_doc.appendChild(root);
+	root.setAttribute("version", "1.0");
+
+	QDomElement title = m_doc.createElement("title");
+	root.appendChild(title);
+	title.appendChild(m_doc.createTextNode(QFileInfo(brdPath).absoluteFilePath()));
+	QDomElement desc = m_doc.createElement("desc");
+	root.appendChild(desc);
+	desc.appendChild(m_doc.createTextNode("generated by brd2svg from EAGLE xml"));
+
+	QStringList groups;
+	groups << "circles" << "texts" << "rects" << "polygons" << "wires" << "elements" << "holes" << "signals" << "frames" << "layers";
+	foreach (QString group, groups) {
+		root.appendChild(genGroup(group));
+	}
+
+	QDomElement plain = board.firstChildElement("plain");
+	genPlain(plain, root);
+
+	QDomElement elements = root.firstChildElement("elements");
+	QDomElement element = board.firstChildElement("elements").firstChildElement("element");
+	while (!element.isNull()) {
+		elements.appendChild(genElement(element));
+		element = element.nextSiblingElement("element");
+	}
+
+	QDomElement _signals = root.firstChildElement("signals");
+	QDomElement signal = board.firstChildElement("signals").firstChildElement("signal");
+	while (!signal.isNull()) {
+		_signals.appendChild(genSignal(signal));
+		signal = signal.nextSiblingElement("signal");
+	}
+
+	// layers go last so that "used" is known
+	QDomElement layers = root.firstChildElement("layers");
+	QDomElement layer = eagle.firstChildElement("drawing").firstChildElement("layers").firstChildElement("layer");
+	while (!layer.isNull()) {
+		layers.appendChild(genLayer(layer));
+		layer = layer.nextSiblingElement("layer");
+	}
+
+	root.setAttribute("x1", mil(m_boardArea.x1));
+	root.setAttribute("y1", mil(m_boardArea.y1));
+	root.setAttribute("x2", mil(m_boardArea.x2));
+	root.setAttribute("y2", mil(m_boardArea.y2));
+
+	boardDoc = m_doc;
+	return true;
+}
+
+void BrdReader::loadDesignRules(QDomElement & board)
+{
+	QDomElement param = board.firstChildElement("designrules").firstChildElement("param");
+	while (!param.isNull()) {
+		m_designRules.insert(param.attribute("name"), param.attribute("value"));
+		param = param.nextSiblingElement("param");
+	}
+}
+
+void BrdReader::loadLibraries(QDomElement & board)
+{
+	QDomElement library = board.firstChildElement("libraries").firstChildElement("library");
+	while (!library.isNull()) {
+		QString prefix = library.attribute("name") + "\n" + library.attribute("urn") + "\n";
+		QDomElement package = library.firstChildElement("packages").firstChildElement("package");
+		while (!package.isNull()) {
+			package.setAttribute("library", library.attribute("name"));
+			m_packages.insert(prefix + package.attribute("name"), package);
+			package = package.nextSiblingElement("package");
+		}
+		library = library.nextSiblingElement("library");
+	}
+}
+
+void BrdReader::loadSignals(QDomElement & board)
+{
+	QDomElement _class = board.firstChildElement("classes").firstChildElement("class");
+	while (!_class.isNull()) {
+		m_classNames.insert(_class.attribute("number"), _class.attribute("name"));
+		_class = _class.nextSiblingElement("class");
+	}
+
+	QDomElement signal = board.firstChildElement("signals").firstChildElement("signal");
+	while (!signal.isNull()) {
+		QDomElement contactref = signal.firstChildElement("contactref");
+		while (!contactref.isNull()) {
+			m_contactSignals.insert(contactref.attribute("element") + "\n" + contactref.attribute("pad"), signal.attribute("name"));
+			contactref = contactref.nextSiblingElement("contactref");
+		}
+		signal = signal.nextSiblingElement("signal");
+	}
+}
+
+void BrdReader::genPlain(QDomElement & plain, QDomElement & root)
+{
+	Placement board;
+	QDomElement child = plain.firstChildElement();
+	while (!child.isNull()) {
+		QString tagName = child.tagName();
+		if (tagName.compare("wire") == 0) {
+			root.firstChildElement("wires").appendChild(genWire(child, board));
+		}
+		else if (tagName.compare("circle") == 0) {
+			root.firstChildElement("circles").appendChild(genCircle(child, board));
+		}
+		else if (tagName.compare("rectangle") == 0) {
+			root.firstChildElement("rects").appendChild(genRect(child, board));
+		}
+		else if (tagName.compare("polygon") == 0) {
+			root.firstChildElement("polygons").appendChild(genPolygon(child, board));
+		}
+		else if (tagName.compare("text") == 0) {
+			root.firstChildElement("texts").appendChild(genText(child, child.text(), board));
+		}
+		else if (tagName.compare("hole") == 0) {
+			root.firstChildElement("holes").appendChild(genHole(child, board));
+		}
+		else if (tagName.compare("frame") == 0) {
+			root.firstChildElement("frames").appendChild(genFrame(child, board));
+		}
+		child = child.nextSiblingElement();
+	}
+}
+
+QDomElement BrdReader::genElement(QDomElement & element)
+{
+	QString name = element.attribute("name");
+	QString value = element.attribute("value");
+
+	Placement placement = parseRot(element.attribute("rot"));
+	placement.x = mmToMil(element.attribute("x"));
+	placement.y = mmToMil(element.attribute("y"));
+
+	QDomElement result = m_doc.createElement("element");
+	result.setAttribute("name", name);
+	result.setAttribute("angle", num(placement.angle));
+	result.setAttribute("column", "");
+	result.setAttribute("row", "");
+	result.setAttribute("mirror", placement.mirror ? 1 : 0);
+	result.setAttribute("spin", placement.spin ? 1 : 0);
+	result.setAttribute("value", value);
+	result.setAttribute("x", mil(placement.x));
+	result.setAttribute("y", mil(placement.y));
+
+	QDomElement attributes = genGroup("attributes");
+	result.appendChild(attributes);
+	QDomElement texts = genGroup("texts");
+	result.appendChild(texts);
+
+	// smashed NAME and VALUE (and any other displayed attribute) carry absolute board coordinates.
+	// As in the ulp, an attribute's text goes inside its <attribute>, and the displayed ones are
+	// also among the element's texts, which is where they get drawn from
+	Placement board;
+	QDomElement attribute = element.firstChildElement("attribute");
+	while (!attribute.isNull()) {
+		QString attributeName = attribute.attribute("name");
+		QString attributeValue = attribute.attribute("value");
+		if (attributeName.compare("NAME") == 0) attributeValue = name;
+		else if (attributeName.compare("VALUE") == 0) attributeValue = value;
+
+		QDomElement a = m_doc.createElement("attribute");
+		a.setAttribute("name", attributeName);
+		a.setAttribute("value", attributeValue);
+		attributes.appendChild(a);
+
+		QString display = attribute.attribute("display", "value");
+		if (!attribute.attribute("layer").isEmpty() && display.compare("off") != 0) {
+			QString text = attributeValue;
+			if (display.compare("name") == 0) text = attributeName;
+			else if (display.compare("both") == 0) text = attributeName + " = " + attributeValue;
+			QDomElement t = genText(attribute, text, board);
+			a.appendChild(t);
+			texts.appendChild(t.cloneNode(true));
+		}
+
+		attribute = attribute.nextSiblingElement("attribute");
+	}
+
+	QString key = element.attribute("library") + "\n" + element.attribute("library_urn") + "\n" + element.attribute("package");
+	QDomElement package = m_packages.value(key);
+	if (package.isNull()) {
+		qDebug() << "package not found for element" << name << element.attribute("library") << element.attribute("package");
+		return result;
+	}
+
+	result.appendChild(genPackage(package, placement, element));
+	return result;
+}
+
+QDomElement BrdReader::genPackage(QDomElement & package, const Placement & placement, QDomElement & element)
+{
+	QString elementName = element.attribute("name");
+	bool smashed = element.attribute("smashed").compare("yes") == 0;
+
+	m_inPackage = true;
+	m_packageArea = Area();
+
+	QString description = package.firstChildElement("description").text();
+
+	QDomElement result = m_doc.createElement("package");
+	QStringList groups;
+	groups << "polygons" << "circles" << "rects" << "wires" << "texts" << "contacts" << "holes" << "frames";
+	foreach (QString group, groups) {
+		result.appendChild(genGroup(group));
+	}
+
+	QDomElement child = package.firstChildElement();
+	while (!child.isNull()) {
+		QString tagName = child.tagName();
+		if (tagName.compare("wire") == 0) {
+			result.firstChildElement("wires").appendChild(genWire(child, placement));
+		}
+		else if (tagName.compare("circle") == 0) {
+			result.firstChildElement("circles").appendChild(genCircle(child, placement));
+		}
+		else if (tagName.compare("rectangle") == 0) {
+			result.firstChildElement("rects").appendChild(genRect(child, placement));
+		}
+		else if (tagName.compare("polygon") == 0) {
+			result.firstChildElement("polygons").appendChild(genPolygon(child, placement));
+		}
+		else if (tagName.compare("pad") == 0 || tagName.compare("smd") == 0) {
+			result.firstChildElement("contacts").appendChild(genContact(child, placement, elementName));
+		}
+		else if (tagName.compare("hole") == 0) {
+			result.firstChildElement("holes").appendChild(genHole(child, placement));
+		}
+		else if (tagName.compare("frame") == 0) {
+			result.firstChildElement("frames").appendChild(genFrame(child, placement));
+		}
+		else if (tagName.compare("text") == 0) {
+			QString text = child.text();
+			if (text.startsWith(">")) {
+				// placeholder texts: a smashed element draws these from its own attributes
+				QString attributeName = text.mid(1).toUpper();
+				bool isNameOrValue = attributeName.compare("NAME") == 0 || attributeName.compare("VALUE") == 0;
+				if (smashed && isNameOrValue) {
+					child = child.nextSiblingElement();
+					continue;
+				}
+
+				if (attributeName.compare("NAME") == 0) text = elementName;
+				else if (attributeName.compare("VALUE") == 0) text = element.attribute("value");
+				else {
+					QDomElement attribute = element.firstChildElement("attribute");
+					while (!attribute.isNull()) {
+						if (attribute.attribute("name").compare(attributeName, Qt::CaseInsensitive) == 0) {
+							text = attribute.attribute("value");
+							break;
+						}
+						attribute = attribute.nextSiblingElement("attribute");
+					}
+				}
+			}
+			result.firstChildElement("texts").appendChild(genText(child, text, placement));
+		}
+
+		child = child.nextSiblingElement();
+	}
+
+	if (m_packageArea.empty) {
+		m_packageArea.add(placement.x, placement.y, 0);
+	}
+
+	result.setAttribute("x1", mil(m_packageArea.x1));
+	result.setAttribute("y1", mil(m_packageArea.y1));
+	result.setAttribute("x2", mil(m_packageArea.x2));
+	result.setAttribute("y2", mil(m_packageArea.y2));
+	result.setAttribute("description", description);
+	result.setAttribute("headline", headline(description));
+	result.setAttribute("library", package.attribute("library"));
+	result.setAttribute("name", package.attribute("name"));
+
+	m_inPackage = false;
+	return result;
+}
+
+QDomElement BrdReader::genSignal(QDomElement & signal)
+{
+	QDomElement result = m_doc.createElement("signal");
+	result.setAttribute("name", signal.attribute("name"));
+	result.setAttribute("classname", m_classNames.value(signal.attribute("class", "0"), "default"));
+
+	// same order as the ulp: contactrefs, polygons, wires, vias
+	QStringList tagNames;
+	tagNames << "contactref" << "polygon" << "wire" << "via";
+	Placement board;
+	foreach (QString tagName, tagNames) {
+		QDomElement child = signal.firstChildElement(tagName);
+		while (!child.isNull()) {
+			if (tagName.compare("contactref") == 0) {
+				QDomElement contactref = m_doc.createElement("contactref");
+				contactref.setAttribute("elementname", child.attribute("element"));
+				contactref.setAttribute("contactname", child.attribute("pad"));
+				result.appendChild(contactref);
+			}
+			else if (tagName.compare("polygon") == 0) {
+				result.appendChild(genPolygon(child, board));
+			}
+			else if (tagName.compare("wire") == 0) {
+				result.appendChild(genWire(child, board));
+			}
+			else {
+				result.appendChild(genVia(child));
+			}
+			child = child.nextSiblingElement(tagName);
+		}
+	}
+
+	return result;
+}
+
+QDomElement BrdReader::genLayer(QDomElement & layer)
+{
+	int number = layer.attribute("number").toInt();
+
+	QDomElement result = m_doc.createElement("layer");
+	result.setAttribute("color", layer.attribute("color", "0"));
+	result.setAttribute("fill", layer.attribute("fill", "0"));
+	result.setAttribute("name", layer.attribute("name"));
+	result.setAttribute("number", number);
+	result.setAttribute("used", m_usedLayers.contains(number) ? 1 : 0);
+	result.setAttribute("visible", yesNo(layer.attribute("visible"), true));
+	return result;
+}
+
+QDomElement BrdReader::genWire(QDomElement & wire, const Placement & placement)
+{
+	QPointF p1 = mapMM(placement, wire, "x1", "y1");
+	QPointF p2 = mapMM(placement, wire, "x2", "y2");
+	qreal curve = wire.attribute("curve", "0").toDouble();
+	if (placement.mirror) curve = -curve;
+
+	return genWire(p1, p2, mmToMil(wire.attribute("width")), mapLayer(placement, wire.attribute("layer").toInt()), curve,
+					capValue(wire.attribute("cap")), styleValue(wire.attribute("style")));
+}
+
+QDomElement BrdReader::genWire(const QPointF & p1, const QPointF & p2, qreal width, int layer, qreal curve, int cap, int style)
+{
+	m_usedLayers.insert(layer);
+
+	QDomElement result = m_doc.createElement("wire");
+	result.setAttribute("cap", cap);
+	result.setAttribute("curve", num(curve));
+	result.setAttribute("x1", mil(p1.x()));
+	result.setAttribute("y1", mil(p1.y()));
+	result.setAttribute("x2", mil(p2.x()));
+	result.setAttribute("y2", mil(p2.y()));
+	result.setAttribute("width", mil(width));
+	result.setAttribute("style", style);
+	result.setAttribute("layer", layer);
+
+	QDomElement piece = m_doc.createElement("piece");
+	result.appendChild(piece);
+
+	extend(p1, width / 2);
+	extend(p2, width / 2);
+
+	qreal dx = p2.x() - p1.x();
+	qreal dy = p2.y() - p1.y();
+	qreal d = qSqrt((dx * dx) + (dy * dy));
+	if (curve == 0 || d == 0) {
+		QDomElement line = m_doc.createElement("line");
+		line.setAttribute("x1", mil(p1.x()));
+		line.setAttribute("y1", mil(p1.y()));
+		line.setAttribute("x2", mil(p2.x()));
+		line.setAttribute("y2", mil(p2.y()));
+		line.setAttribute("width", mil(width));
+		line.setAttribute("layer", layer);
+		line.setAttribute("cap", cap);
+		piece.appendChild(line);
+		return result;
+	}
+
+	// the center is to the left of p1->p2 for a positive (counterclockwise) curve
+	qreal half = toRadians(curve) / 2;
+	qreal h = (d / 2) / qTan(half);
+	QPointF center((p1.x() + p2.x()) / 2 - (dy / d) * h, (p1.y() + p2.y()) / 2 + (dx / d) * h);
+	qreal r = qAbs((d / 2) / qSin(half));
+
+	// like EAGLE, arcs always run counterclockwise from angle1 to angle2, so a clockwise wire exchanges its ends
+	QPointF start = (curve > 0) ? p1 : p2;
+	QPointF end = (curve > 0) ? p2 : p1;
+	qreal angle1 = toDegrees(qAtan2(start.y() - center.y(), start.x() - center.x()));
+	if (angle1 < 0) angle1 += 360;
+	qreal angle2 = angle1 + qAbs(curve);
+
+	qreal mid = toRadians((angle1 + angle2) / 2);
+	extend(QPointF(center.x() + r * qCos(mid), center.y() + r * qSin(mid)), width / 2);
+
+	QDomElement arc = m_doc.createElement("arc");
+	arc.setAttribute("angle1", num(angle1));
+	arc.setAttribute("angle2", num(angle2));
+	arc.setAttribute("cap", cap);
+	arc.setAttribute("layer", layer);
+	arc.setAttribute("r", mil(r));
+	arc.setAttribute("width", mil(width));
+	arc.setAttribute("x1", mil(start.x()));
+	arc.setAttribute("y1", mil(start.y()));
+	arc.setAttribute("x2", mil(end.x()));
+	arc.setAttribute("y2", mil(end.y()));
+	arc.setAttribute("xc", mil(center.x()));
+	arc.setAttribute("yc", mil(center.y()));
+	piece.appendChild(arc);
+
+	return result;
+}
+
+QDomElement BrdReader::genText(QDomElement & text, const QString & value, const Placement & placement)
+{
+	QPointF p = mapMM(placement, text, "x", "y");
+	qreal size = mmToMil(text.attribute("size"));
+	qreal ratio = text.attribute("ratio", "8").toDouble() / 100;
+	Placement rot = parseRot(text.attribute("rot"));
+	int layer = mapLayer(placement, text.attribute("layer").toInt());
+	m_usedLayers.insert(layer);
+	extend(p, size);
+
+	QDomElement result = m_doc.createElement("text");
+	result.setAttribute("angle", num(mapAngle(placement, rot.angle)));
+	result.setAttribute("font", fontValue(text.attribute("font")));
+	result.setAttribute("layer", layer);
+	result.setAttribute("mirror", (rot.mirror != placement.mirror) ? 1 : 0);
+	result.setAttribute("size", mil(size));
+	result.setAttribute("spin", rot.spin ? 1 : 0);
+	result.setAttribute("x", mil(p.x()));
+	result.setAttribute("y", mil(p.y()));
+	result.setAttribute("width", mil(size * ratio));			// the ulp uses the widest vector font stroke
+	result.setAttribute("ratio", num(ratio));
+
+	QDomElement v = m_doc.createElement("value");
+	v.appendChild(m_doc.createTextNode(value));
+	result.appendChild(v);
+	return result;
+}
+
+QDomElement BrdReader::genCircle(QDomElement & circle, const Placement & placement)
+{
+	QPointF c = mapMM(placement, circle, "x", "y");
+	qreal r = mmToMil(circle.attribute("radius"));
+	qreal width = mmToMil(circle.attribute("width"));
+	int layer = mapLayer(placement, circle.attribute("layer").toInt());
+	m_usedLayers.insert(layer);
+	extend(c, r + (width / 2));
+
+	QDomElement result = m_doc.createElement("circle");
+	result.setAttribute("cx", mil(c.x()));
+	result.setAttribute("cy", mil(c.y()));
+	result.setAttribute("r", mil(r));
+	result.setAttribute("width", mil(width));
+	result.setAttribute("layer", layer);
+	return result;
+}
+
+QDomElement BrdReader::genRect(QDomElement & rect, const Placement & placement)
+{
+	qreal x1 = mmToMil(rect.attribute("x1"));
+	qreal y1 = mmToMil(rect.attribute("y1"));
+	qreal x2 = mmToMil(rect.attribute("x2"));
+	qreal y2 = mmToMil(rect.attribute("y2"));
+	qreal w = qAbs(x2 - x1);
+	qreal h = qAbs(y2 - y1);
+	QPointF c = map(placement, (x1 + x2) / 2, (y1 + y2) / 2);
+	qreal angle = mapAngle(placement, parseRot(rect.attribute("rot")).angle);
+
+	// genRect ignores rotation, so fold quarter turns into the rectangle itself
+	if (angle == 90 || angle == 270) {
+		qSwap(w, h);
+		angle = 0;
+	}
+	else if (angle == 180) {
+		angle = 0;
+	}
+
+	int layer = mapLayer(placement, rect.attribute("layer").toInt());
+	m_usedLayers.insert(layer);
+	extend(c, qSqrt((w * w) + (h * h)) / 2);
+
+	QDomElement result = m_doc.createElement("rect");
+	result.setAttribute("x1", mil(c.x() - (w / 2)));
+	result.setAttribute("y1", mil(c.y() - (h / 2)));
+	result.setAttribute("x2", mil(c.x() + (w / 2)));
+	result.setAttribute("y2", mil(c.y() + (h / 2)));
+	result.setAttribute("layer", layer);
+	result.setAttribute("angle", num(angle));
+	return result;
+}
+
+QDomElement BrdReader::genPolygon(QDomElement & polygon, const Placement & placement)
+{
+	int layer = mapLayer(placement, polygon.attribute("layer").toInt());
+	qreal width = mmToMil(polygon.attribute("width"));
+	m_usedLayers.insert(layer);
+
+	QDomElement result = m_doc.createElement("polygon");
+	result.setAttribute("layer", layer);
+	// the ulp writes isolate and spacing as bare integers in eagle units
+	result.setAttribute("isolate", qRound(mmToMil(polygon.attribute("isolate", "0")) * EagleUnitsPerMil));
+	result.setAttribute("orphans", yesNo(polygon.attribute("orphans"), false));
+	result.setAttribute("pour", (polygon.attribute("pour").compare("hatch") == 0) ? 1 : (polygon.attribute("pour").compare("cutout") == 0) ? 2 : 0);
+	result.setAttribute("rank", polygon.attribute("rank", "1"));
+	result.setAttribute("spacing", qRound(mmToMil(polygon.attribute("spacing", "0")) * EagleUnitsPerMil));
+	result.setAttribute("thermals", yesNo(polygon.attribute("thermals"), true));
+	result.setAttribute("width", mil(width));
+
+	QDomElement contours = genGroup("contours");
+	result.appendChild(contours);
+	result.appendChild(genGroup("fillings"));
+
+	QList<QDomElement> vertices;
+	QDomElement vertex = polygon.firstChildElement("vertex");
+	while (!vertex.isNull()) {
+		vertices.append(vertex);
+		vertex = vertex.nextSiblingElement("vertex");
+	}
+
+	for (int i = 0; i < vertices.count(); i++) {
+		QDomElement from = vertices.at(i);
+		QDomElement to = vertices.at((i + 1) % vertices.count());
+		qreal curve = from.attribute("curve", "0").toDouble();
+		if (placement.mirror) curve = -curve;
+		contours.appendChild(genWire(mapMM(placement, from, "x", "y"), mapMM(placement, to, "x", "y"), width, layer, curve, 1, 0));
+	}
+
+	return result;
+}
+
+QDomElement BrdReader::genContact(QDomElement & padOrSmd, const Placement & placement, const QString & elementName)
+{
+	QString name = padOrSmd.attribute("name");
+	QString signal = m_contactSignals.value(elementName + "\n" + name);
+	QPointF p = mapMM(placement, padOrSmd, "x", "y");
+
+	QDomElement result = m_doc.createElement("contact");
+	result.setAttribute("name", name);
+	result.setAttribute("signal", signal);
+	result.setAttribute("x", mil(p.x()));
+	result.setAttribute("y", mil(p.y()));
+
+	if (padOrSmd.tagName().compare("pad") == 0) {
+		result.appendChild(genPad(padOrSmd, placement, signal));
+	}
+	else {
+		result.appendChild(genSmd(padOrSmd, placement, signal));
+	}
+
+	return result;
+}
+
+QDomElement BrdReader::genPad(QDomElement & pad, const Placement & placement, const QString & signal)
+{
+	QPointF p = mapMM(placement, pad, "x", "y");
+	qreal drill = mmToMil(pad.attribute("drill"));
+	qreal diameter = restring(mmToMil(pad.attribute("diameter", "0")), drill,
+								m_designRules.value("rvPadTop", "0.25").toDouble(),
+								toMil(m_designRules.value("rlMinPadTop"), 10),
+								toMil(m_designRules.value("rlMaxPadTop"), 20));
+	QString shape = pad.attribute("shape", "round");
+	int elongation = 0;
+	if (shape.compare("long") == 0) elongation = m_designRules.value("psElongationLong", "100").toInt();
+	else if (shape.compare("offset") == 0) elongation = m_designRules.value("psElongationOffset", "100").toInt();
+	qreal stop = (pad.attribute("stop").compare("no") == 0) ? 0 : diameter + 2 * toMil(m_designRules.value("mlMinStopFrame"), 4);
+
+	QDomElement result = m_doc.createElement("pad");
+	result.setAttribute("angle", num(mapAngle(placement, parseRot(pad.attribute("rot")).angle)));
+	result.setAttribute("drill", mil(drill));
+	result.setAttribute("drillsymbol", 0);
+	result.setAttribute("elongation", elongation);
+	result.setAttribute("flags", 0);
+	result.setAttribute("name", pad.attribute("name"));
+	result.setAttribute("signal", signal);
+	result.setAttribute("x", mil(p.x()));
+	result.setAttribute("y", mil(p.y()));
+
+	for (unsigned i = 0; i < sizeof(PadLayers) / sizeof(int); i++) {
+		int l = PadLayers[i];
+		m_usedLayers.insert(l);
+		QDomElement layer = m_doc.createElement("layer");
+		layer.setAttribute("layer", l);
+		layer.setAttribute("diameter", mil((l == 29 || l == 30) ? stop : diameter));
+		layer.setAttribute("shape", shape);
+		layer.setAttribute("elongation", elongation);
+		result.appendChild(layer);
+	}
+
+	extend(p, (elongation > 0) ? diameter : diameter / 2);
+	return result;
+}
+
+QDomElement BrdReader::genSmd(QDomElement & smd, const Placement & placement, const QString & signal)
+{
+	QPointF p = mapMM(placement, smd, "x", "y");
+	qreal dx = mmToMil(smd.attribute("dx"));
+	qreal dy = mmToMil(smd.attribute("dy"));
+	qreal angle = mapAngle(placement, parseRot(smd.attribute("rot")).angle);
+	int layer = mapLayer(placement, smd.attribute("layer").toInt());
+	qreal stop = (smd.attribute("stop").compare("no") == 0) ? 0 : 2 * toMil(m_designRules.value("mlMinStopFrame"), 4);
+
+	QDomElement result = m_doc.createElement("smd");
+	result.setAttribute("angle", num(angle));
+	result.setAttribute("flags", 0);
+	result.setAttribute("name", smd.attribute("name"));
+	result.setAttribute("signal", signal);
+	result.setAttribute("x", mil(p.x()));
+	result.setAttribute("y", mil(p.y()));
+	result.setAttribute("layer", layer);
+	result.setAttribute("roundness", smd.attribute("roundness", "0"));
+	result.setAttribute("dx", mil(dx));
+	result.setAttribute("dy", mil(dy));
+
+	QList<int> layers;
+	if (layer == 16) layers << 16 << 32 << 30;
+	else layers << 1 << 31 << 29;
+	foreach (int l, layers) {
+		m_usedLayers.insert(l);
+		qreal grow = (l == 29 || l == 30) ? stop : 0;
+		QDomElement child = m_doc.createElement("layer");
+		child.setAttribute("layer", l);
+		child.setAttribute("dx", mil(dx + grow));
+		child.setAttribute("dy", mil(dy + grow));
+		result.appendChild(child);
+	}
+
+	qreal radians = toRadians(angle);
+	for (int sx = -1; sx <= 1; sx += 2) {
+		for (int sy = -1; sy <= 1; sy += 2) {
+			qreal cx = sx * dx / 2;
+			qreal cy = sy * dy / 2;
+			extend(QPointF(p.x() + (cx * qCos(radians)) - (cy * qSin(radians)), p.y() + (cx * qSin(radians)) + (cy * qCos(radians))), 0);
+		}
+	}
+
+	return result;
+}
+
+QDomElement BrdReader::genHole(QDomElement & hole, const Placement & placement)
+{
+	QPointF p = mapMM(placement, hole, "x", "y");
+	qreal drill = mmToMil(hole.attribute("drill"));
+	qreal stop = drill + 2 * toMil(m_designRules.value("mlMinStopFrame"), 4);
+	extend(p, drill / 2);
+
+	QDomElement result = m_doc.createElement("hole");
+	result.setAttribute("x", mil(p.x()));
+	result.setAttribute("y", mil(p.y()));
+	result.setAttribute("drill", mil(drill));
+	result.setAttribute("drillsymbol", 0);
+	result.setAttribute("t_diameter", mil(stop));
+	result.setAttribute("b_diameter", mil(stop));
+	return result;
+}
+
+QDomElement BrdReader::genVia(QDomElement & via)
+{
+	Placement board;
+	QPointF p = mapMM(board, via, "x", "y");
+	qreal drill = mmToMil(via.attribute("drill"));
+	qreal diameter = restring(mmToMil(via.attribute("diameter", "0")), drill,
+								m_designRules.value("rvViaOuter", "0.25").toDouble(),
+								toMil(m_designRules.value("rlMinViaOuter"), 8),
+								toMil(m_designRules.value("rlMaxViaOuter"), 20));
+	qreal stop = diameter + 2 * toMil(m_designRules.value("mlMinStopFrame"), 4);
+	QString shape = via.attribute("shape", "round");
+
+	QStringList extent = via.attribute("extent", "1-16").split("-");
+	int start = extent.first().toInt();
+	int end = extent.last().toInt();
+
+	QDomElement result = m_doc.createElement("via");
+	result.setAttribute("drill", mil(drill));
+	result.setAttribute("drillsymbol", 0);
+	result.setAttribute("flags", 0);
+	result.setAttribute("x", mil(p.x()));
+	result.setAttribute("y", mil(p.y()));
+
+	for (unsigned i = 0; i < sizeof(ViaLayers) / sizeof(int); i++) {
+		int l = ViaLayers[i];
+		// same (half-open) layer test as brd2xml.ulp
+		if (l < start || l >= end) continue;
+
+		m_usedLayers.insert(l);
+		QDomElement layer = m_doc.createElement("layer");
+		layer.setAttribute("layer", l);
+		layer.setAttribute("diameter", mil((l == 29 || l == 30) ? stop : diameter));
+		layer.setAttribute("shape", shape);
+		result.appendChild(layer);
+	}
+
+	extend(p, diameter / 2);
+	return result;
+}
+
+QDomElement BrdReader::genFrame(QDomElement & frame, const Placement & placement)
+{
+	QPointF p1 = mapMM(placement, frame, "x1", "y1");
+	QPointF p2 = mapMM(placement, frame, "x2", "y2");
+	int layer = mapLayer(placement, frame.attribute("layer").toInt());
+	m_usedLayers.insert(layer);
+	extend(p1, 0);
+	extend(p2, 0);
+
+	QDomElement result = m_doc.createElement("frame");
+	result.setAttribute("layer", layer);
+	result.setAttribute("x1", mil(qMin(p1.x(), p2.x())));
+	result.setAttribute("y1", mil(qMin(p1.y(), p2.y())));
+	result.setAttribute("x2", mil(qMax(p1.x(), p2.x())));
+	result.setAttribute("y2", mil(qMax(p1.y(), p2.y())));
+	return result;
+}
+
+QDomElement BrdReader::genGroup(const QString & tagName)
+{
+	return m_doc.createElement(tagName);
+}
+
+BrdReader::Placement BrdReader::parseRot(const QString & rot)
+{
+	// e.g. "R90", "MR180", "SMR45"
+	Placement placement;
+	QRegExp rotation("^(S?)(M?)R([0-9.]+)$");
+	if (rotation.exactMatch(rot)) {
+		placement.spin = !rotation.cap(1).isEmpty();
+		placement.mirror = !rotation.cap(2).isEmpty();
+		placement.angle = rotation.cap(3).toDouble();
+	}
+
+	return placement;
+}
+
+QPointF BrdReader::map(const Placement & placement, qreal x, qreal y)
+{
+	// mirror first, then rotate counterclockwise, then move to the element origin
+	if (placement.mirror) x = -x;
+
+	qreal rx, ry;
+	if (placement.angle == 0) {
+		rx = x;
+		ry = y;
+	}
+	else if (placement.angle == 90) {
+		rx = -y;
+		ry = x;
+	}
+	else if (placement.angle == 180) {
+		rx = -x;
+		ry = -y;
+	}
+	else if (placement.angle == 270) {
+		rx = y;
+		ry = -x;
+	}
+	else {
+		qreal radians = toRadians(placement.angle);
+		rx = (x * qCos(radians)) - (y * qSin(radians));
+		ry = (x * qSin(radians)) + (y * qCos(radians));
+	}
+
+	return QPointF(rx + placement.x, ry + placement.y);
+}
+
+QPointF BrdReader::mapMM(const Placement & placement, const QDomElement & element, const QString & xName, const QString & yName)
+{
+	return map(placement, mmToMil(element.attribute(xName)), mmToMil(element.attribute(yName)));
+}
+
+qreal BrdReader::mapAngle(const Placement & placement, qreal angle)
+{
+	qreal result = (placement.mirror ? -angle : angle) + placement.angle;
+	while (result < 0) result += 360;
+	while (result >= 360) result -= 360;
+	return result;
+}
+
+int BrdReader::mapLayer(const Placement & placement, int layer)
+{
+	if (!placement.mirror) return layer;
+
+	// copper layers flip top to bottom; the top/bottom pairs (tPlace/bPlace etc.) sit next to each other
+	if (layer >= 1 && layer <= 16) return 17 - layer;
+	if ((layer >= 21 && layer <= 42) || layer == 51 || layer == 52) {
+		return (layer % 2 == 1) ? layer + 1 : layer - 1;
+	}
+
+	return layer;
+}
+
+void BrdReader::extend(const QPointF & p, qreal margin)
+{
+	m_boardArea.add(p.x(), p.y(), margin);
+	if (m_inPackage) {
+		m_packageArea.add(p.x(), p.y(), margin);
+	}
+}
+
+qreal BrdReader::restring(qreal diameter, qreal drill, qreal ratio, qreal minimum, qreal maximum)
+{
+	// a zero diameter means "automatic": EAGLE derives the annular ring from the design rules
+	if (diameter > 0) return diameter;
+
+	qreal ring = qBound(minimum, drill * ratio, maximum);
+	return drill + (2 * ring);
+}
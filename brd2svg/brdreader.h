@@ -0,0 +1,83 @@
+#ifndef BRDREADER_H
+#define BRDREADER_H
+
+#include <QDomDocument>
+#include <QHash>
+#include <QSet>
+#include <QPointF>
+
+// Translates an EAGLE 6 (or later) xml .brd file into the same <board> document that brd2xml.ulp writes,
+// so that boards can be converted without launching EAGLE
+
+class BrdReader
+{
+public:
+	BrdReader();
+
+	bool translate(const QString & brdPath, QDomDocument & boardDoc, QString & errorStr);
+
+protected:
+	struct Placement {
+		Placement() : x(0), y(0), angle(0), mirror(false), spin(false) {}
+
+		qreal x;				// mils
+		qreal y;
+		qreal angle;
+		bool mirror;
+		bool spin;
+	};
+
+	struct Area {
+		Area() : empty(true), x1(0), y1(0), x2(0), y2(0) {}
+		void add(qreal x, qreal y, qreal margin);
+
+		bool empty;
+		qreal x1;
+		qreal y1;
+		qreal x2;
+		qreal y2;
+	};
+
+	void loadDesignRules(QDomElement & board);
+	void loadLibraries(QDomElement & board);
+	void loadSignals(QDomElement & board);
+	void genPlain(QDomElement & plain, QDomElement & root);
+	QDomElement genElement(QDomElement & element);
+	QDomElement genPackage(QDomElement & package, const Placement &, QDomElement & element);
+	QDomElement genSignal(QDomElement & signal);
+	QDomElement genLayer(QDomElement & layer);
+	QDomElement genWire(QDomElement & wire, const Placement &);
+	QDomElement genWire(const QPointF & p1, const QPointF & p2, qreal width, int layer, qreal curve, int cap, int style);
+	QDomElement genText(QDomElement & text, const QString & value, const Placement &);
+	QDomElement genCircle(QDomElement & circle, const Placement &);
+	QDomElement genRect(QDomElement & rect, const Placement &);
+	QDomElement genPolygon(QDomElement & polygon, const Placement &);
+	QDomElement genContact(QDomElement & padOrSmd, const Placement &, const QString & elementName);
+	QDomElement genPad(QDomElement & pad, const Placement &, const QString & signal);
+	QDomElement genSmd(QDomElement & smd, const Placement &, const QString & signal);
+	QDomElement genHole(QDomElement & hole, const Placement &);
+	QDomElement genVia(QDomElement & via);
+	QDomElement genFrame(QDomElement & frame, const Placement &);
+	QDomElement genGroup(const QString & tagName);
+
+	Placement parseRot(const QString & rot);
+	QPointF map(const Placement &, qreal x, qreal y);
+	QPointF mapMM(const Placement &, const QDomElement &, const QString & xName, const QString & yName);
+	qreal mapAngle(const Placement &, qreal angle);
+	int mapLayer(const Placement &, int layer);
+	void extend(const QPointF &, qreal margin);
+	qreal restring(qreal diameter, qreal drill, qreal ratio, qreal minimum, qreal maximum);
+
+protected:
+	QDomDocument m_doc;
+	QHash<QString, QDomElement> m_packages;				// library + '\n' + package
+	QHash<QString, QString> m_contactSignals;			// element + '\n' + pad or smd name
+	QHash<QString, QString> m_classNames;
+	QHash<QString, QString> m_designRules;
+	QSet<int> m_usedLayers;
+	Area m_boardArea;
+	Area m_packageArea;
+	bool m_inPackage;
+};
+
+#endif // BRDREADER_H
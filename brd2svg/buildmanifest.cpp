@@ -0,0 +1,132 @@
+#include "buildmanifest.h"
+
+#include <QFile>
+#include <QCryptographicHash>
+#include <QDomDocument>
+#include <QTextStream>
+#include <QtDebug>
+
+BuildManifest::BuildManifest()
+{
+}
+
+bool BuildManifest::load(const QString & path)
+{
+	m_entries.clear();
+
+	QFile file(path);
+	if (!file.exists()) return true;
+
+	QString errorStr;
+	int errorLine;
+	int errorColumn;
+	QDomDocument doc;
+	if (!doc.setContent(&file, true, &errorStr, &errorLine, &errorColumn)) {
+		qDebug() << QString("unable to parse manifest '%1': %2 line:%3 col:%4").arg(path).arg(errorStr).arg(errorLine).arg(errorColumn);
+		return false;
+	}
+
+	QDomElement board = doc.documentElement().firstChildElement("board");
+	while (!board.isNull()) {
+		ManifestEntry entry;
+		entry.brdHash = board.attribute("brd");
+		entry.inputsHash = board.attribute("inputs");
+		QDomElement subpart = board.firstChildElement("subpart");
+		while (!subpart.isNull()) {
+			entry.subparts << subpart.attribute("path");
+			subpart = subpart.nextSiblingElement("subpart");
+		}
+		QDomElement package = board.firstChildElement("package");
+		while (!package.isNull()) {
+			entry.packageNames << package.attribute("name");
+			package = package.nextSiblingElement("package");
+		}
+		m_entries.insert(board.attribute("name"), entry);
+		board = board.nextSiblingElement("board");
+	}
+
+	return true;
+}
+
+bool BuildManifest::save(const QString & path)
+{
+	QDomDocument doc;
+	QDomElement root = doc.createElement("manifest");
+	doc.appendChild(root);
+
+	QStringList names = m_entries.keys();
+	qSort(names);
+	foreach (QString name, names) {
+		ManifestEntry entry = m_entries.value(name);
+		QDomElement board = doc.createElement("board");
+		root.appendChild(board);
+		board.setAttribute("name", name);
+		board.setAttribute("brd", entry.brdHash);
+		board.setAttribute("inputs", entry.inputsHash);
+		foreach (QString subpart, entry.subparts) {
+			QDomElement element = doc.createElement("subpart");
+			board.appendChild(element);
+			element.setAttribute("path", subpart);
+		}
+		foreach (QString packageName, entry.packageNames) {
+			QDomElement element = doc.createElement("package");
+			board.appendChild(element);
+			element.setAttribute("name", packageName);
+		}
+	}
+
+	QFile file(path);
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+		qDebug() << "unable to save manifest" << path;
+		return false;
+	}
+
+	QTextStream out(&file);
+	out.setCodec("UTF-8");
+	doc.save(out, 1, QDomNode::EncodingFromTextStream);
+	file.close();
+	return true;
+}
+
+bool BuildManifest::contains(const QString & brdname) const
+{
+	return m_entries.contains(brdname);
+}
+
+ManifestEntry BuildManifest::entry(const QString & brdname) const
+{
+	return m_entries.value(brdname);
+}
+
+void BuildManifest::setEntry(const QString & brdname, const ManifestEntry & entry)
+{
+	m_entries.insert(brdname, entry);
+}
+
+void BuildManifest::removeEntry(const QString & brdname)
+{
+	m_entries.remove(brdname);
+}
+
+QString BuildManifest::hashFile(const QString & path)
+{
+	// a missing file hashes to the empty string, which never matches a real hash
+	QFile file(path);
+	if (!file.open(QIODevice::ReadOnly)) return "";
+
+	QCryptographicHash hash(QCryptographicHash::Sha1);
+	while (!file.atEnd()) {
+		hash.addData(file.read(1024 * 1024));
+	}
+	return QString(hash.result().toHex());
+}
+
+QString BuildManifest::hashStrings(const QStringList & strings)
+{
+	QCryptographicHash hash(QCryptographicHash::Sha1);
+	foreach (QString string, strings) {
+		hash.addData(string.toUtf8());
+		hash.addData("\n", 1);
+	}
+	return QString(hash.result().toHex());
+}
@@ -0,0 +1,37 @@
+#ifndef BUILDMANIFEST_H
+#define BUILDMANIFEST_H
+
+#include <QHash>
+#include <QStringList>
+
+// Remembers what each board was last converted from, so that boards whose inputs haven't changed
+// can be skipped and boards whose .brd changed get their xml exported again.
+
+struct ManifestEntry {
+	QString brdHash;
+	QString inputsHash;
+	QStringList subparts;			// subpart svgs the board pulled in
+	QStringList packageNames;
+};
+
+class BuildManifest
+{
+public:
+	BuildManifest();
+
+	bool load(const QString & path);
+	bool save(const QString & path);
+
+	bool contains(const QString & brdname) const;
+	ManifestEntry entry(const QString & brdname) const;
+	void setEntry(const QString & brdname, const ManifestEntry &);
+	void removeEntry(const QString & brdname);
+
+	static QString hashFile(const QString & path);
+	static QString hashStrings(const QStringList &);
+
+protected:
+	QHash<QString, ManifestEntry> m_entries;
+};
+
+#endif // BUILDMANIFEST_H
@@ -1,6 +1,8 @@
 #include "miscutils.h"
 #include <QtDebug>
 #include <qmath.h>
+#include <QHash>
+#include <QPair>
 #include "utils/textutils.h"
 #include "svg/svgfilesplitter.h"
 
@@ -414,37 +416,42 @@ QString MiscUtils::makeGeneric(const QDir & workingFolder, const QString & board
 
 	if (!gotIncludes) return svg;
 
-	QDomDocument doc;
-	TextUtils::mergeSvg(doc, svg, "breadboard");
-
+	QList<QDomDocument> fragments;
 	for (int i = 0; i < halfPowers; i++) {
 		qreal x = (i * 100) + 50 - (sWidth * 1000 / 2);
 		QDomElement power = powers.at(i);
 		qreal y = height - 50 - (sHeight * 1000 / 2);
         if (power.attribute("empty", "").isEmpty()) {
-		    includeSvg2(doc, includesFolder.absoluteFilePath("bb_pin.svg"), getConnectorIndex(power), x + xOffset, y);
+		    fragments.append(includeSvg2(includesFolder.absoluteFilePath("bb_pin.svg"), getConnectorIndex(power), x + xOffset, y));
         }
 	
 		power = powers.at(powers.count() - 1 - i);
         if (power.attribute("empty", "").isEmpty()) {
-		    includeSvg2(doc, includesFolder.absoluteFilePath("bb_pin.svg"), getConnectorIndex(power), x + xOffset, 50 - (sHeight * 1000 / 2));
+		    fragments.append(includeSvg2(includesFolder.absoluteFilePath("bb_pin.svg"), getConnectorIndex(power), x + xOffset, 50 - (sHeight * 1000 / 2)));
         }
 	}
 
+	QDomDocument doc;
+	TextUtils::mergeSvg(doc, svg, "breadboard");
+	QDomElement target = mergeTarget(doc, "breadboard");
+	foreach (QDomDocument fragment, fragments) {
+		spliceSvg(target, fragment, "breadboard");
+	}
+
 	svg = TextUtils::mergeSvgFinish(doc);
 
 	return svg;
 }
 
-void MiscUtils::includeSvg2(QDomDocument & doc, const QString & path, const QString & name, qreal x, qreal y) {
+QDomDocument MiscUtils::includeSvg2(const QString & path, const QString & name, qreal x, qreal y) {
 	QFile file(path);
 	if (!file.exists()) {
 		qDebug() << "file '" << path << "' not found.";
-		return;
+		return QDomDocument();
 	}
 
 	SvgFileSplitter splitter;
-	if (!splitter.load(&file)) return;
+	if (!splitter.load(&file)) return QDomDocument();
 
 	QDomDocument subDoc = splitter.domDocument();
 	QDomElement root = subDoc.documentElement();
@@ -458,13 +465,253 @@ void MiscUtils::includeSvg2(QDomDocument & doc, const QString & path, const QStr
 	QHash<QString, QString> attributes;
 	attributes.insert("transform", QString("translate(%1,%2)").arg(x).arg(y));
 	splitter.gWrap(attributes);
-	TextUtils::mergeSvg(doc, splitter.toString(), "breadboard");
+	return splitter.domDocument();
+}
+
+QDomElement MiscUtils::mergeTarget(QDomDocument & doc, const QString & id)
+{
+	// where TextUtils::mergeSvg() would put the merged children; look it up once for all the fragments
+	QDomElement root = doc.documentElement();
+	QDomElement target = TextUtils::findElementWithAttribute(root, "id", id);
+	if (target.isNull()) return root;
+
+	return target;
+}
+
+void MiscUtils::spliceSvg(QDomElement & target, const QDomDocument & fragment, const QString & id)
+{
+	// same as TextUtils::mergeSvg(), but takes the fragment's dom instead of serializing and parsing it again
+	QDomElement root = fragment.documentElement();
+	if (root.tagName() != "svg") return;
+	if (target.isNull()) return;
+
+	QDomElement source = TextUtils::findElementWithAttribute(root, "id", id);
+	if (source.isNull()) source = root;
+
+	QDomDocument doc = target.ownerDocument();
+	QDomNode node = source.firstChild();
+	while (!node.isNull()) {
+		target.appendChild(doc.importNode(node, true));
+		node = node.nextSibling();
+	}
+}
+
+// presentation attributes that children inherit, with their svg defaults
+static const char * InheritedStyles[][2] = {
+	{ "fill", "black" },
+	{ "fill-opacity", "1" },
+	{ "fill-rule", "nonzero" },
+	{ "stroke", "none" },
+	{ "stroke-width", "1" },
+	{ "stroke-linecap", "butt" },
+	{ "stroke-linejoin", "miter" },
+	{ "stroke-miterlimit", "4" },
+	{ "stroke-opacity", "1" },
+	{ NULL, NULL }
+};
+
+static bool keepsStyles(const QDomElement & element)
+{
+	// Fritzing reads connector geometry from the element's own attributes, and the content of
+	// <defs> and friends inherits from wherever it ends up being used
+	static const char * Referenced[] = { "defs", "symbol", "pattern", "marker", "clipPath", "mask", NULL };
+	for (int i = 0; Referenced[i] != NULL; i++) {
+		if (element.tagName() == Referenced[i]) return true;
+	}
+
+	return element.attribute("id").startsWith("connector");
+}
+
+static void dropInheritedStyles(QDomElement & element, QHash<QString, QString> inherited, QHash<QString, int> & styleSets)
+{
+	if (keepsStyles(element)) return;
+
+	if (element.attribute("opacity") == "1") element.removeAttribute("opacity");
+
+	QString styleSet;
+	for (int i = 0; InheritedStyles[i][0] != NULL; i++) {
+		QString name = InheritedStyles[i][0];
+		if (!element.hasAttribute(name)) continue;
+
+		QString value = element.attribute(name);
+		if (inherited.value(name, InheritedStyles[i][1]) == value) {
+			element.removeAttribute(name);
+			continue;
+		}
+
+		inherited.insert(name, value);
+		styleSet += name + ":" + value + ";";
+	}
+
+	if (styleSet.count(';') > 1) {
+		styleSets.insert(styleSet, styleSets.value(styleSet, 0) + 1);
+	}
+
+	QDomElement child = element.firstChildElement();
+	while (!child.isNull()) {
+		dropInheritedStyles(child, inherited, styleSets);
+		child = child.nextSiblingElement();
+	}
+}
+
+static void useStyleClasses(QDomElement & element, const QHash<QString, QString> & classes)
+{
+	if (keepsStyles(element)) return;
+
+	QString styleSet;
+	for (int i = 0; InheritedStyles[i][0] != NULL; i++) {
+		QString name = InheritedStyles[i][0];
+		if (element.hasAttribute(name)) {
+			styleSet += name + ":" + element.attribute(name) + ";";
+		}
+	}
+
+	QString className = classes.value(styleSet);
+	if (!className.isEmpty()) {
+		for (int i = 0; InheritedStyles[i][0] != NULL; i++) {
+			element.removeAttribute(InheritedStyles[i][0]);
+		}
+		QString current = element.attribute("class");
+		element.setAttribute("class", current.isEmpty() ? className : current + " " + className);
+	}
+
+	QDomElement child = element.firstChildElement();
+	while (!child.isNull()) {
+		useStyleClasses(child, classes);
+		child = child.nextSiblingElement();
+	}
+}
+
+static void nameStyleClasses(const QDomElement & element, const QHash<QString, int> & styleSets, QHash<QString, QString> & classes, QString & css)
+{
+	if (keepsStyles(element)) return;
+
+	QString styleSet;
+	for (int i = 0; InheritedStyles[i][0] != NULL; i++) {
+		QString name = InheritedStyles[i][0];
+		if (element.hasAttribute(name)) {
+			styleSet += name + ":" + element.attribute(name) + ";";
+		}
+	}
+	if (styleSets.value(styleSet, 0) > 1 && !classes.contains(styleSet)) {
+		QString className = QString("s%1").arg(classes.count());
+		classes.insert(styleSet, className);
+		css += QString(".%1{%2}\n").arg(className).arg(styleSet);
+	}
+
+	QDomElement child = element.firstChildElement();
+	while (!child.isNull()) {
+		nameStyleClasses(child, styleSets, classes, css);
+		child = child.nextSiblingElement();
+	}
+}
+
+QString MiscUtils::compactSvg(const QString & svg)
+{
+	QDomDocument doc;
+	if (!doc.setContent(svg)) return svg;
+
+	QDomElement root = doc.documentElement();
+	QHash<QString, int> styleSets;
+	dropInheritedStyles(root, QHash<QString, QString>(), styleSets);
+
+	// style sets used more than once become classes, numbered in the order they first appear
+	QHash<QString, QString> classes;
+	QString css;
+	nameStyleClasses(root, styleSets, classes, css);
+
+	if (classes.isEmpty()) return doc.toString(-1);
+
+	useStyleClasses(root, classes);
+
+	QDomElement style = doc.createElement("style");
+	style.setAttribute("type", "text/css");
+	style.appendChild(doc.createTextNode(css));
+	QDomElement before = root.firstChildElement();
+	while (before.tagName() == "title" || before.tagName() == "desc") {
+		before = before.nextSiblingElement();
+	}
+	root.insertBefore(style, before);
+
+	return doc.toString(-1);
+}
+
+// eagle's internal resolution is 0.1 micron: brd2xml writes mils and .lbr files mm, and endpoints
+// less than a grid step apart are the same point
+static const qreal GridPerMil = 254;
+static const qreal GridPerMm = 10000;
+
+typedef QPair<qint64, qint64> GridPoint;
+
+struct WireEnd {
+	WireTree * wireTree;
+	int end;						// 1 or 2
+	int order;						// ends in wire order, end 1 before end 2
+	QPointF p;						// in grid steps
+};
+
+static bool byOrder(const WireEnd & e1, const WireEnd & e2)
+{
+	return e1.order < e2.order;
+}
+
+static GridPoint snapToGrid(const QPointF & p)
+{
+	return GridPoint(qRound64(p.x()), qRound64(p.y()));
+}
+
+static QList<WireEnd> nearbyEnds(const QHash<GridPoint, QList<WireEnd> > & ends, const QPointF & p)
+{
+	// two points a hair apart can round into neighbouring cells, so look at all the cells around
+	GridPoint cell = snapToGrid(p);
+	QList<WireEnd> nearby;
+	for (qint64 dx = -1; dx <= 1; dx++) {
+		for (qint64 dy = -1; dy <= 1; dy++) {
+			foreach (WireEnd wireEnd, ends.value(GridPoint(cell.first + dx, cell.second + dy))) {
+				if (qAbs(wireEnd.p.x() - p.x()) <= 1 && qAbs(wireEnd.p.y() - p.y()) <= 1) {
+					nearby.append(wireEnd);
+				}
+			}
+		}
+	}
+
+	qSort(nearby.begin(), nearby.end(), byOrder);
+	return nearby;
 }
 
-bool MiscUtils::makeWireTrees(QList<QDomElement> & wireList, QList<WireTree *> & wireTrees) 
+static bool linkWireEnd(WireTree * wireTree, bool start, const QList<WireEnd> & candidates)
 {
+	// candidates are in wire order, end 1 before end 2, so the links are the same as the old all-pairs search
+	foreach (WireEnd wireEnd, candidates) {
+		WireTree * wt = wireEnd.wireTree;
+		if (wt == wireTree) continue;
+
+		WireTree * & link = (wireEnd.end == 1) ? wt->left : wt->right;
+		if (link != NULL) continue;
+
+		link = wireTree;
+		if (start) wireTree->left = wt;
+		else wireTree->right = wt;
+		return true;
+	}
+
+	return false;
+}
+
+bool MiscUtils::makeWireTrees(QList<QDomElement> & wireList, QList<WireTree *> & wireTrees, Units units) 
+{
+	qreal grid = (units == Millimeters) ? GridPerMm : GridPerMil;
+	QHash<GridPoint, QList<WireEnd> > ends;
 	foreach (QDomElement wire, wireList) {
 		WireTree * wireTree = new WireTree(wire);
+		for (int end = 1; end <= 2; end++) {
+			WireEnd wireEnd;
+			wireEnd.wireTree = wireTree;
+			wireEnd.end = end;
+			wireEnd.order = wireTrees.count() * 2 + end - 1;
+			wireEnd.p = (end == 1) ? QPointF(wireTree->x1 * grid, wireTree->y1 * grid) : QPointF(wireTree->x2 * grid, wireTree->y2 * grid);
+			ends[snapToGrid(wireEnd.p)].append(wireEnd);
+		}
 		wireTrees.append(wireTree);
 	}
 
@@ -472,44 +719,10 @@ bool MiscUtils::makeWireTrees(QList<QDomElement> & wireList, QList<WireTree *> &
 
 	foreach (WireTree * wireTree, wireTrees) {
 		if (!wireTree->left) {
-			foreach (WireTree * wt, wireTrees) {
-				if (wt == wireTree) continue;
-
-				if (wireTree->x1 == wt->x1 && wireTree->y1 == wt->y1) {
-					if (wt->left == NULL) {
-						wireTree->left = wt;
-						wt->left = wireTree;
-						break;
-					}
-				}
-				if (wireTree->x1 == wt->x2 && wireTree->y1 == wt->y2) {
-					if (wt->right == NULL) {
-						wireTree->left = wt;
-						wt->right = wireTree;
-						break;
-					}
-				}
-			}
+			linkWireEnd(wireTree, true, nearbyEnds(ends, QPointF(wireTree->x1 * grid, wireTree->y1 * grid)));
 		}
 		if (!wireTree->right) {
-			foreach (WireTree * wt, wireTrees) {
-				if (wt == wireTree) continue;
-
-				if (wireTree->x2 == wt->x1 && wireTree->y2 == wt->y1) {
-					if (wt->left == NULL) {
-						wireTree->right = wt;
-						wt->left = wireTree;
-						break;
-					}
-				}
-				if (wireTree->x2 == wt->x2 && wireTree->y2 == wt->y2) {
-					if (wt->right == NULL) {
-						wireTree->right = wt;
-						wt->right = wireTree;
-						break;
-					}
-				}
-			}
+			linkWireEnd(wireTree, false, nearbyEnds(ends, QPointF(wireTree->x2 * grid, wireTree->y2 * grid)));
 		}
 
 		if (wireTree->left == NULL || wireTree->right == NULL)  {
@@ -531,6 +744,65 @@ bool MiscUtils::makeWireTrees(QList<QDomElement> & wireList, QList<WireTree *> &
 	return true;
 }
 
+static qreal distanceToSegment(const QPointF & p, const QPointF & a, const QPointF & b)
+{
+	QPointF ab = b - a;
+	qreal lengthSquared = ab.x() * ab.x() + ab.y() * ab.y();
+	qreal t = 0;
+	if (lengthSquared > 0) {
+		t = qBound((qreal) 0, ((p.x() - a.x()) * ab.x() + (p.y() - a.y()) * ab.y()) / lengthSquared, (qreal) 1);
+	}
+
+	QPointF d = p - (a + ab * t);
+	return qSqrt(d.x() * d.x() + d.y() * d.y());
+}
+
+QVector<int> MiscUtils::simplifyPolyline(const QVector<QPointF> & points, qreal tolerance)
+{
+	// Douglas-Peucker: the ends always stay; a point in between stays if it is the furthest from
+	// the chord of its span and further than tolerance.  A span is measured against its chord as a
+	// segment rather than a line, so a closed run (first point == last) still works.
+	// The caller keeps arcs out of the points, so arc ends are always the ends of a run.
+	QVector<int> kept;
+	int count = points.count();
+	if (count < 3) {
+		for (int i = 0; i < count; i++) kept.append(i);
+		return kept;
+	}
+
+	QVector<bool> keep(count, false);
+	keep[0] = keep[count - 1] = true;
+
+	// an explicit stack, since a long run of tiny segments would go deep
+	QVector< QPair<int, int> > spans;
+	spans.append(qMakePair(0, count - 1));
+	while (!spans.isEmpty()) {
+		QPair<int, int> span = spans.last();
+		spans.remove(spans.count() - 1);
+
+		qreal maxDistance = 0;
+		int maxIndex = -1;
+		for (int i = span.first + 1; i < span.second; i++) {
+			qreal distance = distanceToSegment(points.at(i), points.at(span.first), points.at(span.second));
+			if (distance > maxDistance) {
+				maxDistance = distance;
+				maxIndex = i;
+			}
+		}
+
+		if (maxIndex < 0 || maxDistance <= tolerance) continue;
+
+		keep[maxIndex] = true;
+		spans.append(qMakePair(span.first, maxIndex));
+		spans.append(qMakePair(maxIndex, span.second));
+	}
+
+	for (int i = 0; i < count; i++) {
+		if (keep.at(i)) kept.append(i);
+	}
+	return kept;
+}
+
 
 bool MiscUtils::rwaa(QDomElement & element, qreal & radius, qreal & width, qreal & angle1, qreal & angle2)
 {
@@ -0,0 +1,115 @@
+#include "subpartcache.h"
+
+#include "utils/textutils.h"
+#include "svg/svgfilesplitter.h"
+
+#include <QFile>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QtDebug>
+
+struct CachedSubpart {
+	bool ok;
+	QDomDocument doc;				// normalized; never changed once cached
+	qreal width, height;
+};
+
+static QMutex CacheMutex;
+static QHash<QString, CachedSubpart> Cache;			// dpi/path
+static int Hits = 0;
+static int Misses = 0;
+
+// call with CacheMutex locked
+static const CachedSubpart & lookup(const QString & path, qreal dpi)
+{
+	QString key = QString("%1/%2").arg(dpi).arg(path);
+	QHash<QString, CachedSubpart>::const_iterator it = Cache.constFind(key);
+	if (it != Cache.constEnd()) {
+		Hits++;
+		return it.value();
+	}
+
+	Misses++;
+	CachedSubpart subpart;
+	subpart.ok = false;
+	subpart.width = subpart.height = 0;
+
+	SvgFileSplitter splitter;
+	QFile file(path);
+	if (splitter.load(&file)) {
+		double factor;
+		splitter.normalize(dpi, "", false, factor);
+
+		qreal vbWidth, vbHeight;
+		subpart.doc = splitter.domDocument();
+		TextUtils::getSvgSizes(subpart.doc, subpart.width, subpart.height, vbWidth, vbHeight);
+		subpart.ok = true;
+	}
+	else {
+		qDebug() << "unable to load subpart" << path;
+	}
+
+	return Cache.insert(key, subpart).value();
+}
+
+bool SubpartCache::size(const QString & path, qreal dpi, qreal & width, qreal & height)
+{
+	QMutexLocker locker(&CacheMutex);
+	const CachedSubpart & subpart = lookup(path, dpi);
+	width = subpart.width;
+	height = subpart.height;
+	return subpart.ok;
+}
+
+void SubpartCache::splice(const QString & path, qreal dpi, const QList<SvgWrapper> & wrappers, QDomElement & target, const QString & id)
+{
+	if (target.isNull()) return;
+
+	QMutexLocker locker(&CacheMutex);
+	const CachedSubpart & subpart = lookup(path, dpi);
+	if (!subpart.ok) return;
+
+	QDomElement root = subpart.doc.documentElement();
+	if (root.tagName() != "svg") return;
+
+	QDomDocument doc = target.ownerDocument();
+
+	// mergeSvg takes the children of a matching id inside the subpart, which leaves the wrappers behind
+	QDomElement source = TextUtils::findElementWithAttribute(root, "id", id);
+	if (!source.isNull()) {
+		QDomNode node = source.firstChild();
+		while (!node.isNull()) {
+			target.appendChild(doc.importNode(node, true));
+			node = node.nextSibling();
+		}
+		return;
+	}
+
+	QDomElement parent = target;
+	for (int i = wrappers.count() - 1; i >= 0; i--) {
+		QDomElement g = doc.createElement("g");
+		foreach (QString name, wrappers.at(i).keys()) {
+			g.setAttribute(name, wrappers.at(i).value(name));
+		}
+		parent.appendChild(g);
+		parent = g;
+	}
+
+	QDomNode node = root.firstChild();
+	while (!node.isNull()) {
+		parent.appendChild(doc.importNode(node, true));
+		node = node.nextSibling();
+	}
+}
+
+int SubpartCache::hits()
+{
+	QMutexLocker locker(&CacheMutex);
+	return Hits;
+}
+
+int SubpartCache::misses()
+{
+	QMutexLocker locker(&CacheMutex);
+	return Misses;
+}
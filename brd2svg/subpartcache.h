@@ -0,0 +1,28 @@
+#ifndef SUBPARTCACHE_H
+#define SUBPARTCACHE_H
+
+#include <QDomElement>
+#include <QHash>
+#include <QList>
+#include <QString>
+
+// Subpart svgs loaded and normalized once per run and shared by every board, instead of being
+// read and normalized again for each package that uses them.  Boards are converted on several
+// threads, so the cached documents are only touched while holding the cache's lock.
+
+typedef QHash<QString, QString> SvgWrapper;		// attributes of a <g> wrapped around the subpart
+
+class SubpartCache
+{
+public:
+	// size in inches of the subpart at path normalized to dpi; false if it can't be loaded
+	static bool size(const QString & path, qreal dpi, qreal & width, qreal & height);
+
+	// like SvgFileSplitter::gWrap() with each wrapper (innermost first) followed by MiscUtils::spliceSvg()
+	static void splice(const QString & path, qreal dpi, const QList<SvgWrapper> & wrappers, QDomElement & target, const QString & id);
+
+	static int hits();
+	static int misses();
+};
+
+#endif // SUBPARTCACHE_H
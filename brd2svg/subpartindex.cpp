@@ -0,0 +1,100 @@
+#include "subpartindex.h"
+
+#include <QDir>
+#include <QFileInfo>
+
+SubpartIndex::SubpartIndex()
+{
+	m_exists = false;
+}
+
+void SubpartIndex::scan(const QString & folderPath)
+{
+	m_files.clear();
+	m_names.clear();
+	m_aliases.clear();
+
+	QDir folder(folderPath);
+	m_folderPath = folder.absolutePath();
+	m_exists = folder.exists();
+	if (!m_exists) return;
+
+	foreach (QString fileName, folder.entryList(QStringList() << "*.svg", QDir::Files, QDir::Name)) {
+		QString name = fileName.left(fileName.length() - 4);
+		m_files.insert(name, fileName);
+		// on a case-sensitive file system the first of two names differing only in case wins
+		if (!m_names.contains(name.toLower())) m_names.insert(name.toLower(), name);
+	}
+}
+
+void SubpartIndex::addAliases(const QHash<QString, QString> & aliases)
+{
+	foreach (QString package, aliases.keys()) {
+		QString name = aliases.value(package);
+		if (m_files.contains(name)) {
+			m_aliases.insert(package.toLower(), name);
+		}
+		else if (m_names.contains(name.toLower())) {
+			m_aliases.insert(package.toLower(), m_names.value(name.toLower()));
+		}
+	}
+}
+
+bool SubpartIndex::exists() const
+{
+	return m_exists;
+}
+
+QString SubpartIndex::folderPath() const
+{
+	return m_folderPath;
+}
+
+QString SubpartIndex::find(const QString & packageName) const
+{
+	// a subpart named after the package beats an alias
+	if (m_files.contains(packageName)) return packageName;
+
+	QString lower = packageName.toLower();
+	QString name = m_names.value(lower);
+	if (!name.isEmpty()) return name;
+
+	return m_aliases.value(lower);
+}
+
+QString SubpartIndex::path(const QString & subpartName) const
+{
+	return QDir(m_folderPath).absoluteFilePath(m_files.value(subpartName, subpartName + ".svg"));
+}
+
+QStringList SubpartIndex::files() const
+{
+	QStringList files = m_files.values();
+	files.sort();
+	return files;
+}
+
+QString SubpartIndex::dump() const
+{
+	QString dump = QString("subparts in %1: %2 svgs, %3 aliases\n").arg(m_folderPath).arg(m_files.count()).arg(m_aliases.count());
+	if (!m_exists) {
+		dump += "\tfolder not found\n";
+		return dump;
+	}
+
+	QStringList names = m_files.keys();
+	names.sort();
+	foreach (QString name, names) {
+		dump += QString("\t%1 -> %2\n").arg(name).arg(path(name));
+	}
+
+	QStringList packages = m_aliases.keys();
+	packages.sort();
+	foreach (QString package, packages) {
+		QString name = m_aliases.value(package);
+		QString note = (m_names.contains(package)) ? " (unused, a subpart has the package's name)" : "";
+		dump += QString("\t%1 => %2 -> %3%4\n").arg(package).arg(name).arg(path(name)).arg(note);
+	}
+
+	return dump;
+}
@@ -0,0 +1,33 @@
+#ifndef SUBPARTINDEX_H
+#define SUBPARTINDEX_H
+
+#include <QHash>
+#include <QStringList>
+
+// The subpart svgs in one folder, listed once per run so finding the subpart for a package
+// doesn't stat the (possibly network mounted) subparts folder.  Package names are matched
+// ignoring case; the <map> aliases from all.packages.txt resolve to the subpart they name.
+
+class SubpartIndex
+{
+public:
+	SubpartIndex();
+
+	void scan(const QString & folderPath);
+	void addAliases(const QHash<QString, QString> & aliases);		// lower-case package name -> subpart name
+	bool exists() const;
+	QString folderPath() const;
+	QString find(const QString & packageName) const;				// subpart name, or empty
+	QString path(const QString & subpartName) const;				// absolute path of the svg
+	QStringList files() const;										// file names, sorted
+	QString dump() const;
+
+protected:
+	QString m_folderPath;
+	bool m_exists;
+	QHash<QString, QString> m_files;				// subpart name -> file name
+	QHash<QString, QString> m_names;				// lower-case subpart name -> subpart name
+	QHash<QString, QString> m_aliases;				// lower-case package name -> subpart name
+};
+
+#endif // SUBPARTINDEX_H
@@ -0,0 +1,62 @@
+#ifndef SVGWRITER_H
+#define SVGWRITER_H
+
+#include <QPointF>
+#include <QString>
+
+// Appends svg markup straight onto the output string, instead of building a temporary QString for
+// every .arg() of a QString("<circle ... '%1' ... '%8'") template.  By default numbers are formatted
+// the way QString::arg(double) formats them; after setPrecision(n) they are rounded to n decimal
+// places with trailing zeros dropped, using integer arithmetic only.
+// Lengths (number() and numeric attributes) are multiplied by the writer's scale, so a generator
+// working in mils can write its output at another resolution; format anything else with formatNumber().
+// Path points go through absolute() and point(), which track the pen so that with setCompact(true)
+// point() writes coordinates relative to the previous point.
+// The markup is not byte for byte what the old templates wrote: attributes come in the order the
+// generator adds them, and end() closes an element with " />\n".
+//
+//     SvgWriter(svg).start("circle").attribute("cx", cx).attribute("fill", "none").end();
+
+class SvgWriter
+{
+public:
+	SvgWriter(QString & svg, qreal scale = 1);
+
+	SvgWriter & start(const char * tagName);						// <tagName
+	SvgWriter & attribute(const char * name, const QString & value);
+	SvgWriter & attribute(const char * name, const char * value);
+	SvgWriter & attribute(const char * name, qreal value);			// scaled
+	SvgWriter & startAttribute(const char * name);					// name='  (then raw() and number() the value)
+	SvgWriter & endAttribute();										// '
+	SvgWriter & endStart();											// >
+	SvgWriter & end();												// />
+	SvgWriter & close(const char * tagName);						// </tagName>
+	SvgWriter & number(qreal);										// scaled
+	SvgWriter & absolute(qreal x, qreal y, QPointF & pen);			// x,y scaled; pen is left on the point as written
+	SvgWriter & point(qreal x, qreal y, QPointF & pen);				// like absolute(), or relative to pen when compact
+	SvgWriter & raw(const char *);
+	SvgWriter & raw(const QString &);
+	SvgWriter & text(const QString &);								// TextUtils::escapeAnd()
+
+	static qreal appendNumber(QString & svg, qreal);				// returns the value as written
+	static QString formatNumber(qreal);
+	static void setPrecision(int decimals);						// -1 restores QString::arg(double) formatting
+	static int precision();
+	static bool validPrecision(int decimals);
+	static QString benchmark(int count);
+	static void setCompact(bool);								// relative path commands (see also MiscUtils::compactSvg)
+	static bool compact();
+	static const char * command(char absoluteCommand);			// 'L' or 'A', in the case point() needs
+
+public:
+	static const int MaxPrecision = 9;
+
+protected:
+	SvgWriter & delta(qreal value, qreal & pen);
+
+protected:
+	QString & m_svg;
+	qreal m_scale;
+};
+
+#endif // SVGWRITER_H
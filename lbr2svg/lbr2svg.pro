@@ -13,6 +13,7 @@ INCLUDEPATH += $$FRITZING_SRC
 QT += xml \
     xmlpatterns \
     network \
+    concurrent \
    # gui \
    # widgets \
    # core \
@@ -23,7 +24,13 @@ CONFIG   -= app_bundle
 TEMPLATE = app
 SOURCES += main.cpp \
     lbrapplication.cpp \
+    libraryloader.cpp \
     miscutils.cpp \
+    nameindex.cpp \
+    outputwriter.cpp \
+    svgwriter.cpp \
+    taskgraph.cpp \
+    zipwriter.cpp \
    # ../brd2svg/brdapplication.cpp \
    # $$FRITZING_SRC/utils/graphicsutils.cpp  \
     $$FRITZING_SRC/utils/textutils.cpp \
@@ -37,7 +44,13 @@ SOURCES += main.cpp \
 
 
 HEADERS += lbrapplication.h \
+   libraryloader.h \
    miscutils.h \
+   nameindex.h \
+   outputwriter.h \
+   svgwriter.h \
+   taskgraph.h \
+   zipwriter.h \
    # ../brd2svg/brdapplication.h \
     $$FRITZING_SRC/installedfonts.h \
     $$FRITZING_SRC/utils/textutils.h \
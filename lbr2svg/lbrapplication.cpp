@@ -1,5 +1,9 @@
 #include "lbrapplication.h"
+#include "libraryloader.h"
 #include "miscutils.h"
+#include "outputwriter.h"
+#include "svgwriter.h"
+#include "zipwriter.h"
 #include "utils/textutils.h"
 #include "utils/schematicrectconstants.h"
 #include "svg/svgfilesplitter.h"
@@ -14,6 +18,9 @@
 #include <QBitArray>
 #include <limits>
 #include <QGuiApplication>
+#include <QThreadPool>
+#include <QThreadStorage>
+#include <QtConcurrentMap>
 
 ///////////////////////////////////////////////////////////
 
@@ -44,24 +51,12 @@ static const QString BreadboardSilkColor("#f8f8f8");
 
 static const QString PropSeparator("___");
 static const double TextSizeMultiplier = 1.3;
-static int MixIndex = 0;
 
-static QHash<QString, QString> PackageConnectors;
-static QHash<QString, QString> PackageConnectorTypes;
-static QHash<QString, QString> SymbolConnectors;
-static QHash<QString, int> PackageConnectorIndexes;
-static QHash<QString, int> SymbolConnectorIndexes;
-static QList<QString> AllSMDs;
-static QHash<QString, QString> OldBreadboardFiles;
+// copy before matching: a QRegExp keeps its match state, and libraries are prepped on several threads
+static const QRegExp Dipper("di[lp][\\s\\-_]{0,1}\\d");
 
-static QHash<QString, QString> Breakouts;
-
-static QSet<QString> SchematicIcons;
-
-static QRegExp dipper("di[lp][\\s\\-_]{0,1}\\d");
-
-// temporary for debugging
-static QStringList SquareNames;
+// simplified-away segments, counted per thread while a symbol or package is written
+static QThreadStorage<int> SegmentsRemoved;
 
 
 ///////////////////////////////////////////////////////////
@@ -245,18 +240,20 @@ QRegExp FindDigits("[^\\d]*(\\d+)");
 
 bool byAttribute(QDomElement & e1, QDomElement & e2, const QString & attr)
 {
+    // indexIn() keeps the captures in the QRegExp, so each call works on its own copy
+    QRegExp findDigits(FindDigits);
     QString p1 = e1.attribute(attr);
-    int p1ix = FindDigits.indexIn(p1);
+    int p1ix = findDigits.indexIn(p1);
     int pn1 = -1;
     if (p1ix >= 0) {
-        pn1 = FindDigits.cap(1).toInt();
+        pn1 = findDigits.cap(1).toInt();
     }
 
     QString p2 = e2.attribute(attr);
-    int p2ix = FindDigits.indexIn(p2);
+    int p2ix = findDigits.indexIn(p2);
     int pn2 = -1;
     if (p2ix >= 0) {
-        pn2 = FindDigits.cap(1).toInt();
+        pn2 = findDigits.cap(1).toInt();
     }
 
     if (p1ix >= 0 && p2ix >= 0) {
@@ -301,8 +298,8 @@ QString getConnectorIndex(const QDomElement & element) {
     return id;
 }
 
-QString makeJoinedName(const QStringList & names) {
-	return QString("%1_mix_%2").arg(names.at(0)).arg(MixIndex++);
+QString makeJoinedName(const QStringList & names, int index) {
+	return QString("%1_mix_%2").arg(names.at(0)).arg(index);
 }
 
 ///////////////////////////////////////////////////////////
@@ -333,6 +330,81 @@ PartDescr::PartDescr(const QHash<QString, int> indexes, const QStringList & valu
 
 ///////////////////////////////////////////////////////////
 
+static bool bundlePart(const QString & fzpPath, const QHash<QString, QDir> & viewFolders, const QSet<QString> & failures, QList<ZipEntry> & bundle)
+{
+	// discarded parts have no fzp left
+	if (!QFile::exists(fzpPath)) return false;
+
+	if (failures.contains(fzpPath)) {
+		qDebug() << "no fzpz for" << fzpPath << "since it wasn't written";
+		return false;
+	}
+
+	QFile file(fzpPath);
+	if (!file.open(QIODevice::ReadOnly)) return false;
+
+	QByteArray fzp = file.readAll();
+	file.close();
+
+	QDomDocument doc;
+	if (!doc.setContent(fzp)) {
+		qDebug() << "unable to bundle" << fzpPath;
+		return false;
+	}
+
+	// named the way Fritzing bundles parts; an svg that isn't in the parts folders is an existing core svg
+	QList<ZipEntry> entries;
+	entries.append(ZipWriter::compress("part." + QFileInfo(fzpPath).fileName(), fzp));
+	QSet<QString> images;
+	QDomNodeList layers = doc.elementsByTagName("layers");
+	for (int i = 0; i < layers.count(); i++) {
+		QString image = layers.at(i).toElement().attribute("image");
+		if (images.contains(image)) continue;
+
+		images.insert(image);
+		QString view = image.section('/', 0, 0);
+		QString name = image.section('/', 1);
+		if (!viewFolders.contains(view)) continue;
+
+		QString svgPath = viewFolders.value(view).absoluteFilePath(name);
+		if (failures.contains(svgPath)) {
+			qDebug() << "no fzpz for" << fzpPath << "since" << svgPath << "wasn't written";
+			return false;
+		}
+
+		QFile svg(svgPath);
+		if (!svg.open(QIODevice::ReadOnly)) continue;
+
+		entries.append(ZipWriter::compress(QString("svg.%1.%2").arg(view).arg(name), svg.readAll()));
+		svg.close();
+	}
+
+	bundle = entries;
+	return true;
+}
+
+///////////////////////////////////////////////////////////
+
+class ConvertLibrary
+{
+public:
+	typedef LibraryResult result_type;
+
+	ConvertLibrary(const LibraryRun & run) : m_run(run) {}
+
+	LibraryResult operator()(const QString & filename) const {
+		LibraryResult result;
+		LibraryContext libraryContext(m_run);
+		result.converted = libraryContext.convert(filename, result);
+		return result;
+	}
+
+protected:
+	const LibraryRun & m_run;
+};
+
+///////////////////////////////////////////////////////////
+
 
 LbrApplication::LbrApplication(int &argc, char **argv[]) : QGuiApplication(argc, *argv)
 {   
@@ -358,11 +430,12 @@ void LbrApplication::start()
 	QDir fzpFolder, breadboardFolder, schematicFolder, pcbFolder, iconFolder;
 	if (!MiscUtils::makePartsDirectories(workingFolder, m_core, fzpFolder, breadboardFolder, schematicFolder, pcbFolder, iconFolder)) return;
 
+	OutputWriter::start(m_fsync ? OutputWriter::SyncAtEnd : OutputWriter::NoSync);
+
     QFile::remove(workingFolder.absoluteFilePath("newlbrs.csv"));
-	QFile lbr(workingFolder.absoluteFilePath("lbr.csv"));
-	lbr.open(QFile::WriteOnly);
-	QTextStream lbrStream(&lbr);
-	lbrStream.setCodec("UTF-8");
+    m_newLbrs.clear();
+	QString lbrCsv;
+	QTextStream lbrStream(&lbrCsv);
 	lbrStream << "new FZP,FZP Disp,nr,part admin,old FZP,new Bread,Bread Disp,old Bread,new Schem,Schem Disp,old Schem,new PCB,PCB Disp,old PCB,title,description,family,props,tags\n";
 	lbrStream << "\n";
 	lbrStream << ",";
@@ -381,14 +454,16 @@ void LbrApplication::start()
 	binsFolder.cd("bins");
 	if (!binsFolder.exists()) {
 		qDebug() << QString("unable to make bins folder:%1").arg(binsFolder.absolutePath());
-		return;	
+		OutputWriter::finish();
+		return;
 	}
 
 	QDir lbrFolder(workingFolder);
 	lbrFolder.cd("lbrs");
 	if (!lbrFolder.exists()) {
 		qDebug() << QString("unable to find lbrs folder:%1").arg(lbrFolder.absolutePath());
-		return;	
+		OutputWriter::finish();
+		return;
 	}
 
     loadPartsDescrs(workingFolder, "new lbr parts.dif");
@@ -399,77 +474,68 @@ void LbrApplication::start()
 	QStringList nameFilters;
 	nameFilters << "*.lbr";
 	QStringList fileList = lbrFolder.entryList(nameFilters, QDir::Files | QDir::NoDotAndDotDot);
-    QStringList moduleIDs;
-	foreach (QString filename, fileList) {
-		SchematicIcons.clear();
-		PackageConnectors.clear();
-		PackageConnectorTypes.clear();
-		SymbolConnectors.clear();
-        PackageConnectorIndexes.clear();
-        SymbolConnectorIndexes.clear();
-        AllSMDs.clear();
-        OldBreadboardFiles.clear();
-
-		QFile file(lbrFolder.absoluteFilePath(filename));
-		QString errorStr;
-		int errorLine;
-		int errorColumn;
-		QDomDocument doc;
-		if (!doc.setContent(&file, true, &errorStr, &errorLine, &errorColumn)) {		
-			qDebug() << "unable to parse file" << lbrFolder.absoluteFilePath(filename);
-			continue;
+
+	LibraryRun run;
+	run.lbrPath = lbrFolder.absolutePath();
+	run.workingPath = workingFolder.absolutePath();
+	run.fzpPath = fzpFolder.absolutePath();
+	run.breadboardPath = breadboardFolder.absolutePath();
+	run.schematicPath = schematicFolder.absolutePath();
+	run.pcbPath = pcbFolder.absolutePath();
+	run.iconPath = iconFolder.absolutePath();
+	run.binsPath = binsFolder.absolutePath();
+	run.subpartsPath = subpartsFolder.absolutePath();
+	run.partDescrs = m_partDescrs;
+	run.simplifyTolerance = m_simplifyTolerance;
+	if (!m_fritzingPartsPath.isEmpty()) {
+		QDir dir(m_fritzingPartsPath);
+		dir.cd("svg");
+		dir.cd("core");
+		dir.cd("breadboard");
+		QStringList nameFilters;
+		nameFilters << "*_breadboard.svg";
+		foreach (QString fn, dir.entryList(nameFilters, QDir::Files | QDir::NoDotAndDotDot)) {
+			run.breadboardFiles.add(fn.toLower());
 		}
+	}
 
-		QFileInfo info(file);
-		QString libraryName = info.completeBaseName();
+	// the devices, symbols and packages inside each library share one pool, so a single big
+	// library still keeps every job busy; it is separate from the pool the libraries run on,
+	// since a library waits for its own tasks to finish
+	QThreadPool taskPool;
+	taskPool.setMaxThreadCount(m_jobs);
+	run.taskPool = (m_jobs > 1) ? &taskPool : NULL;
 
-		qDebug() << "\nparsing" << filename;
+	// each library gets its own LibraryContext; results come back in fileList order either way
+	QList<LibraryResult> results;
+	if (m_jobs > 1 && fileList.count() > 1) {
+		QThreadPool::globalInstance()->setMaxThreadCount(m_jobs);
+		results = QtConcurrent::blockingMapped< QList<LibraryResult> >(fileList, ConvertLibrary(run));
+	}
+	else {
+		ConvertLibrary convertLibrary(run);
+		foreach (QString filename, fileList) {
+			results.append(convertLibrary(filename));
+		}
+	}
 
-		QDomElement root = doc.documentElement();
-        QDomNodeList nodeList = root.elementsByTagName("text");
-        QList<QDomElement> toDelete;
-        for (int i = 0; i < nodeList.count(); i++) {
-            QDomElement element = nodeList.at(i).toElement();
-            QString text = element.text();
-            if (text.compare(">name", Qt::CaseInsensitive) == 0 || text.compare(">value", Qt::CaseInsensitive) == 0) {
-                toDelete.append(element);
-            }
-        }
-        foreach (QDomElement element, toDelete) {
-            element.parentNode().removeChild(element);
-        }
+    QStringList moduleIDs;
+	foreach (LibraryResult result, results) {
+		if (!result.converted) continue;
 
-        prepPCBs(root);
-        
-		moduleIDs.append(makeFZPs(workingFolder, fzpFolder, breadboardFolder, schematicFolder, pcbFolder, iconFolder, binsFolder, subpartsFolder, libraryName, doc, lbrStream));
-        makeSchematics(schematicFolder, libraryName, root);
-		makePCBs(workingFolder, pcbFolder, breadboardFolder, subpartsFolder, libraryName, root);
-
-		foreach (QString symbolBaseName, SchematicIcons) {
-			QFile file(schematicFolder.absoluteFilePath(symbolBaseName + "_schematic.svg"));
-			if (file.open(QFile::ReadOnly)) {
-				QString svg = file.readAll();
-				file.close();
-				int ix = svg.indexOf("<g id='schematic'>");
-				if (ix < 0) continue;
-
-				svg.insert(ix, "<g id='icon'>");
-				ix = svg.lastIndexOf("</g>");
-				if (ix < 0) continue;
-
-				svg.insert(ix, "</g>");
-				if (file.open(QFile::WriteOnly)) {
-					QTextStream out(&file);
-					out.setCodec("UTF-8");
-					out << svg;
-					file.close();
-				}
-			}
+		moduleIDs.append(result.moduleIDs);
+		lbrStream << result.lbrRows;
+		m_newLbrs += result.newLbrRows;
+		// set here on the main thread, since two libraries can make the same fzp name
+		foreach (QString fzpName, result.matchedParts) {
+			m_partDescrs.value(fzpName)->matched = true;
 		}
-
 	}
  
     makeBin(moduleIDs, "all", binsFolder);
+
+    // nothing still queued may come back after it is removed
+    OutputWriter::flush();
     
     QList<QString> removed;
 
@@ -516,35 +582,228 @@ void LbrApplication::start()
         }
     }
 
-	lbr.close();
+	lbrStream.flush();
+	OutputWriter::write(workingFolder.absoluteFilePath("lbr.csv"), lbrCsv.toUtf8(), false);
+    if (!m_newLbrs.isEmpty()) {
+        OutputWriter::write(workingFolder.absoluteFilePath("newlbrs.csv"), m_newLbrs.toUtf8(), false);
+    }
 
     qSort(removed);
-    QFile rem(workingFolder.absoluteFilePath("removed.txt"));
-	rem.open(QFile::WriteOnly);
-	QTextStream remStream(&rem);
+    QString rem;
     foreach(QString r, removed) {
-        remStream << r << "\n";
+        rem += r + "\n";
+    }
+    OutputWriter::write(workingFolder.absoluteFilePath("removed.txt"), rem.toUtf8(), false);
+
+	if (m_fzpz) {
+		// the svgs are only final once the removals above are done, so the bundles are read back from the parts folders
+		OutputWriter::flush();
+		qDebug() << "generating fzpz";
+		QHash<QString, QDir> viewFolders;
+		viewFolders.insert("breadboard", breadboardFolder);
+		viewFolders.insert("schematic", schematicFolder);
+		viewFolders.insert("pcb", pcbFolder);
+		viewFolders.insert("icon", iconFolder);
+		QSet<QString> failures = OutputWriter::failures().toSet();
+		QDir fzpzFolder(workingFolder.absoluteFilePath("fzpz"));
+		QList<ZipEntry> archive;
+		foreach (QString moduleID, moduleIDs) {
+			QString fzpName = cleanChars(moduleID).toLower() + ".fzp";
+			QList<ZipEntry> bundle;
+			if (!bundlePart(fzpFolder.absoluteFilePath(fzpName), viewFolders, failures, bundle)) continue;
+
+			OutputWriter::write(fzpzFolder.absoluteFilePath(QFileInfo(fzpName).completeBaseName() + ".fzpz"), ZipWriter::archive(bundle), false);
+			if (m_fzpzArchive) archive.append(bundle);
+		}
+
+		if (m_fzpzArchive) {
+			qDebug() << "generating fzbz";
+			QFile binFile(binsFolder.absoluteFilePath("all.fzb"));
+			if (binFile.open(QIODevice::ReadOnly)) {
+				archive.append(ZipWriter::compress("all.fzb", binFile.readAll()));
+				binFile.close();
+			}
+			QString fzbzPath = binsFolder.absoluteFilePath("all.fzbz");
+			OutputWriter::write(fzbzPath, ZipWriter::archive(archive), false);
+			OutputWriter::flush();
+			if (OutputWriter::failures().contains(fzbzPath)) {
+				qDebug() << "unable to write the fzbz" << fzbzPath;
+			}
+		}
+	}
+
+    OutputWriter::finish();
+    qDebug() << OutputWriter::stats();
+    foreach (QString path, OutputWriter::failures()) {
+        qDebug() << "not written:" << path;
     }
-    rem.close();
 }
 
-QStringList LbrApplication::makeFZPs(const QDir & workingFolder, const QDir & fzpFolder, const QDir & breadFolder, const QDir & schematicFolder, const QDir & pcbFolder, const QDir & iconFolder, const QDir & binsFolder,  const QDir & subpartsFolder, const QString & libraryName, QDomDocument & doc, QTextStream & lbrStream)
+///////////////////////////////////////////////////////////
+
+LibraryContext::LibraryContext(const LibraryRun & run) : m_run(run), m_graph(this)
+{
+	m_mixIndex = 0;
+}
+
+LibraryContext::~LibraryContext()
+{
+	qDeleteAll(m_tasks);
+}
+
+bool LibraryContext::convert(const QString & filename, LibraryResult & result)
+{
+	QDir lbrFolder(m_run.lbrPath);
+	QDir binsFolder(m_run.binsPath);
+
+	QString errorStr;
+	int errorLine;
+	int errorColumn;
+	QDomDocument doc;
+	// >name and >value texts are dropped while the file is read
+	if (!LibraryLoader::load(lbrFolder.absoluteFilePath(filename), doc, errorStr, errorLine, errorColumn)) {
+		qDebug() << "unable to parse file" << lbrFolder.absoluteFilePath(filename) << errorStr << errorLine << errorColumn;
+		return false;
+	}
+
+	QString libraryName = QFileInfo(filename).completeBaseName();
+
+	qDebug() << "\nparsing" << filename;
+
+	QDomElement root = doc.documentElement();
+
+    // the package connector tables are filled in first, since every device reads them
+    prepPCBs(root);
+
+	// then a task per device, symbol and package, run once the tasks they depend on are done
+	m_libraryName = libraryName;
+	makeFZPs(doc);
+    makeSchematics(root);
+	makePCBs(root);
+	m_graph.run(m_run.taskPool);
+
+	QTextStream lbrStream(&result.lbrRows);
+	result.moduleIDs = collectFZPs(binsFolder, lbrStream);
+	lbrStream.flush();
+
+	qSort(m_squareNames);
+    foreach (QString name, m_squareNames) {
+        qDebug() << "square" << (libraryName.toLower() + "_" + name.toLower() + "_pcb.svg");
+    }
+
+	if (m_run.simplifyTolerance > 0) {
+		qDebug() << "segments removed by simplifying: schematic" << m_segmentsRemovedByView.value("schematic")
+					<< "pcb" << m_segmentsRemovedByView.value("pcb") << "breadboard" << m_segmentsRemovedByView.value("breadboard");
+	}
+
+	result.newLbrRows = m_newLbrs;
+	result.matchedParts = m_matchedParts;
+	return true;
+}
+
+int LibraryContext::addTask(LibraryTask * task)
+{
+	m_tasks.append(task);
+	return m_graph.add();
+}
+
+void LibraryContext::addDeviceTask(const QDomElement & device, const QString & symbol, const QString & description, const QDomElement & deviceSet, bool useGate)
+{
+	LibraryTask * task = new LibraryTask;
+	task->kind = LibraryTask::Device;
+	task->element = device;
+	task->symbol = symbol;
+	task->description = description;
+	task->deviceSetName = deviceSet.attribute("name");
+	task->deviceSetPrefix = deviceSet.attribute("prefix");
+	task->useGate = useGate;
+	int id = addTask(task);
+
+	// a device without a package uses its schematic as its icon and breadboard image, so the
+	// symbol's svg gets wrapped in an icon layer when it is written
+	if (device.attribute("package", "").isEmpty()) {
+		m_schematicIcons.insert(m_libraryName.toLower() + "_" + cleanChars(symbol).toLower());
+	}
+
+	// devices sharing a package or a symbol run in library order: the first device to name a
+	// symbol pin picks its connector id, and the last device to name a breakout wins
+	QString package = device.attribute("package");
+	if (!package.isEmpty()) {
+		if (m_packageDevices.contains(package)) m_graph.depend(id, m_packageDevices.value(package));
+		m_packageDevices.insert(package, id);
+	}
+	if (m_symbolDevices.contains(symbol)) m_graph.depend(id, m_symbolDevices.value(symbol));
+	m_symbolDevices.insert(symbol, id);
+}
+
+void LibraryContext::addSymbolTask(const QDomElement & symbol)
+{
+	LibraryTask * task = new LibraryTask;
+	task->kind = LibraryTask::Symbol;
+	task->element = symbol;
+	int id = addTask(task);
+
+	QString name = symbol.attribute("name");
+	if (m_symbolDevices.contains(name)) m_graph.depend(id, m_symbolDevices.value(name));
+}
+
+void LibraryContext::addPackageTask(const QDomElement & package)
 {
-    Q_UNUSED(pcbFolder);
-    Q_UNUSED(breadFolder);
+	LibraryTask * task = new LibraryTask;
+	task->kind = LibraryTask::Package;
+	task->element = package;
+	int id = addTask(task);
 
+	QString name = package.attribute("name");
+	if (m_packageDevices.contains(name)) m_graph.depend(id, m_packageDevices.value(name));
+}
+
+static QDomElement ownCopy(const QDomElement & element, QDomDocument & doc)
+{
+	// processSymbol and processPackage rewrite attributes and add nodes as they go; QDom is only
+	// reentrant, so a task works on a copy in a document of its own and the library's document
+	// is only ever read while the tasks run
+	QDomElement copy = doc.importNode(element, true).toElement();
+	doc.appendChild(copy);
+	return copy;
+}
+
+void LibraryContext::runTask(int id)
+{
+	LibraryTask * task = m_tasks.at(id);
+	switch (task->kind) {
+		case LibraryTask::Device:
+			task->pair = processDevice(QDir(m_run.workingPath), QDir(m_run.fzpPath), QDir(m_run.iconPath), QDir(m_run.subpartsPath), task->element, task->symbol, task->description, m_libraryName, task->deviceSetName, task->deviceSetPrefix, task->useGate, task->lbrRow, task->newLbrRow);
+			break;
+		case LibraryTask::Symbol:
+		{
+			QDomDocument own;
+			QDomElement symbol = ownCopy(task->element, own);
+			processSymbol(QDir(m_run.schematicPath), symbol, m_libraryName);
+			break;
+		}
+		case LibraryTask::Package:
+		{
+			QDomDocument own;
+			QDomElement package = ownCopy(task->element, own);
+			processPackage(QDir(m_run.workingPath), QDir(m_run.subpartsPath), QDir(m_run.pcbPath), QDir(m_run.breadboardPath), package, m_libraryName);
+			break;
+		}
+	}
+}
+
+void LibraryContext::makeFZPs(QDomDocument & doc)
+{
 	QDomElement root = doc.documentElement();
 
 	QDomElement drawing = root.firstChildElement("drawing");
-	if (drawing.isNull()) return QStringList();
+	if (drawing.isNull()) return;
 
 	QDomElement library = drawing.firstChildElement("library");
-	if (library.isNull()) return QStringList();
+	if (library.isNull()) return;
 
 	QDomElement deviceSets = library.firstChildElement("devicesets");
-	if (deviceSets.isNull()) return QStringList();
-
-	QMultiHash<QString, QString> families;
+	if (deviceSets.isNull()) return;
 
 	QDomElement deviceSet = deviceSets.firstChildElement("deviceset");
 	while (!deviceSet.isNull()) {
@@ -574,11 +833,7 @@ QStringList LbrApplication::makeFZPs(const QDir & workingFolder, const QDir & fz
 			QDomElement devices = deviceSet.firstChildElement("devices");
 			QDomElement device = devices.firstChildElement("device");
 			while (!device.isNull()) {
-                QHash<QString, QString> pair = processDevice(workingFolder, fzpFolder, iconFolder, subpartsFolder, device, symbolNames.at(0), description, libraryName, deviceSet.attribute("name"), deviceSet.attribute("prefix"), false, lbrStream);
-				if (pair.count() == 1) {
-                    QString moduleID = pair.keys().at(0);
-                    families.insert(pair.value(moduleID), moduleID);
-                }
+                addDeviceTask(device, symbolNames.at(0), description, deviceSet, false);
 				device = device.nextSiblingElement("device");
 			}
 		}
@@ -588,7 +843,7 @@ QStringList LbrApplication::makeFZPs(const QDir & workingFolder, const QDir & fz
 		else if (symbolNames.count() > 1) {
 			QDomElement tempSymbol = doc.createElement("symbol");
 			root.appendChild(tempSymbol);
-			QString tempSymbolName = makeJoinedName(symbolNames);
+			QString tempSymbolName = makeJoinedName(symbolNames, m_mixIndex++);
 			tempSymbol.setAttribute("name", tempSymbolName);
 			//qDebug() << "multiple symbols" << tempSymbolName;
 
@@ -638,18 +893,30 @@ QStringList LbrApplication::makeFZPs(const QDir & workingFolder, const QDir & fz
 			QDomElement devices = deviceSet.firstChildElement("devices");
 			QDomElement device = devices.firstChildElement("device");
 			while (!device.isNull()) {
-				QHash<QString, QString> pair = processDevice(workingFolder, fzpFolder, iconFolder, subpartsFolder, device, tempSymbolName, description, libraryName, deviceSet.attribute("name"), deviceSet.attribute("prefix"), true, lbrStream);
-				if (pair.count() == 1) {
-                    QString moduleID = pair.keys().at(0);
-                    families.insert(pair.value(moduleID), moduleID);
-                }
+				addDeviceTask(device, tempSymbolName, description, deviceSet, true);
 				device = device.nextSiblingElement("device");
 			}
-			processSymbol(schematicFolder, tempSymbol, libraryName);
+			addSymbolTask(tempSymbol);
 		}
 
 		deviceSet = deviceSet.nextSiblingElement("deviceset");
 	}
+}
+
+QStringList LibraryContext::collectFZPs(const QDir & binsFolder, QTextStream & lbrStream)
+{
+	// csv rows and bin entries in library order, whatever order the devices ran in
+	QMultiHash<QString, QString> families;
+	foreach (LibraryTask * task, m_tasks) {
+		if (task->kind != LibraryTask::Device) continue;
+
+		lbrStream << task->lbrRow;
+		m_newLbrs += task->newLbrRow;
+		if (task->pair.count() == 1) {
+			QString moduleID = task->pair.keys().at(0);
+			families.insert(task->pair.value(moduleID), moduleID);
+		}
+	}
 
     QStringList moduleIDs;
 	foreach (QString family, families.uniqueKeys()) {
@@ -667,13 +934,13 @@ QStringList LbrApplication::makeFZPs(const QDir & workingFolder, const QDir & fz
         moduleIDs.append(moduleID);
 	}
 
-    makeBin(moduleIDs, libraryName, binsFolder);
+    LbrApplication::makeBin(moduleIDs, m_libraryName, binsFolder);
 
     return families.values();
 
 }
 
-void LbrApplication::makePCBs(const QDir & workingFolder, const QDir & pcbFolder, const QDir & breadboardFolder,  const QDir & subpartsFolder, const QString & libraryName, const QDomElement & root)
+void LibraryContext::makePCBs(const QDomElement & root)
 {
 	QDomElement drawing = root.firstChildElement("drawing");
 	if (drawing.isNull()) return;
@@ -686,18 +953,12 @@ void LbrApplication::makePCBs(const QDir & workingFolder, const QDir & pcbFolder
 
 	QDomElement package = packages.firstChildElement("package");
 	while (!package.isNull()) {
-		processPackage(workingFolder, subpartsFolder, pcbFolder, breadboardFolder, package, libraryName);
+		addPackageTask(package);
 		package = package.nextSiblingElement("package");
 	}
-
-    foreach (QString name, SquareNames) {
-        qDebug() << "square" << (libraryName.toLower() + "_" + name.toLower() + "_pcb.svg");
-    }
-
-    SquareNames.clear();
 }
 
-void LbrApplication::prepPCBs(const QDomElement & root)
+void LibraryContext::prepPCBs(const QDomElement & root)
 {
 	QDomElement drawing = root.firstChildElement("drawing");
 	if (drawing.isNull()) return;
@@ -716,7 +977,7 @@ void LbrApplication::prepPCBs(const QDomElement & root)
 }
 
 
-void LbrApplication::makeSchematics(const QDir & schematicFolder, const QString & libraryName, const QDomElement & root)
+void LibraryContext::makeSchematics(const QDomElement & root)
 {
 	QDomElement drawing = root.firstChildElement("drawing");
 	if (drawing.isNull()) return;
@@ -729,12 +990,12 @@ void LbrApplication::makeSchematics(const QDir & schematicFolder, const QString
 
 	QDomElement symbol = symbols.firstChildElement("symbol");
 	while (!symbol.isNull()) {
-		processSymbol(schematicFolder, symbol, libraryName);
+		addSymbolTask(symbol);
 		symbol = symbol.nextSiblingElement("symbol");
 	}
 }
 
-QHash<QString, QString> LbrApplication::processDevice(const QDir & workingFolder, const QDir & fzpFolder,  const QDir & iconFolder, const QDir & subpartsFolder, const QDomElement & device, const QString & symbol, QString description, const QString & libraryName, const QString & deviceSetName, const QString & deviceSetPrefix, bool useGate, QTextStream & lbrStream)
+QHash<QString, QString> LibraryContext::processDevice(const QDir & workingFolder, const QDir & fzpFolder,  const QDir & iconFolder, const QDir & subpartsFolder, const QDomElement & device, const QString & symbol, QString description, const QString & libraryName, const QString & deviceSetName, const QString & deviceSetPrefix, bool useGate, QString & lbrRow, QString & newLbrRow)
 {
 	//qDebug() << "processing device" << device.attribute("name");
 
@@ -758,12 +1019,13 @@ QHash<QString, QString> LbrApplication::processDevice(const QDir & workingFolder
 	moduleID = cleanChars2(moduleID);
 	QString fzpName = cleanChars(moduleID).toLower() + ".fzp";
 
-    PartDescr * partDescr = m_partDescrs.value(fzpName, NULL);
+    PartDescr * partDescr = m_run.partDescrs.value(fzpName, NULL);
     if (partDescr == NULL) {
         qDebug() << QString("Part descriptor for '%1' not found in google doc").arg(fzpName);
     }
     else {
-        partDescr->matched = true;
+        QMutexLocker locker(&m_mutex);
+        m_matchedParts.append(fzpName);
     }
 
 	fzp += QString("<module fritzingVersion='%2' moduleId='%1'>\n").arg(moduleID).arg("0.7.2b");
@@ -797,14 +1059,15 @@ QHash<QString, QString> LbrApplication::processDevice(const QDir & workingFolder
 	properties.insert("package", cleanChars2(package).toLower());
 
     bool breakout = false;
-    bool throughHole = !AllSMDs.contains(ccPackage);
+    bool throughHole = !m_allSMDs.contains(ccPackage);
 
     bool usePinheader = false;
 
     bool discarded = false;
     if (partDescr == NULL) {
         if (!throughHole) {
-            Breakouts.insert(package, "_____");
+            QMutexLocker locker(&m_mutex);
+            m_breakouts.insert(package, "_____");
             breakout = true;
         }
     }
@@ -820,7 +1083,8 @@ QHash<QString, QString> LbrApplication::processDevice(const QDir & workingFolder
             }
         }
         else if (partDescr->bread.disp.contains("breakout", Qt::CaseInsensitive)) {
-            Breakouts.insert(package, "_____");
+            QMutexLocker locker(&m_mutex);
+            m_breakouts.insert(package, "_____");
             breakout = true;
         }
         else if (partDescr->bread.disp.contains("program", Qt::CaseInsensitive)) {
@@ -932,7 +1196,6 @@ QHash<QString, QString> LbrApplication::processDevice(const QDir & workingFolder
 
     fzp += QString("<breadboardView>\n");
 	if (schematicOnly) {
-		SchematicIcons.insert(symbolBaseName);
 		fzp += QString("<layers image='schematic/%1'>\n").arg(schematicBaseName);
 		fzp += QString("<layer layerId='schematic'/>\n");
 	}
@@ -980,7 +1243,10 @@ QHash<QString, QString> LbrApplication::processDevice(const QDir & workingFolder
         QString path = subpartsFolder.absoluteFilePath("breadboard/" + subpartName + ".svg");
         QFileInfo info(path); 
         if (info.exists()) {
-            Breakouts.insert(package, subpartName);
+            {
+                QMutexLocker locker(&m_mutex);
+                m_breakouts.insert(package, subpartName);
+            }
 		    fzp += QString("<layers image='icon/%1.svg'>\n").arg(subpartName);
             QFile icon(path);
             icon.copy(iconFolder.absoluteFilePath(subpartName + ".svg"));
@@ -1014,20 +1280,24 @@ QHash<QString, QString> LbrApplication::processDevice(const QDir & workingFolder
 		if (useGate) {
 			gate = connect.attribute("gate") + " ";
 		}
-		QString padValue = PackageConnectors.value(padProp, "");
+		QString symbolProp = symbol + PropSeparator + gate + connect.attribute("pin");
+		QString padValue, padType, symbolValue;
+		{
+			QMutexLocker locker(&m_mutex);
+			padValue = m_packageConnectors.value(padProp, "");
+			padType = m_packageConnectorTypes.value(padProp);
+			symbolValue = m_symbolConnectors.value(symbolProp, "");
+			if (symbolValue.isEmpty()) {
+				symbolValue = padValue; // QString("connector%1pin").arg(symbolConnectorIndex++);
+				symbolValue.replace("pad", "pin");
+				m_symbolConnectors.insert(symbolProp, symbolValue);
+			}
+		}
         if (padValue.isEmpty()) {
             qDebug() << "no padValue for" << padProp;
         }
 		QString connectorID(padValue);
 
-		QString symbolProp = symbol + PropSeparator + gate + connect.attribute("pin");
-		QString symbolValue = SymbolConnectors.value(symbolProp, "");
-        if (symbolValue.isEmpty()) {
-            symbolValue = padValue; // QString("connector%1pin").arg(symbolConnectorIndex++);
-            symbolValue.replace("pad", "pin");
-            SymbolConnectors.insert(symbolProp, symbolValue);
-        }
-
 		int p = symbolProp.lastIndexOf(PropSeparator);
         bool onBus = false;
         QString preName = symbolProp.mid(p + PropSeparator.length());
@@ -1068,7 +1338,7 @@ QHash<QString, QString> LbrApplication::processDevice(const QDir & workingFolder
             QString pv = padValue;
             if (usePinheader) pv.replace("pad", "pin");
 
-			if (PackageConnectorTypes.value(padProp).compare("pad", Qt::CaseInsensitive) == 0) {
+			if (padType.compare("pad", Qt::CaseInsensitive) == 0) {
 				fzp += QString("<p layer='copper0' svgId='%1'/>\n").arg(pv);
 			}
 			fzp += QString("<p layer='copper1' svgId='%1'/>\n").arg(pv);
@@ -1096,13 +1366,7 @@ QHash<QString, QString> LbrApplication::processDevice(const QDir & workingFolder
     }
 	fzp += QString("</module>\n");
 
-	QFile file(fzpFolder.absoluteFilePath(fzpName));
-	if (file.open(QIODevice::WriteOnly | QIODevice::Text)) {
-		QTextStream out(&file);
-		out.setCodec("UTF-8");
-		out << fzp;
-		file.close();
-	}
+	OutputWriter::write(fzpFolder.absoluteFilePath(fzpName), fzp.toUtf8());
 
 	QString defaultBehavior = "new";
 	if (ccPackage.toLower().startsWith("1x") || ccPackage.toLower().startsWith("2x")) {
@@ -1147,17 +1411,11 @@ QHash<QString, QString> LbrApplication::processDevice(const QDir & workingFolder
 	lbrStrings << "\n";
 
     foreach (QString string, lbrStrings) {
-        lbrStream << string;
+        lbrRow += string;
     }
 
     if (partDescr == NULL) {
-	    QFile newfile(workingFolder.absoluteFilePath("newlbrs.csv"));
-	    newfile.open(QFile::Append);
-	    QTextStream newStream(&newfile);
-	    newStream.setCodec("UTF-8");
-        foreach (QString string, lbrStrings) {
-            newStream << string;
-        }
+        newLbrRow = lbrRow;
     }
 
     QHash<QString, QString> pair;
@@ -1167,7 +1425,7 @@ QHash<QString, QString> LbrApplication::processDevice(const QDir & workingFolder
     return pair;
 }	
 
-void LbrApplication::processPackage(const QDir & workingFolder, const QDir & subpartsFolder, const QDir & pcbFolder, const QDir & breadboardFolder, const QDomElement & package, const QString & libraryName)
+void LibraryContext::processPackage(const QDir & workingFolder, const QDir & subpartsFolder, const QDir & pcbFolder, const QDir & breadboardFolder, const QDomElement & package, const QString & libraryName)
 {
 	QString packageName = package.attribute("name");
 	//qDebug() << "processing package" << packageName;
@@ -1275,16 +1533,15 @@ void LbrApplication::processPackage(const QDir & workingFolder, const QDir & sub
 	toSvg(package, layers, dimensions, colors, nonconnectorIndex, true, svg);
 	svg += "</g>\n";
 	svg += "</svg>";
+	tallySegmentsRemoved("pcb");
 
-	QFile file(pcbFolder.absoluteFilePath(libraryName.toLower() + "_" + ccPackageName.toLower() + "_pcb.svg"));
-	if (file.open(QIODevice::WriteOnly | QIODevice::Text)) {
-		QTextStream out(&file);
-		out.setCodec("UTF-8");
-		out << svg;
-		file.close();
-	}
+	OutputWriter::write(pcbFolder.absoluteFilePath(libraryName.toLower() + "_" + ccPackageName.toLower() + "_pcb.svg"), svg.toUtf8());
 
-    QString subpartName = Breakouts.value(packageName);
+    QString subpartName;
+    {
+        QMutexLocker locker(&m_mutex);
+        subpartName = m_breakouts.value(packageName);
+    }
 	if (!subpartName.isEmpty()) {
         bool noText = false;
         QString boardName = ccPackageName;
@@ -1346,10 +1603,10 @@ void LbrApplication::processPackage(const QDir & workingFolder, const QDir & sub
 					.arg(BreadboardColor)
 					.arg("none")
 					.arg(0)
-					.arg(0 + dr)
-					.arg(0 + dr)
-					.arg(dimensions.width() - dr - dr)
-					.arg(dimensions.height() - dr - dr);
+					.arg(SvgWriter::formatNumber(0 + dr))
+					.arg(SvgWriter::formatNumber(0 + dr))
+					.arg(SvgWriter::formatNumber(dimensions.width() - dr - dr))
+					.arg(SvgWriter::formatNumber(dimensions.height() - dr - dr));
 
 		pad = package.firstChildElement("pad");
 		while (!pad.isNull()) {
@@ -1382,17 +1639,15 @@ void LbrApplication::processPackage(const QDir & workingFolder, const QDir & sub
         svg.replace(QRegExp("connector(\\d+)pad"), "connector\\1pin");
 	}
 
+	tallySegmentsRemoved("breadboard");
 	QString fn = libraryName.toLower() + "_" + ccPackageName.toLower() + "_breadboard.svg";
-	QFile file2(breadboardFolder.absoluteFilePath(fn));
-	if (file2.open(QIODevice::WriteOnly | QIODevice::Text)) {
-		QTextStream out(&file2);
-		out.setCodec("UTF-8");
-		out << svg;
-		file2.close();
+	if (SvgWriter::compact()) {
+		svg = MiscUtils::compactSvg(svg);
 	}
+	OutputWriter::write(breadboardFolder.absoluteFilePath(fn), svg.toUtf8());
 }
 
-void LbrApplication::processSymbol(const QDir & schematicFolder, QDomElement & symbol, const QString & libraryName)
+void LibraryContext::processSymbol(const QDir & schematicFolder, QDomElement & symbol, const QString & libraryName)
 {
 	QString symbolName = symbol.attribute("name");
 
@@ -1446,22 +1701,25 @@ void LbrApplication::processSymbol(const QDir & schematicFolder, QDomElement & s
     colors.insert("rectfill", SchematicRectConstants::RectFillColor);
     colors.insert("title", SchematicRectConstants::TitleColor);
 
+	QString symbolBaseName = libraryName.toLower() + "_" + symbolName.toLower();
+	bool icon = m_schematicIcons.contains(symbolBaseName);
+
 	QString svg = TextUtils::makeSVGHeader(25.4, 25.4, dimensions.width(), dimensions.height());
+	if (icon) svg += "<g id='icon'>";
 	svg += "<g id='schematic'>\n";
 	toSvg(symbol, layers, dimensions, colors, nonconnectorIndex, false, svg);
-	svg += "</g>\n";
-	svg += "</svg>";
+	svg += "</g>";
+	if (icon) svg += "</g>";
+	svg += "\n</svg>";
+	tallySegmentsRemoved("schematic");
 
-	QFile file(schematicFolder.absoluteFilePath(libraryName.toLower() + "_" + symbolName.toLower() + "_schematic.svg"));
-	if (file.open(QIODevice::WriteOnly | QIODevice::Text)) {
-		QTextStream out(&file);
-		out.setCodec("UTF-8");
-		out << svg;
-		file.close();
+	if (SvgWriter::compact()) {
+		svg = MiscUtils::compactSvg(svg);
 	}
+	OutputWriter::write(schematicFolder.absoluteFilePath(symbolBaseName + "_schematic.svg"), svg.toUtf8());
 }
 
-void LbrApplication::toSvg(const QDomElement & root, const QStringList & layers, const QRectF & bounds, const QHash<QString, QString> & colors, int & nonconnectorIndex, bool package, QString & svg) 
+void LibraryContext::toSvg(const QDomElement & root, const QStringList & layers, const QRectF & bounds, const QHash<QString, QString> & colors, int & nonconnectorIndex, bool package, QString & svg) 
 {
     bool isRectangular = false;
     if (!package) {
@@ -1471,6 +1729,9 @@ void LbrApplication::toSvg(const QDomElement & root, const QStringList & layers,
 	QDomElement element = root.firstChildElement();
     QString rootName = root.attribute("name");
     QList<QDomElement> wires;
+    QString wireColor = colors.value("wire", colors.value("all"));
+    QVector<QPointF> run;				// with --simplify-tolerance, straight wires that join end to end
+    qreal runWidth = 0;
 	while (!element.isNull()) {
 		QString tagName = element.tagName();
 		if (tagName.compare("pin") == 0) ;
@@ -1488,15 +1749,30 @@ void LbrApplication::toSvg(const QDomElement & root, const QStringList & layers,
 		}
 		QString elementLayer = element.attribute("layer");
 		if (layers.contains(elementLayer)) {
-			toSvg(element, bounds, colors, nonconnectorIndex, rootName, package, isRectangular, svg);
+			QPointF p1, p2;
+			qreal width;
+			if (m_run.simplifyTolerance > 0 && straightWire(element, p1, p2, width)) {
+				if (!run.isEmpty() && (width != runWidth || !extendRun(run, p1, p2))) {
+					makeWireRun(run, runWidth, bounds, wireColor, svg);
+				}
+				if (run.isEmpty()) {
+					run << p1 << p2;
+					runWidth = width;
+				}
+			}
+			else {
+				makeWireRun(run, runWidth, bounds, wireColor, svg);
+				toSvg(element, bounds, colors, nonconnectorIndex, rootName, package, isRectangular, svg);
+			}
 		}
 
 		element = element.nextSiblingElement();
 	}
+	makeWireRun(run, runWidth, bounds, wireColor, svg);
 
 }
 
-void LbrApplication::toSvg(QDomElement & element, const QRectF & bounds, const QHash<QString, QString> & colors, int & nonconnectorIndex, const QString & name, bool package, bool isRectangular, QString & svg) 
+void LibraryContext::toSvg(QDomElement & element, const QRectF & bounds, const QHash<QString, QString> & colors, int & nonconnectorIndex, const QString & name, bool package, bool isRectangular, QString & svg) 
 {
 	QString tagName = element.tagName();
 
@@ -1509,13 +1785,15 @@ void LbrApplication::toSvg(QDomElement & element, const QRectF & bounds, const Q
 			return;
 		}
 
-		svg += QString("<circle class='other' cx='%1' cy='%2' r='%3' stroke='%4' stroke-width='%5' fill='none' />\n")
-					.arg(cx - bounds.left())
-					.arg(bounds.bottom() - cy)
-					.arg(radius)
-					.arg(color)
-					.arg(width)
-					;
+		SvgWriter(svg).start("circle")
+			.attribute("class", "other")
+			.attribute("cx", cx - bounds.left())
+			.attribute("cy", bounds.bottom() - cy)
+			.attribute("r", radius)
+			.attribute("stroke", color)
+			.attribute("stroke-width", width)
+			.attribute("fill", "none")
+			.end();
 		return;
 	}
 
@@ -1527,12 +1805,15 @@ void LbrApplication::toSvg(QDomElement & element, const QRectF & bounds, const Q
 		qreal drill = element.attribute("drill", "").toDouble(&ok);
 		if (!ok) return;
 
-		svg += QString("<circle cx='%1' cy='%2' r='%3' stroke='black' stroke-width='0' fill='black' id='nonconn%4' />\n")
-					.arg(cx - bounds.left())
-					.arg(bounds.bottom() - cy)
-					.arg(drill / 2)
-					.arg(nonconnectorIndex++);
-					;
+		SvgWriter(svg).start("circle")
+			.attribute("cx", cx - bounds.left())
+			.attribute("cy", bounds.bottom() - cy)
+			.attribute("r", drill / 2)
+			.attribute("stroke", "black")
+			.attribute("stroke-width", "0")
+			.attribute("fill", "black")
+			.attribute("id", QString("nonconn%1").arg(nonconnectorIndex++))
+			.end();
 		return;
 	}
 
@@ -1567,15 +1848,17 @@ void LbrApplication::toSvg(QDomElement & element, const QRectF & bounds, const Q
 			return;
 		}
 
-		svg += QString("<rect class='other' x='%1' y='%2' width='%3' height='%4' stroke='%5' stroke-width='%6' fill='%7' stroke-linecap='round'/>\n")
-					.arg(x1 - bounds.left())
-					.arg(bounds.bottom() - y2)
-					.arg(x2 - x1)
-					.arg(y2 - y1)
-					.arg("none")
-					.arg(0)
-					.arg(color)
-					;
+		SvgWriter(svg).start("rect")
+			.attribute("class", "other")
+			.attribute("x", x1 - bounds.left())
+			.attribute("y", bounds.bottom() - y2)
+			.attribute("width", x2 - x1)
+			.attribute("height", y2 - y1)
+			.attribute("stroke", "none")
+			.attribute("stroke-width", "0")
+			.attribute("fill", color)
+			.attribute("stroke-linecap", "round")
+			.end();
 		return;
 	}
 
@@ -1592,7 +1875,7 @@ void LbrApplication::toSvg(QDomElement & element, const QRectF & bounds, const Q
 	qDebug() << "toSvg missed tag" << tagName;
 }
 
-bool LbrApplication::checkRectangular(const QDomElement & root, const QRectF & bounds, const QHash<QString, QString> & colors, QString & svg) {
+bool LibraryContext::checkRectangular(const QDomElement & root, const QRectF & bounds, const QHash<QString, QString> & colors, QString & svg) {
     QDomElement element = root.firstChildElement();
 
     QList<QDomElement> wires;
@@ -1616,7 +1899,7 @@ bool LbrApplication::checkRectangular(const QDomElement & root, const QRectF & b
     if (wires.count() < 4) return false;
 
     QList<WireTree *> wireTrees;
-    bool isClosed = MiscUtils::makeWireTrees(wires, wireTrees);
+    bool isClosed = MiscUtils::makeWireTrees(wires, wireTrees, MiscUtils::Millimeters);
     bool isRectangular = false;
     if (isClosed && wireTrees.count() == 4) {
         isRectangular = true;
@@ -1655,10 +1938,10 @@ bool LbrApplication::checkRectangular(const QDomElement & root, const QRectF & b
         QString color = colors.value("all");
 
         QString r = QString("<rect class='interior rect' x='%1' y='%2' width='%3' height='%4' stroke='none' stroke-width='0' fill='%5' />\n")
-                    .arg(minx - bounds.left())
-                    .arg(bounds.bottom() - maxy)
-                    .arg(maxx - minx)
-                    .arg(maxy - miny)
+                    .arg(SvgWriter::formatNumber(minx - bounds.left()))
+                    .arg(SvgWriter::formatNumber(bounds.bottom() - maxy))
+                    .arg(SvgWriter::formatNumber(maxx - minx))
+                    .arg(SvgWriter::formatNumber(maxy - miny))
                     .arg(SchematicRectConstants::RectFillColor);
 
         QStringList names;
@@ -1672,9 +1955,9 @@ bool LbrApplication::checkRectangular(const QDomElement & root, const QRectF & b
         y -= names.count() * (SchematicRectConstants::LabelTextHeight + SchematicRectConstants::LabelTextSpace) / 2;
         foreach (QString name, names) {
             r += QString("<text class='text' id='label' font-family=\"'Droid Sans'\" stroke='none' stroke-width='%4' fill='%5' font-size='%1' x='%2' y='%3' text-anchor='middle'>%8</text>\n")
-				    .arg(SchematicRectConstants::LabelTextHeight)
-				    .arg(((maxx + minx) / 2) - bounds.left())
-				    .arg(y)
+				    .arg(SvgWriter::formatNumber(SchematicRectConstants::LabelTextHeight))
+				    .arg(SvgWriter::formatNumber(((maxx + minx) / 2) - bounds.left()))
+				    .arg(SvgWriter::formatNumber(y))
 				    .arg(0)  // SW(width)
 				    .arg(SchematicRectConstants::TitleColor) 
                     .arg(name)
@@ -1692,18 +1975,142 @@ bool LbrApplication::checkRectangular(const QDomElement & root, const QRectF & b
 
 
 
-void LbrApplication::makePolygon(QDomElement & element, const QRectF & bounds, const QString & color, QString & svg)
+static bool straightWire(const QDomElement & element, QPointF & p1, QPointF & p2, qreal & width)
+{
+	if (element.tagName().compare("wire") != 0) return false;
+
+	qreal x1, y1, x2, y2;
+	if (!MiscUtils::x1y1x2y2(element, x1, y1, x2, y2)) return false;
+
+	bool ok;
+	width = element.attribute("width").toDouble(&ok);
+	if (!ok) return false;
+
+	// makeWire draws these as lines too
+	double curve = element.attribute("curve", "").toDouble(&ok);
+	if (ok && curve != 0 && curve != 360) return false;
+
+	p1 = QPointF(x1, y1);
+	p2 = QPointF(x2, y2);
+	return true;
+}
+
+static bool extendRun(QVector<QPointF> & run, const QPointF & p1, const QPointF & p2)
+{
+	// the first wire of a run may have been drawn in either direction
+	if (run.count() == 2 && (p1 == run.first() || p2 == run.first())) {
+		qSwap(run[0], run[1]);
+	}
+
+	if (p1 == run.last()) {
+		run.append(p2);
+		return true;
+	}
+	if (p2 == run.last()) {
+		run.append(p1);
+		return true;
+	}
+	return false;
+}
+
+void LibraryContext::makeWireRun(QVector<QPointF> & points, qreal width, const QRectF & bounds, const QString & color, QString & svg)
+{
+	if (points.count() == 2) {
+		SvgWriter(svg).start("line")
+			.attribute("class", "other")
+			.attribute("x1", points.at(0).x() - bounds.left())
+			.attribute("y1", bounds.bottom() - points.at(0).y())
+			.attribute("x2", points.at(1).x() - bounds.left())
+			.attribute("y2", bounds.bottom() - points.at(1).y())
+			.attribute("stroke", color)
+			.attribute("stroke-width", width)
+			.attribute("stroke-linecap", "round")
+			.end();
+	}
+	else if (points.count() > 2) {
+		QVector<int> kept = MiscUtils::simplifyPolyline(points, m_run.simplifyTolerance);
+		SegmentsRemoved.localData() += (points.count() - 1) - (kept.count() - 1);
+
+		QString d;
+		QPointF pen;
+		SvgWriter(d).raw("M").absolute(points.first().x() - bounds.left(), bounds.bottom() - points.first().y(), pen);
+		for (int i = 1; i < kept.count(); i++) {
+			const QPointF & p = points.at(kept.at(i));
+			SvgWriter(d).raw(SvgWriter::command('L')).point(p.x() - bounds.left(), bounds.bottom() - p.y(), pen);
+		}
+		SvgWriter(svg).start("path")
+			.attribute("class", "other")
+			.attribute("fill", "none")
+			.attribute("d", d)
+			.attribute("stroke-width", width)
+			.attribute("stroke", color)
+			.attribute("stroke-linecap", "round")
+			.attribute("stroke-linejoin", "round")
+			.end();
+	}
+
+	points.clear();
+}
+
+void LibraryContext::tallySegmentsRemoved(const QString & view)
+{
+	QMutexLocker locker(&m_mutex);
+	m_segmentsRemovedByView[view] += SegmentsRemoved.localData();
+	SegmentsRemoved.localData() = 0;
+}
+
+void LibraryContext::makePolygon(QDomElement & element, const QRectF & bounds, const QString & color, QString & svg)
 {
+	// a vertex with a curve starts an arc to the next vertex; the straight runs between arcs
+	// (or around the whole outline, up to the closing z) can lose points
+	QVector<bool> removed;
+	if (m_run.simplifyTolerance > 0) {
+		QVector<QPointF> points;
+		QVector<bool> curved;
+		QDomElement vertex = element.firstChildElement("vertex");
+		while (!vertex.isNull()) {
+			qreal x, y;
+			if (!xy(vertex, x, y)) break;
+
+			bool cok;
+			qreal curve = vertex.attribute("curve").toDouble(&cok);
+			points.append(QPointF(x, y));
+			curved.append(cok && curve != 0);
+			vertex = vertex.nextSiblingElement("vertex");
+		}
+
+		removed.fill(false, points.count());
+		int i = 0;
+		while (i < points.count()) {
+			int j = i;
+			while (j + 1 < points.count() && !curved.at(j)) j++;
+			if (j - i >= 2) {
+				QVector<int> kept = MiscUtils::simplifyPolyline(points.mid(i, j - i + 1), m_run.simplifyTolerance);
+				for (int k = i + 1; k < j; k++) removed[k] = true;
+				foreach (int k, kept) removed[i + k] = false;
+				SegmentsRemoved.localData() += (j - i) - (kept.count() - 1);
+			}
+			i = j + 1;
+		}
+	}
+
 	QDomElement vertex = element.firstChildElement("vertex");
 	QString d;
+	QPointF pen;
 	bool first = true;
 	bool didCurve = false;
+	int index = 0;
 	while (!vertex.isNull()) {
 		qreal x, y;
 		if (!xy(vertex, x, y)) break;
 
+		if (index < removed.count() && removed.at(index++)) {
+			vertex = vertex.nextSiblingElement("vertex");
+			continue;
+		}
+
 		if (first) {
-			d += QString("M%1,%2").arg(x - bounds.left()).arg(bounds.bottom() - y);
+			SvgWriter(d).raw("M").absolute(x - bounds.left(), bounds.bottom() - y, pen);
 		}
 		bool cok;
 		qreal curve = vertex.attribute("curve").toDouble(&cok);
@@ -1711,7 +2118,7 @@ void LbrApplication::makePolygon(QDomElement & element, const QRectF & bounds, c
 			// qDebug() << "polygon curve" << name;
 
 			if (!(first || didCurve)) {
-				d += QString("L%2,%3").arg(x - bounds.left()).arg(bounds.bottom() - y);
+				SvgWriter(d).raw(SvgWriter::command('L')).point(x - bounds.left(), bounds.bottom() - y, pen);
 			}
 
 			QDomElement next = vertex.nextSiblingElement("vertex");
@@ -1719,12 +2126,12 @@ void LbrApplication::makePolygon(QDomElement & element, const QRectF & bounds, c
 			qreal x2, y2;
 			xy(next, x2, y2);
 
-			d += genArcString(x, y, x2, y2, curve, bounds);
+			d += genArcString(x, y, x2, y2, curve, bounds, pen);
 			didCurve = true;
 		}
 		else {
 			if (!(first || didCurve)) {
-				d += QString("L%2,%3").arg(x - bounds.left()).arg(bounds.bottom() - y);
+				SvgWriter(d).raw(SvgWriter::command('L')).point(x - bounds.left(), bounds.bottom() - y, pen);
 			}
 			didCurve = false;
 		}
@@ -1740,7 +2147,7 @@ void LbrApplication::makePolygon(QDomElement & element, const QRectF & bounds, c
 		.arg(d);
 }
 
-void LbrApplication::makeWire(QDomElement & element, const QRectF & bounds, const QString & color, QString & svg)
+void LibraryContext::makeWire(QDomElement & element, const QRectF & bounds, const QString & color, QString & svg)
 {
 	qreal x1, y1, x2, y2;
 	if (!MiscUtils::x1y1x2y2(element, x1, y1, x2, y2)) {
@@ -1757,29 +2164,33 @@ void LbrApplication::makeWire(QDomElement & element, const QRectF & bounds, cons
 
 	double curve = element.attribute("curve", "").toDouble(&ok);
 	if ((!ok) || (curve == 0) || (curve == 360)) {
-		svg += QString("<line class='other' x1='%1' y1='%2' x2='%3' y2='%4' stroke='%5' stroke-width='%6' stroke-linecap='round'/>\n")
-				.arg(x1 - bounds.left())
-				.arg(bounds.bottom() - y1)
-				.arg(x2 - bounds.left())
-				.arg(bounds.bottom() - y2)
-				.arg(color)
-				.arg(width)
-				;
+		SvgWriter(svg).start("line")
+			.attribute("class", "other")
+			.attribute("x1", x1 - bounds.left())
+			.attribute("y1", bounds.bottom() - y1)
+			.attribute("x2", x2 - bounds.left())
+			.attribute("y2", bounds.bottom() - y2)
+			.attribute("stroke", color)
+			.attribute("stroke-width", width)
+			.attribute("stroke-linecap", "round")
+			.end();
 		return;
 	}
 
-	QString d = genArcString(x1, y1, x2, y2, curve, bounds);
-
-	svg += QString("<path class='other' fill='none' d='M%1,%2 %3' stroke-width='%4' stroke='%5' />\n")
-			.arg(x1 - bounds.left())
-			.arg(bounds.bottom() - y1)
-			.arg(d)
-			.arg(width)
-			.arg(color)
-			;
+	QString d;
+	QPointF pen;
+	SvgWriter(d).raw("M").absolute(x1 - bounds.left(), bounds.bottom() - y1, pen).raw(" ");
+	d += genArcString(x1, y1, x2, y2, curve, bounds, pen);
+	SvgWriter(svg).start("path")
+		.attribute("class", "other")
+		.attribute("fill", "none")
+		.attribute("d", d)
+		.attribute("stroke-width", width)
+		.attribute("stroke", color)
+		.end();
 }
 
-void LbrApplication::makeSmd(QDomElement & element, const QRectF & bounds, const QString & color, const QString & name, bool package, QString & svg)
+void LibraryContext::makeSmd(QDomElement & element, const QRectF & bounds, const QString & color, const QString & name, bool package, QString & svg)
 {
 	qreal x, y;
 	if (!xy(element, x, y)) {
@@ -1805,20 +2216,61 @@ void LbrApplication::makeSmd(QDomElement & element, const QRectF & bounds, const
 
 	QString connectorID = prepConnector(element, name, package);
 
-	svg += QString("<rect id='%8' connectorname='%9' x='%1' y='%2' width='%3' height='%4' stroke='%5' stroke-width='%6' fill='%7' stroke-linecap='round'/>\n")
-				.arg(x - (dx / 2) - bounds.left())
-				.arg(bounds.bottom() - (y + (dy / 2)))
-				.arg(dx)
-				.arg(dy)
-				.arg("none")
-				.arg(0)
-				.arg(color)
-				.arg(connectorID)
-				.arg(TextUtils::escapeAnd(element.attribute("name")))
-				;
+	SvgWriter(svg).start("rect")
+		.attribute("id", connectorID)
+		.attribute("connectorname", TextUtils::escapeAnd(element.attribute("name")))
+		.attribute("x", x - (dx / 2) - bounds.left())
+		.attribute("y", bounds.bottom() - (y + (dy / 2)))
+		.attribute("width", dx)
+		.attribute("height", dy)
+		.attribute("stroke", "none")
+		.attribute("stroke-width", "0")
+		.attribute("fill", color)
+		.attribute("stroke-linecap", "round")
+		.end();
 }
 
-void LbrApplication::makePin(QDomElement & element, const QRectF & bounds, const QString & color, const QString & textColor, 
+void LibraryContext::writeLongPad(SvgWriter & writer, qreal x, qreal y, qreal horiz, qreal vert, qreal rx, qreal ry, const QString & hole, const QString & color)
+{
+	// a rounded slot: four quarter-circle corners joined by straight sides
+	writer.start("path")
+		.attribute("stroke", "none")
+		.attribute("stroke-width", "0")
+		.startAttribute("d")
+			.raw("m").number(x).raw(",").number(y)
+			.raw("a").number(rx).raw(",").number(ry).raw(" 0 0 1 ").number(rx).raw(",").number(ry)
+			.raw("l0,").number(vert)
+			.raw("a").number(rx).raw(",").number(ry).raw(" 0 0 1 -").number(rx).raw(",").number(ry)
+			.raw("l-").number(horiz).raw(",0")
+			.raw("a").number(rx).raw(",").number(ry).raw(" 0 0 1 -").number(rx).raw(",-").number(ry)
+			.raw("l0,-").number(vert)
+			.raw("a").number(rx).raw(",").number(ry).raw(" 0 0 1 ").number(rx).raw(",-").number(ry)
+			.raw("l").number(horiz).raw(",0z")
+			.raw(hole)
+			.endAttribute()
+		.attribute("fill", color)
+		.end();
+}
+
+void LibraryContext::writePinText(SvgWriter & writer, qreal fontSize, qreal x, qreal y, const char * anchor, const QString & text, const QString & color)
+{
+	// FontFamily comes with its own quotes
+	writer.start("text")
+		.attribute("class", "text")
+		.raw(" font-family=").raw(SchematicRectConstants::FontFamily)
+		.attribute("stroke", "none")
+		.attribute("stroke-width", "0")  // SW(width)
+		.attribute("fill", color)
+		.attribute("font-size", fontSize)
+		.attribute("x", x)
+		.attribute("y", y)
+		.attribute("text-anchor", anchor)
+		.endStart()
+		.raw(text)
+		.close("text");
+}
+
+void LibraryContext::makePin(QDomElement & element, const QRectF & bounds, const QString & color, const QString & textColor, 
                                 const QString & name, bool package, bool isRectangular, QString & svg)
 {
 	qreal x1, y1, x2, y2;
@@ -1846,22 +2298,31 @@ void LbrApplication::makePin(QDomElement & element, const QRectF & bounds, const
         bus = true;
         //qDebug() << "got bus" << element.attribute("name") << useName;
     }
-	svg += QString("<line class='pin' id='%7' connectorname='%8' x1='%1' y1='%2' x2='%3' y2='%4' stroke='%5' stroke-width='%6' stroke-linecap='round'/>\n")
-				.arg(x1 - bounds.left())
-				.arg(bounds.bottom() - y1)
-				.arg(x2 - bounds.left())
-				.arg(bounds.bottom() - y2)
-				.arg(color)
-				.arg(width)
-				.arg(connectorID)
-				.arg(TextUtils::escapeAnd(useName))
-				;
-
-	svg += QString("<rect class='terminal' id='%3' x='%1' y='%2' width='0.0001' height='0.0001' stroke='none' stroke-width='0' fill='none'/>\n")
-				.arg(x1 - bounds.left())
-				.arg(bounds.bottom() - y1)
-				.arg(terminalID)
-				;
+	SvgWriter writer(svg);
+	writer.start("line")
+		.attribute("class", "pin")
+		.attribute("id", connectorID)
+		.attribute("connectorname", TextUtils::escapeAnd(useName))
+		.attribute("x1", x1 - bounds.left())
+		.attribute("y1", bounds.bottom() - y1)
+		.attribute("x2", x2 - bounds.left())
+		.attribute("y2", bounds.bottom() - y2)
+		.attribute("stroke", color)
+		.attribute("stroke-width", width)
+		.attribute("stroke-linecap", "round")
+		.end();
+
+	writer.start("rect")
+		.attribute("class", "terminal")
+		.attribute("id", terminalID)
+		.attribute("x", x1 - bounds.left())
+		.attribute("y", bounds.bottom() - y1)
+		.attribute("width", "0.0001")
+		.attribute("height", "0.0001")
+		.attribute("stroke", "none")
+		.attribute("stroke-width", "0")
+		.attribute("fill", "none")
+		.end();
 
 
     if (useName.isEmpty()) return;
@@ -1869,42 +2330,25 @@ void LbrApplication::makePin(QDomElement & element, const QRectF & bounds, const
         if (element.attribute("bus-master", "").isEmpty()) return;
     }
 
-    static QRegExp indexFinder("connector(\\d*)");
+    QRegExp indexFinder("connector(\\d*)");
     int id = 0;
     if (indexFinder.indexIn(connectorID) >= 0) {
         id = indexFinder.cap(1).toInt() + 1;
     }
 
     if (y1 == y2) {
-        svg += QString("<text class='text' font-family=%8 stroke='none' stroke-width='%6' fill='%7' font-size='%1' x='%2' y='%3' text-anchor='%4'>%5</text>\n")
-					.arg(SchematicRectConstants::PinSmallTextHeight)
-					.arg(((x2 + x1) / 2) - bounds.left())
-					.arg(bounds.bottom() - y2 - width + SchematicRectConstants::PinSmallTextVert)
-					.arg("middle")
-					.arg(id)
-					.arg(0)  // SW(width)
-					.arg(SchematicRectConstants::PinTextColor) 
-                    .arg(SchematicRectConstants::FontFamily)
-                    ; 
+        writePinText(writer, SchematicRectConstants::PinSmallTextHeight, 
+                        ((x2 + x1) / 2) - bounds.left(), bounds.bottom() - y2 - width + SchematicRectConstants::PinSmallTextVert, 
+                        "middle", QString::number(id), SchematicRectConstants::PinTextColor);
     }
     else if (x1 == x2) {
-		svg += QString("<g transform='translate(%1,%2)'><g transform='rotate(%3)'>\n")
-			.arg(x2 - width - bounds.left() + SchematicRectConstants::PinSmallTextVert)
-			.arg(bounds.bottom() - ((y2 + y1) / 2))
-			.arg(270);
-
-	    svg += QString("<text class='text' font-family=%8 stroke='none' stroke-width='%6' fill='%7' font-size='%1' x='%2' y='%3' text-anchor='%4'>%5</text>\n")
-						.arg(SchematicRectConstants::PinSmallTextHeight)
-						.arg(0)
-						.arg(0)
-						.arg("middle")
-						.arg(id)
-						.arg(0)  // SW(width)
-						.arg(textColor) 
-                        .arg(SchematicRectConstants::FontFamily)
-                        ;  
+		writer.raw("<g transform='translate(").number(x2 - width - bounds.left() + SchematicRectConstants::PinSmallTextVert)
+			.raw(",").number(bounds.bottom() - ((y2 + y1) / 2))
+			.raw(")'><g transform='rotate(270)'>\n");
 
-		svg += "</g></g>\n";
+        writePinText(writer, SchematicRectConstants::PinSmallTextHeight, 0, 0, "middle", QString::number(id), textColor);
+
+		writer.raw("</g></g>\n");
     }
 
     if (isRectangular) {
@@ -1928,33 +2372,25 @@ void LbrApplication::makePin(QDomElement & element, const QRectF & bounds, const
         }
 
         if (rotate) {
-		    svg += QString("<g transform='translate(%1,%2)'><g transform='rotate(%3)'>\n")
-			    .arg(x2 - bounds.left() + xOffset)
-			    .arg(bounds.bottom() - y2 + yOffset)
-			    .arg(270);
+		    writer.raw("<g transform='translate(").number(x2 - bounds.left() + xOffset)
+			    .raw(",").number(bounds.bottom() - y2 + yOffset)
+			    .raw(")'><g transform='rotate(270)'>\n");
 		    x2 = bounds.left();
 		    y2 = bounds.bottom();
             xOffset = yOffset = 0;
 	    }
 
-	    svg += QString("<text class='text' font-family=%8 stroke='none' stroke-width='%6' fill='%7' font-size='%1' x='%2' y='%3' text-anchor='%4'>%5</text>\n")
-						    .arg(SchematicRectConstants::PinBigTextHeight)
-						    .arg(x2 - bounds.left() + xOffset)
-						    .arg(bounds.bottom() - y2 + yOffset)
-						    .arg(anchorAtStart ? "start" : "end")
-						    .arg(TextUtils::escapeAnd(useName))
-						    .arg(0)  // SW(width)
-						    .arg(SchematicRectConstants::PinTextColor) 
-                            .arg(SchematicRectConstants::FontFamily)
-                            ;  
+        writePinText(writer, SchematicRectConstants::PinBigTextHeight, 
+                        x2 - bounds.left() + xOffset, bounds.bottom() - y2 + yOffset, 
+                        anchorAtStart ? "start" : "end", TextUtils::escapeAnd(useName), SchematicRectConstants::PinTextColor);
 
         if (rotate) {
-		    svg += "</g></g>\n";
+		    writer.raw("</g></g>\n");
 	    }
     }
 }
 
-void LbrApplication::makePad(QDomElement & element, const QRectF & bounds, const QString & color, const QString & name, bool package, QString & svg)
+void LibraryContext::makePad(QDomElement & element, const QRectF & bounds, const QString & color, const QString & name, bool package, QString & svg)
 {
     qreal x, y;
 	if (!xy(element, x, y)) {
@@ -1977,15 +2413,17 @@ void LbrApplication::makePad(QDomElement & element, const QRectF & bounds, const
 
 	QString connectorID = prepConnector(element, name, package);
 
-	svg += QString("<circle id='%6' connectorname='%7' cx='%1' cy='%2' r='%3' stroke='%4' stroke-width='%5' fill='none' />\n")
-				.arg(x - bounds.left())
-				.arg(bounds.bottom() - y)
-				.arg((diameter / 2) - (sw / 2))
-				.arg(color)
-				.arg(sw)
-				.arg(connectorID)
-				.arg(TextUtils::escapeAnd(element.attribute("name")))
-				;
+	SvgWriter writer(svg);
+	writer.start("circle")
+		.attribute("id", connectorID)
+		.attribute("connectorname", TextUtils::escapeAnd(element.attribute("name")))
+		.attribute("cx", x - bounds.left())
+		.attribute("cy", bounds.bottom() - y)
+		.attribute("r", (diameter / 2) - (sw / 2))
+		.attribute("stroke", color)
+		.attribute("stroke-width", sw)
+		.attribute("fill", "none")
+		.end();
 
 	if (shape.compare("long") == 0) {
 		qreal angle = getRot(element);
@@ -2001,16 +2439,7 @@ void LbrApplication::makePad(QDomElement & element, const QRectF & bounds, const
 		qreal vert = (dy - ry) * 2;
 		qreal horiz = (dx - rx) * 2;
 
-		svg += QString("<path stroke='none' stroke-width='0' d='m%1,%2a%5,%6 0 0 1 %5,%6l0,%4a%5,%6 0 0 1 -%5,%6l-%3,0a%5,%6 0 0 1 -%5,-%6l0,-%4a%5,%6 0 0 1 %5,-%6l%3,0z%7' fill='%8' />\n")
-					.arg(x + dx - rx - bounds.left())
-					.arg(bounds.bottom() - (y + dy))			// note "+ dy" rather than "- dy" because we flip all the y values
-					.arg(horiz)
-					.arg(vert)
-					.arg(rx)
-					.arg(ry)
-					.arg(hole)
-					.arg(color)
-					;
+		writeLongPad(writer, x + dx - rx - bounds.left(), bounds.bottom() - (y + dy), horiz, vert, rx, ry, hole, color);			// note "+ dy" rather than "- dy" because we flip all the y values
 	}
 	else if (shape.compare("offset") == 0) {
 		qreal angle = getRot(element);
@@ -2048,34 +2477,33 @@ void LbrApplication::makePad(QDomElement & element, const QRectF & bounds, const
 		}
 
 
-		svg += QString("<path stroke='none' stroke-width='0' d='m%1,%2a%5,%6 0 0 1 %5,%6l0,%4a%5,%6 0 0 1 -%5,%6l-%3,0a%5,%6 0 0 1 -%5,-%6l0,-%4a%5,%6 0 0 1 %5,-%6l%3,0z%7' fill='%8' />\n")
-					.arg(stx - bounds.left())
-					.arg(bounds.bottom() - sty)			// note "+ dy" rather than "- dy" because we flip all the y values
-					.arg(horiz)
-					.arg(vert)
-					.arg(rx)
-					.arg(ry)
-					.arg(hole)
-					.arg(color)
-					;
+		writeLongPad(writer, stx - bounds.left(), bounds.bottom() - sty, horiz, vert, rx, ry, hole, color);
 	}
 	else if (shape.isEmpty()) {
 	}
 	else if (shape.compare("octagon") == 0) {
 	}
 	else if (shape.compare("square") == 0) {
-        if (!SquareNames.contains(name)) {
-            SquareNames.append(name);
+        {
+            QMutexLocker locker(&m_mutex);
+            if (!m_squareNames.contains(name)) {
+                m_squareNames.append(name);
+            }
         }
 
 		QString hole = genHole(x, y, drill / 2, 0, bounds);
-		svg += QString("<path stroke='none' stroke-width='0' d='m%1,%2 %3,0 0,%3 -%3,0 0,-%3z%4' fill='%5' />\n")
-					.arg(x - (diameter / 2) - bounds.left())
-					.arg(bounds.bottom() - y - (diameter / 2))			
-					.arg(diameter)
-					.arg(hole)
-					.arg(color)
-					;
+		writer.start("path")
+			.attribute("stroke", "none")
+			.attribute("stroke-width", "0")
+			.startAttribute("d")
+				.raw("m").number(x - (diameter / 2) - bounds.left())
+				.raw(",").number(bounds.bottom() - y - (diameter / 2))
+				.raw(" ").number(diameter).raw(",0 0,").number(diameter)
+				.raw(" -").number(diameter).raw(",0 0,-").number(diameter)
+				.raw("z").raw(hole)
+				.endAttribute()
+			.attribute("fill", color)
+			.end();
 	}
 	else {
 		qDebug() << "unknown pad shape" << shape;
@@ -2083,7 +2511,7 @@ void LbrApplication::makePad(QDomElement & element, const QRectF & bounds, const
 }
 
 
-QString LbrApplication::genArcString(qreal x1, qreal y1, qreal x2, qreal y2, qreal curve, const QRectF & bounds) 
+QString LibraryContext::genArcString(qreal x1, qreal y1, qreal x2, qreal y2, qreal curve, const QRectF & bounds, QPointF & pen) 
 {
 	double dsqd = ((x2 - x1) * (x2 - x1)) + ((y2 - y1) * (y2 - y1));
 	double d = qSqrt(dsqd);
@@ -2092,16 +2520,16 @@ QString LbrApplication::genArcString(qreal x1, qreal y1, qreal x2, qreal y2, qre
 	double height = tan(otherAngle) * halfd;
 	double r = qSqrt((height * height) + (halfd * halfd));
 
-	return QString("A%1,%1 0 %2 %3 %4,%5")
-				.arg(r)
-				.arg((qAbs(curve) < 180.0) ? 0 : 1)
-				.arg(curve < 0 ? 1 : 0)
-				.arg(x2 - bounds.left())
-				.arg(bounds.bottom() - y2)
+	QString arc;
+	SvgWriter(arc).raw(SvgWriter::command('A')).number(r).raw(",").number(r)
+				.raw((qAbs(curve) < 180.0) ? " 0 0 " : " 0 1 ")
+				.raw(curve < 0 ? "1 " : "0 ")
+				.point(x2 - bounds.left(), bounds.bottom() - y2, pen)
 				;
+	return arc;
 }
 
-QRectF LbrApplication::getDimensions(const QDomElement & root, const QStringList & layers) 
+QRectF LibraryContext::getDimensions(const QDomElement & root, const QStringList & layers) 
 {
 	qreal left = std::numeric_limits<int>::max();
 	qreal right = std::numeric_limits<int>::min();
@@ -2135,7 +2563,7 @@ QRectF LbrApplication::getDimensions(const QDomElement & root, const QStringList
 	return QRectF(left, top, right - left, bottom - top);
 }
 
-QRectF LbrApplication::getBounds(const QDomElement & element) 
+QRectF LibraryContext::getBounds(const QDomElement & element) 
 {
 	QString tagName = element.tagName();
 
@@ -2464,6 +2892,10 @@ QRectF LbrApplication::getBounds(const QDomElement & element)
 
 bool LbrApplication::initArguments() {
 	m_workingPath = "";
+	m_fsync = false;
+	m_fzpz = m_fzpzArchive = false;
+	m_jobs = 1;
+	m_simplifyTolerance = 0;
     QStringList args = QCoreApplication::arguments();
     for (int i = 0; i < args.length(); i++) {
         if ((args[i].compare("-h", Qt::CaseInsensitive) == 0) ||
@@ -2473,6 +2905,34 @@ bool LbrApplication::initArguments() {
             return false;
         }
 
+		if ((args[i].compare("-compact-svg", Qt::CaseInsensitive) == 0)||
+            (args[i].compare("--compact-svg", Qt::CaseInsensitive) == 0))
+        {
+             SvgWriter::setCompact(true);
+			 continue;
+        }
+
+		if ((args[i].compare("-fsync", Qt::CaseInsensitive) == 0)||
+            (args[i].compare("--fsync", Qt::CaseInsensitive) == 0))
+        {
+             m_fsync = true;
+			 continue;
+        }
+
+		if ((args[i].compare("-fzpz", Qt::CaseInsensitive) == 0)||
+            (args[i].compare("--fzpz", Qt::CaseInsensitive) == 0))
+        {
+             m_fzpz = true;
+			 continue;
+        }
+
+		if ((args[i].compare("-fzbz", Qt::CaseInsensitive) == 0)||
+            (args[i].compare("--fzbz", Qt::CaseInsensitive) == 0))
+        {
+             m_fzpz = m_fzpzArchive = true;
+			 continue;
+        }
+
 		if (i + 1 < args.length()) {
 			if ((args[i].compare("-w", Qt::CaseInsensitive) == 0) ||
 				(args[i].compare("-working", Qt::CaseInsensitive) == 0)||
@@ -2492,6 +2952,39 @@ bool LbrApplication::initArguments() {
 			{
 				m_core = args[++i];
 			}
+			else if ((args[i].compare("-precision", Qt::CaseInsensitive) == 0)||
+				(args[i].compare("--precision", Qt::CaseInsensitive) == 0))
+			{
+				bool ok;
+				int precision = args[++i].toInt(&ok);
+				if (!ok || !SvgWriter::validPrecision(precision)) {
+					message(QString("--precision expects a number of decimal places from 0 to %1, not '%2'").arg(SvgWriter::MaxPrecision).arg(args[i]));
+					return false;
+				}
+				SvgWriter::setPrecision(precision);
+			}
+			else if ((args[i].compare("-j", Qt::CaseInsensitive) == 0) ||
+				(args[i].compare("-jobs", Qt::CaseInsensitive) == 0)||
+				(args[i].compare("--jobs", Qt::CaseInsensitive) == 0))
+			{
+				bool ok;
+				m_jobs = args[++i].toInt(&ok);
+				if (!ok || m_jobs < 1) {
+					message(QString("-j expects a positive number of jobs, not '%1'").arg(args[i]));
+					return false;
+				}
+			}
+			else if ((args[i].compare("-simplify-tolerance", Qt::CaseInsensitive) == 0)||
+				(args[i].compare("--simplify-tolerance", Qt::CaseInsensitive) == 0))
+			{
+				bool ok;
+				qreal mils = args[++i].toDouble(&ok);
+				if (!ok || mils < 0) {
+					message(QString("--simplify-tolerance expects a distance in mils, not '%1'").arg(args[i]));
+					return false;
+				}
+				m_simplifyTolerance = mils * 25.4 / 1000;
+			}
 		}
     }
 
@@ -2511,7 +3004,7 @@ bool LbrApplication::initArguments() {
 
 
 void LbrApplication::usage() {
-    message("usage: lbr2svg -w <path to folder containing lbr files> -p <path to Fritzing parts folder> -c <core | user | contrib>");
+    message("usage: lbr2svg -w <path to folder containing lbr files> -p <path to Fritzing parts folder> -c <core | user | contrib> [-j <number of libraries to convert in parallel>] [--precision <decimal places, 0 to 9>] [--compact-svg] [--fsync] [--fzpz] [--fzbz] [--simplify-tolerance <mils>]");
 }
 
 void LbrApplication::message(const QString & msg) {
@@ -2522,7 +3015,7 @@ void LbrApplication::message(const QString & msg) {
 	qDebug() << msg;
  }
 
-void LbrApplication::genText(const QDomElement & element, const QRectF & bounds, const QString & color, QString & svg) 
+void LibraryContext::genText(const QDomElement & element, const QRectF & bounds, const QString & color, QString & svg) 
 {
 	qreal x, y;
 	if (!xy(element, x, y)) {
@@ -2551,16 +3044,16 @@ void LbrApplication::genText(const QDomElement & element, const QRectF & bounds,
 
 	if (angle != 0) {
 		svg += QString("<g transform='translate(%1,%2)'><g transform='rotate(%3)'>\n")
-			.arg(x - bounds.left())
-			.arg(bounds.bottom() - y)
-			.arg(angle);
+			.arg(SvgWriter::formatNumber(x - bounds.left()))
+			.arg(SvgWriter::formatNumber(bounds.bottom() - y))
+			.arg(SvgWriter::formatNumber(angle));
 		x = bounds.left();
 		y = bounds.bottom();
 	}
 	svg += QString("<text class='text' font-family='OCRA' stroke='none' stroke-width='%6' fill='%7' font-size='%1' x='%2' y='%3' text-anchor='%4'>%5</text>\n")
-						.arg(size)
-						.arg(x - bounds.left())
-						.arg(bounds.bottom() - y)
+						.arg(SvgWriter::formatNumber(size))
+						.arg(SvgWriter::formatNumber(x - bounds.left()))
+						.arg(SvgWriter::formatNumber(bounds.bottom() - y))
 						.arg(anchorAtStart ? "start" : "end")
 						.arg(TextUtils::escapeAnd(text))
 						.arg(0)  // SW(width)
@@ -2571,73 +3064,54 @@ void LbrApplication::genText(const QDomElement & element, const QRectF & bounds,
 	}
 }
 
-QString LbrApplication::genHole(qreal cx, qreal cy, qreal r, int sweepFlag, const QRectF & bounds)
+QString LibraryContext::genHole(qreal cx, qreal cy, qreal r, int sweepFlag, const QRectF & bounds)
 {
-	return QString("M%1,%2a%3,%3 0 1 %5 %4,0 %3,%3 0 1 %5 -%4,0z\n")
-				.arg(cx - bounds.left() - r)
-				.arg(bounds.bottom() - cy)
-				.arg(r)
-				.arg(2 * r)
-				.arg(sweepFlag);
+	QString hole;
+	SvgWriter writer(hole);
+	writer.raw("M").number(cx - bounds.left() - r).raw(",").number(bounds.bottom() - cy);
+	writer.raw("a").number(r).raw(",").number(r).raw(QString(" 0 1 %1 ").arg(sweepFlag)).number(2 * r).raw(",0 ");
+	writer.number(r).raw(",").number(r).raw(QString(" 0 1 %1 -").arg(sweepFlag)).number(2 * r).raw(",0z\n");
+	return hole;
 }
 
-QString LbrApplication::prepConnector(QDomElement & element, const QString & name, bool package) 
+QString LibraryContext::prepConnector(QDomElement & element, const QString & name, bool package) 
 {
 	QString prop = (name + PropSeparator + element.attribute("name"));
     QString connectorID;
 
+    QMutexLocker locker(&m_mutex);
 	if (package) {
-        connectorID = PackageConnectors.value(prop, "");
+        connectorID = m_packageConnectors.value(prop, "");
         if (connectorID.isEmpty()) {
             // means no fzp used this connector, but fill it in anyway
-            int index = PackageConnectorIndexes.value(name);
+            int index = m_packageConnectorIndexes.value(name);
             connectorID = QString("connector%1pad").arg(index++);
-            PackageConnectors.insert(prop, connectorID);
-            PackageConnectorTypes.insert(prop, element.tagName());
-            PackageConnectorIndexes.insert(name, index);
+            m_packageConnectors.insert(prop, connectorID);
+            m_packageConnectorTypes.insert(prop, element.tagName());
+            m_packageConnectorIndexes.insert(name, index);
         }
 	}
 	else {
-		connectorID = SymbolConnectors.value(prop, "");
+		connectorID = m_symbolConnectors.value(prop, "");
         if (connectorID.isEmpty()) {
             // means no fzp used this connector; probably this symbol is used in combination with another
-            int index = SymbolConnectorIndexes.value(name, 0);
+            int index = m_symbolConnectorIndexes.value(name, 0);
             connectorID = QString("connector%1pin").arg(index++);
-            SymbolConnectors.insert(prop, connectorID);
-            SymbolConnectorIndexes.insert(name, index);
+            m_symbolConnectors.insert(prop, connectorID);
+            m_symbolConnectorIndexes.insert(name, index);
         }
 	}
 
 	return connectorID;
 }
 
-QString LbrApplication::findExistingBreadboardFile(const QString & packageName) {
-	if (m_fritzingPartsPath.isEmpty()) return "";
-
-	if (m_bbFiles.isEmpty()) {
-		QDir dir(m_fritzingPartsPath);
-		dir.cd("svg");
-		dir.cd("core");
-		dir.cd("breadboard");
-		QStringList nameFilters;
-		nameFilters << "*_breadboard.svg";
-		m_bbFiles = dir.entryList(nameFilters, QDir::Files | QDir::NoDotAndDotDot);
-		
-		for (int i = 0; i < m_bbFiles.count(); i++) {
-			m_bbFiles[i] = m_bbFiles.at(i).toLower();
-		}
-	}
-
-	QString lp = packageName.toLower();
-	foreach (QString fn, m_bbFiles) {
-		if (fn.contains(lp)) {
-			qDebug() << "matched existing package" << fn;
-			return fn;
-		}
+QString LibraryContext::findExistingBreadboardFile(const QString & packageName) {
+	QString fn = m_run.breadboardFiles.find(packageName.toLower());
+	if (!fn.isEmpty()) {
+		qDebug() << "matched existing package" << fn;
 	}
 
-	// TODO: remove non-alphanumeric and match
-	return "";
+	return fn;
 }
 
 bool LbrApplication::loadPartsDescrs(const QDir & workingFolder, const QString & filename) {
@@ -2768,7 +3242,7 @@ bool LbrApplication::loadPartsDescrs(const QDir & workingFolder, const QString &
 }
 
 
-void LbrApplication::prepPackage(const QDomElement & package)
+void LibraryContext::prepPackage(const QDomElement & package)
 {
 	QString packageName = package.attribute("name");
 	//qDebug() << "processing package" << packageName;
@@ -2794,7 +3268,7 @@ void LbrApplication::prepPackage(const QDomElement & package)
     else if (pads.count() > 0) {
     }
     else if (smds.count() > 0) {
-        AllSMDs.append(packageName);
+        m_allSMDs.append(packageName);
     }
     else {
 		qDebug() << "package" << package.attribute("name") << "missing both smd and tht";
@@ -2817,17 +3291,18 @@ void LbrApplication::prepPackage(const QDomElement & package)
 
 	QString breadboardFile = findExistingBreadboardFile(packageName);
 	if (!breadboardFile.isEmpty()) {
-		OldBreadboardFiles.insert(packageName, breadboardFile);
+		m_oldBreadboardFiles.insert(packageName, breadboardFile);
 		return;
 	}
 
+	QRegExp dipper(Dipper);
 	if (!gotSMD && packageName.toLower().indexOf(dipper) == 0) {
 		int tenths = (int) (dimensions.height() / 2.54);
         if (packageName.toLower().contains("dil")) {
             if (tenths > 1) tenths--;
         }
 		QString name = QString("generic_ic_dip_%1_%2mil_bread.svg").arg(all.count()).arg(tenths * 100);
-		OldBreadboardFiles.insert(packageName, name);
+		m_oldBreadboardFiles.insert(packageName, name);
 		return;
 	}
 
@@ -2853,13 +3328,7 @@ void LbrApplication::makeBin(const QStringList & moduleIDs, const QString & libr
 	bin += "</instances>\n";
 	bin += "</module>\n";
 
-	QFile file(binsFolder.absoluteFilePath(libraryName.toLower() + ".fzb"));
-	if (file.open(QIODevice::WriteOnly | QIODevice::Text)) {
-		QTextStream out(&file);
-		out.setCodec("UTF-8");
-		out << bin;
-		file.close();
-	}
+	OutputWriter::write(binsFolder.absoluteFilePath(libraryName.toLower() + ".fzb"), bin.toUtf8());
 }
 
 bool LbrApplication::registerFonts() {
@@ -7,6 +7,14 @@
 #include <QRectF>
 #include <QDir>
 #include <QHash>
+#include <QMutex>
+#include <QSet>
+#include <QTextStream>
+#include <QVector>
+#include <QPointF>
+
+#include "nameindex.h"
+#include "taskgraph.h"
 
 
 struct FileDescr {
@@ -42,16 +50,97 @@ public:
 
     void start();
 
+	static void makeBin(const QStringList & moduleIDs, const QString & libraryName, const QDir & binsFolder);
+
 protected:
 	bool initArguments();
 	void usage();
 	void message(const QString & msg);
-	void makeSchematics(const QDir & svgFolder, const QString & libraryName, const QDomElement & root);
-	void makePCBs(const QDir & workingFolder, const QDir & pcbFolder, const QDir & breadboardFolder,  const QDir & subpartsFolder, const QString & libraryName, const QDomElement & root);
-	QStringList makeFZPs(const QDir & workingFolder, const QDir & fzpFolder, const QDir & breadFolder, const QDir & schematicFolder, const QDir & pcbFolder, const QDir & iconFolder, const QDir & binsFolder, const QDir & subpartsFolder, const QString & libraryName, QDomDocument & doc, QTextStream & lbrStream);
+    bool loadPartsDescrs(const QDir & folder, const QString & filename);
+    bool registerFonts();
+
+protected:
+    QString m_workingPath;
+    QString m_fritzingPartsPath;
+	QString m_core;
+    QHash<QString, PartDescr *> m_partDescrs;
+    QString m_newLbrs;					// newlbrs.csv, written at the end
+	bool m_fsync;
+	bool m_fzpz;
+	bool m_fzpzArchive;
+	int m_jobs;
+	qreal m_simplifyTolerance;			// mm; 0 leaves wires and polygons as they are
+};
+
+// read-only state shared by every library converted in one run
+struct LibraryRun {
+	QString lbrPath;
+	QString workingPath;
+	QString fzpPath;
+	QString breadboardPath;
+	QString schematicPath;
+	QString pcbPath;
+	QString iconPath;
+	QString binsPath;
+	QString subpartsPath;
+	QHash<QString, PartDescr *> partDescrs;	// read only; matches come back in LibraryResult::matchedParts
+	NameIndex breadboardFiles;					// lower case names of the parts folder's core breadboard svgs
+	qreal simplifyTolerance;
+	QThreadPool * taskPool;					// for the devices, symbols and packages in a library; NULL runs them one at a time
+};
+
+struct LibraryResult {
+	bool converted;
+	QStringList moduleIDs;
+	QString lbrRows;					// for lbr.csv
+	QString newLbrRows;					// for newlbrs.csv
+	QStringList matchedParts;			// fzp names of the part descriptors a device used
+};
+
+// one device, symbol or package in a library's task graph
+struct LibraryTask {
+	enum Kind {
+		Device,
+		Symbol,
+		Package
+	};
+
+	Kind kind;
+	QDomElement element;
+
+	// devices only
+	QString symbol;
+	QString description;
+	QString deviceSetName;
+	QString deviceSetPrefix;
+	bool useGate;
+	QHash<QString, QString> pair;		// moduleID -> family
+	QString lbrRow;
+	QString newLbrRow;
+};
+
+// everything that changes while converting a single library, so libraries can be converted in parallel
+class LibraryContext : public TaskGraph::Runner
+{
+public:
+	LibraryContext(const LibraryRun &);
+	~LibraryContext();
+
+	bool convert(const QString & filename, LibraryResult &);
+	void runTask(int id);
+
+protected:
+	void makeSchematics(const QDomElement & root);
+	void makePCBs(const QDomElement & root);
+	void makeFZPs(QDomDocument & doc);
+	QStringList collectFZPs(const QDir & binsFolder, QTextStream & lbrStream);
+	int addTask(LibraryTask *);
+	void addDeviceTask(const QDomElement & device, const QString & symbol, const QString & description, const QDomElement & deviceSet, bool useGate);
+	void addSymbolTask(const QDomElement & symbol);
+	void addPackageTask(const QDomElement & package);
 	void processSymbol(const QDir & schematicFolder, QDomElement & symbol, const QString & libraryName);
 	void processPackage(const QDir & workingFolder, const QDir & subpartsFolder, const QDir & pcbFolder, const QDir & breadboardFolder, const QDomElement & package, const QString & libraryName);
-	QHash<QString, QString> processDevice(const QDir & workingFolder, const QDir & fzpFolder,  const QDir & iconFolder, const QDir & subpartsFolder, const QDomElement & device, const QString & symbol, QString description, const QString & libraryName, const QString & deviceSetName, const QString & deviceSetPrefix, bool useGate, QTextStream & lbrStream);
+	QHash<QString, QString> processDevice(const QDir & workingFolder, const QDir & fzpFolder,  const QDir & iconFolder, const QDir & subpartsFolder, const QDomElement & device, const QString & symbol, QString description, const QString & libraryName, const QString & deviceSetName, const QString & deviceSetPrefix, bool useGate, QString & lbrRow, QString & newLbrRow);
 	QRectF getDimensions(const QDomElement & root, const QStringList & layers);
 	QRectF getBounds(const QDomElement & element);
 	void toSvg(const QDomElement & root, const QStringList & layers, const QRectF & bounds, const QHash<QString, QString> & colors, int & nonconnectorIndex, bool package, QString & svg);
@@ -59,26 +148,43 @@ protected:
 	void genText(const QDomElement & element, const QRectF & bounds, const QString & color, QString & svg);
 	QString genHole(qreal cx, qreal cy, qreal r, int sweepFlag, const QRectF & bounds);
 	QString prepConnector(QDomElement & element, const QString & name, bool package);
-	QString genArcString(qreal x1, qreal y1, qreal x2, qreal y2, qreal curve, const QRectF & bounds);
+	QString genArcString(qreal x1, qreal y1, qreal x2, qreal y2, qreal curve, const QRectF & bounds, QPointF & pen);
 	QString findExistingBreadboardFile(const QString & packageName);
     void makePad(QDomElement & element, const QRectF & bounds, const QString & color, const QString & name, bool package, QString & svg);
     void makePin(QDomElement & element, const QRectF & bounds, const QString & color, const QString & textColor, const QString & name, bool package, bool isRectangular, QString & svg);
     void makeSmd(QDomElement & element, const QRectF & bounds, const QString & color, const QString & name, bool package, QString & svg);
     void makeWire(QDomElement & element, const QRectF & bounds, const QString & color, QString & svg);
     void makePolygon(QDomElement & element, const QRectF & bounds, const QString & color, QString & svg);
-    bool loadPartsDescrs(const QDir & folder, const QString & filename);
+	void makeWireRun(QVector<QPointF> & points, qreal width, const QRectF & bounds, const QString & color, QString & svg);
+	void tallySegmentsRemoved(const QString & view);
+	void writeLongPad(class SvgWriter &, qreal x, qreal y, qreal horiz, qreal vert, qreal rx, qreal ry, const QString & hole, const QString & color);
+	void writePinText(class SvgWriter &, qreal fontSize, qreal x, qreal y, const char * anchor, const QString & text, const QString & color);
     void prepPCBs(const QDomElement & root);
     void prepPackage(const QDomElement & package);
     bool checkRectangular(const QDomElement & root, const QRectF & bounds, const QHash<QString, QString> & colors, QString & svg);
-    void makeBin(const QStringList & moduleIDs, const QString & libraryName, const QDir & binsFolder);
-    bool registerFonts();
 
 protected:
-    QString m_workingPath;
-    QString m_fritzingPartsPath;
-	QString m_core;
-	QStringList m_bbFiles;
-    QHash<QString, PartDescr *> m_partDescrs;
+	const LibraryRun & m_run;
+	QString m_libraryName;
+	TaskGraph m_graph;
+	QList<LibraryTask *> m_tasks;						// indexed by task id
+	QHash<QString, int> m_packageDevices;				// package -> last device task using it
+	QHash<QString, int> m_symbolDevices;				// symbol -> last device task using it
+	QMutex m_mutex;										// for the tables below, once the tasks are running
+	QHash<QString, QString> m_packageConnectors;		// package___pad
+	QHash<QString, QString> m_packageConnectorTypes;
+	QHash<QString, QString> m_symbolConnectors;			// symbol___gate pin
+	QHash<QString, int> m_packageConnectorIndexes;
+	QHash<QString, int> m_symbolConnectorIndexes;
+	QList<QString> m_allSMDs;
+	QHash<QString, QString> m_oldBreadboardFiles;
+	QHash<QString, QString> m_breakouts;				// package -> subpart
+	QSet<QString> m_schematicIcons;					// symbol svgs wrapped in an icon layer; filled in before the tasks run
+	QStringList m_squareNames;						// for debugging
+	int m_mixIndex;
+	QString m_newLbrs;
+	QHash<QString, int> m_segmentsRemovedByView;
+	QStringList m_matchedParts;
 };
 
 #endif
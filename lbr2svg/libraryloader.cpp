@@ -0,0 +1,66 @@
+#include "libraryloader.h"
+
+#include <QFile>
+#include <QXmlStreamReader>
+
+static bool isPlaceholder(const QDomElement & text)
+{
+	QString value = text.text();
+	return value.compare(">name", Qt::CaseInsensitive) == 0 || value.compare(">value", Qt::CaseInsensitive) == 0;
+}
+
+bool LibraryLoader::load(const QString & path, QDomDocument & doc, QString & errorStr, int & errorLine, int & errorColumn)
+{
+	doc = QDomDocument();
+
+	QFile file(path);
+	if (!file.open(QIODevice::ReadOnly)) {
+		errorStr = file.errorString();
+		errorLine = errorColumn = 0;
+		return false;
+	}
+
+	// builds the same tree QDomDocument::setContent would (whitespace-only text and comments dropped)
+	QXmlStreamReader xml(&file);
+	QDomNode current = doc;
+	while (!xml.atEnd()) {
+		switch (xml.readNext()) {
+			case QXmlStreamReader::StartElement:
+			{
+				QDomElement element = doc.createElement(xml.name().toString());
+				foreach (QXmlStreamAttribute attribute, xml.attributes()) {
+					element.setAttribute(attribute.name().toString(), attribute.value().toString());
+				}
+				current.appendChild(element);
+				current = element;
+				break;
+			}
+			case QXmlStreamReader::EndElement:
+			{
+				// a <text> is still the last child of its parent here, so dropping it is cheap
+				QDomNode parent = current.parentNode();
+				if (xml.name().toString().compare("text") == 0 && isPlaceholder(current.toElement())) {
+					parent.removeChild(current);
+				}
+				current = parent;
+				break;
+			}
+			case QXmlStreamReader::Characters:
+				if (!xml.isWhitespace()) {
+					current.appendChild(doc.createTextNode(xml.text().toString()));
+				}
+				break;
+			default:
+				break;
+		}
+	}
+
+	if (xml.hasError()) {
+		errorStr = xml.errorString();
+		errorLine = xml.lineNumber();
+		errorColumn = xml.columnNumber();
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,15 @@
+#ifndef LIBRARYLOADER_H
+#define LIBRARYLOADER_H
+
+#include <QDomDocument>
+
+// Streams an eagle .lbr file into a QDomDocument, leaving out the >NAME and >VALUE placeholder
+// texts, which never make it into a part.  Big libraries carry thousands of them.
+
+class LibraryLoader
+{
+public:
+	static bool load(const QString & path, QDomDocument & doc, QString & errorStr, int & errorLine, int & errorColumn);
+};
+
+#endif // LIBRARYLOADER_H
@@ -8,24 +8,34 @@
 #include <QDomElement>
 #include <QList>
 #include <QRectF>
+#include <QVector>
 
 typedef QString (*GetConnectorNameFn)(const QDomElement &);
 
 class MiscUtils {
 
 public:
+	enum Units {
+		Mils,					// brd2xml
+		Millimeters				// .lbr files
+	};
+
 	static bool makePartsDirectories(const QDir & workingFolder, const QString & core, QDir & fzpFolder, QDir & breadboardFolder, QDir & schematicFolder, QDir & pcbFolder, QDir & iconFolder);
 	static void calcTextAngle(qreal & angle, int mirror, int spin, qreal size, qreal & x, qreal & y, bool & anchorAtStart);
 	static QString makeGeneric(const QDir & workingFolder, const QString & boardColor, QList<QDomElement> & powers, 
             const QString & copper, const QString & boardName, QSizeF outerChipSize, QSizeF innerChipSize,
             GetConnectorNameFn getConnectorName, GetConnectorNameFn getConnectorIndex, bool noText);
-    static bool makeWireTrees(QList<QDomElement> & wireList, QList<struct WireTree *> & wireTrees);
+    static bool makeWireTrees(QList<QDomElement> & wireList, QList<struct WireTree *> & wireTrees, Units = Mils);
     static bool rwaa(QDomElement & element, qreal & radius, qreal & width, qreal & angle1, qreal & angle2);
     static bool x1y1x2y2(const QDomElement & element, qreal & x1, qreal & y1, qreal & x2, qreal & y2);
     static qreal strToMil(const QString & str, bool & ok);
+	static QDomElement mergeTarget(QDomDocument & doc, const QString & id);
+	static void spliceSvg(QDomElement & target, const QDomDocument & fragment, const QString & id);
+	static QString compactSvg(const QString & svg);			// drops inherited styles and moves repeated ones into classes
+	static QVector<int> simplifyPolyline(const QVector<QPointF> & points, qreal tolerance);	// indexes of the points to keep
 
 protected:
-	static void includeSvg2(QDomDocument & doc, const QString & path, const QString & name, qreal x, qreal y);
+	static QDomDocument includeSvg2(const QString & path, const QString & name, qreal x, qreal y);
 
 };
 
@@ -0,0 +1,78 @@
+#include "nameindex.h"
+
+void NameIndex::add(const QString & name)
+{
+	int index = m_names.count();
+	m_names.append(name);
+	m_normalized.append(normalize(name));
+	addTrigrams(name, index, m_trigrams);
+	addTrigrams(m_normalized.last(), index, m_normalizedTrigrams);
+}
+
+int NameIndex::count() const
+{
+	return m_names.count();
+}
+
+QString NameIndex::find(const QString & text) const
+{
+	int index = find(m_names, m_trigrams, text, false);
+	if (index < 0) {
+		QString normalized = normalize(text);
+		if (!normalized.isEmpty()) {
+			index = find(m_normalized, m_normalizedTrigrams, normalized, true);
+		}
+	}
+
+	if (index < 0) return "";
+
+	return m_names.at(index);
+}
+
+QString NameIndex::normalize(const QString & from)
+{
+	QString to;
+	foreach (QChar c, from) {
+		if (c.isLetterOrNumber()) to.append(c.toLower());
+	}
+	return to;
+}
+
+void NameIndex::addTrigrams(const QString & name, int index, QHash<QString, QVector<int> > & trigrams)
+{
+	for (int i = 0; i + 3 <= name.length(); i++) {
+		QVector<int> & indexes = trigrams[name.mid(i, 3)];
+		// a trigram can turn up more than once in a name
+		if (indexes.isEmpty() || indexes.last() != index) indexes.append(index);
+	}
+}
+
+int NameIndex::find(const QStringList & names, const QHash<QString, QVector<int> > & trigrams, const QString & text, bool shortest)
+{
+	// every name containing text contains all of its trigrams, so the rarest one is enough to narrow things down
+	QVector<int> all;
+	const QVector<int> * candidates = NULL;
+	if (text.length() < 3) {
+		for (int i = 0; i < names.count(); i++) all.append(i);
+		candidates = &all;
+	}
+	else {
+		for (int i = 0; i + 3 <= text.length(); i++) {
+			QHash<QString, QVector<int> >::const_iterator it = trigrams.constFind(text.mid(i, 3));
+			if (it == trigrams.constEnd()) return -1;
+
+			if (candidates == NULL || it.value().count() < candidates->count()) candidates = &it.value();
+		}
+	}
+
+	int best = -1;
+	foreach (int index, *candidates) {
+		const QString & name = names.at(index);
+		if (!name.contains(text)) continue;
+		if (!shortest) return index;
+
+		if (best < 0 || name.length() < names.at(best).length()) best = index;
+	}
+
+	return best;
+}
@@ -0,0 +1,37 @@
+#ifndef NAMEINDEX_H
+#define NAMEINDEX_H
+
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+// Substring lookup over a fixed list of names, for matching package names against the file
+// names in the parts folder.  Every name is indexed by its three-character substrings, both as
+// given and with everything but letters and digits removed, so a lookup only checks the names
+// sharing the rarest trigram of what it is looking for.
+
+class NameIndex
+{
+public:
+	void add(const QString & name);				// names keep the order they were added in
+	int count() const;
+
+	// the first name containing text; failing that, of the names containing text once both are
+	// normalized, the shortest, then the first
+	QString find(const QString & text) const;
+
+	static QString normalize(const QString &);	// lower case letters and digits only
+
+protected:
+	static void addTrigrams(const QString & name, int index, QHash<QString, QVector<int> > & trigrams);
+	static int find(const QStringList & names, const QHash<QString, QVector<int> > & trigrams, const QString & text, bool shortest);
+
+protected:
+	QStringList m_names;
+	QStringList m_normalized;
+	QHash<QString, QVector<int> > m_trigrams;		// trigram -> indexes of the names containing it, ascending
+	QHash<QString, QVector<int> > m_normalizedTrigrams;
+};
+
+#endif // NAMEINDEX_H
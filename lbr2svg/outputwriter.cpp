@@ -0,0 +1,211 @@
+#include "outputwriter.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QList>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSet>
+#include <QStringList>
+#include <QThread>
+#include <QWaitCondition>
+#include <QtDebug>
+
+#ifdef Q_OS_WIN
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+struct PendingWrite {
+	QString path;
+	QByteArray content;
+	bool text;
+};
+
+static QMutex Mutex;
+static QWaitCondition QueueChanged;
+static QList<PendingWrite> Queue;
+static qint64 QueuedBytes = 0;				// queued plus the batch being written
+static qint64 MaxQueuedBytes = OutputWriter::DefaultMaxQueuedBytes;
+static bool Busy = false;
+static bool Stopping = false;
+static OutputWriter::Durability SyncPolicy = OutputWriter::NoSync;
+static QSet<QString> Written;				// only kept for SyncAtEnd
+static QStringList Failed;
+static QThread * Thread = NULL;
+
+static int Files = 0;
+static qint64 Bytes = 0;
+static int Batches = 0;
+static int PeakDepth = 0;
+static qint64 PeakBytes = 0;
+static int Stalls = 0;
+
+static bool writeFile(const PendingWrite & pending)
+{
+	QIODevice::OpenMode mode = QIODevice::WriteOnly;
+	if (pending.text) mode |= QIODevice::Text;
+
+	QFile file(pending.path);
+	if (!file.open(mode)) {
+		QDir().mkpath(QFileInfo(pending.path).absolutePath());
+		if (!file.open(mode)) {
+			qDebug() << "unable to write" << pending.path;
+			return false;
+		}
+	}
+
+	file.write(pending.content);
+	file.close();
+	return true;
+}
+
+static void syncFile(const QString & path)
+{
+	QFile file(path);
+	if (!file.open(QIODevice::Append)) return;
+
+#ifdef Q_OS_WIN
+	_commit(file.handle());
+#else
+	fsync(file.handle());
+#endif
+	file.close();
+}
+
+class WriterThread : public QThread
+{
+protected:
+	void run() {
+		forever {
+			QList<PendingWrite> batch;
+			{
+				QMutexLocker locker(&Mutex);
+				while (Queue.isEmpty() && !Stopping) {
+					QueueChanged.wait(&Mutex);
+				}
+				if (Queue.isEmpty()) return;
+
+				// take everything queued so far and write it without holding the lock
+				batch = Queue;
+				Queue.clear();
+				Busy = true;
+			}
+
+			qint64 bytes = 0;
+			int files = 0;
+			QStringList failed;
+			foreach (const PendingWrite & pending, batch) {
+				if (writeFile(pending)) files++;
+				else failed.append(pending.path);
+				bytes += pending.content.size();
+			}
+
+			QMutexLocker locker(&Mutex);
+			QueuedBytes -= bytes;
+			Failed.append(failed);
+			Files += files;
+			Bytes += bytes;
+			Batches++;
+			if (SyncPolicy == OutputWriter::SyncAtEnd) {
+				foreach (const PendingWrite & pending, batch) {
+					Written.insert(pending.path);
+				}
+			}
+			Busy = false;
+			QueueChanged.wakeAll();
+		}
+	}
+};
+
+void OutputWriter::start(Durability durability, qint64 maxQueuedBytes)
+{
+	if (Thread != NULL) return;
+
+	SyncPolicy = durability;
+	MaxQueuedBytes = maxQueuedBytes;
+	Stopping = false;
+	Thread = new WriterThread();
+	Thread->start();
+}
+
+void OutputWriter::write(const QString & path, const QByteArray & content, bool text)
+{
+	QMutexLocker locker(&Mutex);
+	PendingWrite pending;
+	pending.path = path;
+	pending.content = content;
+	pending.text = text;
+
+	if (Thread == NULL) {
+		if (writeFile(pending)) {
+			Files++;
+			Bytes += content.size();
+			if (SyncPolicy == SyncAtEnd) Written.insert(path);
+		}
+		else {
+			Failed.append(path);
+		}
+		return;
+	}
+
+	// a file bigger than the whole queue still goes through once the queue is empty
+	if (QueuedBytes > 0 && QueuedBytes + content.size() > MaxQueuedBytes) {
+		Stalls++;
+		while (QueuedBytes > 0 && QueuedBytes + content.size() > MaxQueuedBytes) {
+			QueueChanged.wait(&Mutex);
+		}
+	}
+
+	Queue.append(pending);
+	QueuedBytes += content.size();
+	PeakDepth = qMax(PeakDepth, Queue.count());
+	PeakBytes = qMax(PeakBytes, QueuedBytes);
+	QueueChanged.wakeAll();
+}
+
+void OutputWriter::flush()
+{
+	QMutexLocker locker(&Mutex);
+	while (!Queue.isEmpty() || Busy) {
+		QueueChanged.wait(&Mutex);
+	}
+}
+
+void OutputWriter::finish()
+{
+	flush();
+
+	if (Thread != NULL) {
+		{
+			QMutexLocker locker(&Mutex);
+			Stopping = true;
+			QueueChanged.wakeAll();
+		}
+		Thread->wait();
+		delete Thread;
+		Thread = NULL;
+	}
+
+	if (SyncPolicy == SyncAtEnd) {
+		foreach (QString path, Written) {
+			syncFile(path);
+		}
+		Written.clear();
+	}
+}
+
+QStringList OutputWriter::failures()
+{
+	QMutexLocker locker(&Mutex);
+	return Failed;
+}
+
+QString OutputWriter::stats()
+{
+	QMutexLocker locker(&Mutex);
+	return QString("output writer: %1 files, %2 bytes in %3 batches; queue peaked at %4 files, %5 bytes; waited for the disk %6 times; %7 files failed")
+		.arg(Files).arg(Bytes).arg(Batches).arg(PeakDepth).arg(PeakBytes).arg(Stalls).arg(Failed.count());
+}
@@ -0,0 +1,40 @@
+#ifndef OUTPUTWRITER_H
+#define OUTPUTWRITER_H
+
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+
+// Generated files are queued and written on a background thread, so conversion goes on while
+// the disk catches up.  Writes happen in the order they were queued; folders are only made when
+// a file is written into them.  Until start() is called, write() writes straight away.
+
+class OutputWriter
+{
+public:
+	enum Durability {
+		NoSync,					// leave flushing to the os
+		SyncAtEnd				// fsync every file written, once in finish()
+	};
+
+	static const qint64 DefaultMaxQueuedBytes = 64 * 1024 * 1024;
+
+	static void start(Durability = NoSync, qint64 maxQueuedBytes = DefaultMaxQueuedBytes);
+
+	// blocks while the queue already holds maxQueuedBytes
+	static void write(const QString & path, const QByteArray & content, bool text = true);
+
+	// returns once everything queued so far is on disk; call before reading back a file written through the queue
+	static void flush();
+
+	// flush, sync if asked to and stop the thread
+	static void finish();
+
+	// paths that couldn't be written, in the order they failed; complete for everything queued
+	// before the last flush() or finish()
+	static QStringList failures();
+
+	static QString stats();
+};
+
+#endif // OUTPUTWRITER_H
@@ -0,0 +1,253 @@
+#include "svgwriter.h"
+
+#include "utils/textutils.h"
+
+#include <QElapsedTimer>
+#include <QVector>
+#include <qmath.h>
+
+// set once from the command line, before any conversion threads start
+static int Precision = -1;
+static bool Compact = false;
+
+static const qreal PowersOfTen[SvgWriter::MaxPrecision + 1] = { 1, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9 };
+
+SvgWriter::SvgWriter(QString & svg, qreal scale) : m_svg(svg), m_scale(scale)
+{
+}
+
+SvgWriter & SvgWriter::start(const char * tagName)
+{
+	m_svg += QLatin1Char('<');
+	m_svg += QLatin1String(tagName);
+	return *this;
+}
+
+SvgWriter & SvgWriter::attribute(const char * name, const QString & value)
+{
+	startAttribute(name);
+	m_svg += value;
+	m_svg += QLatin1Char('\'');
+	return *this;
+}
+
+SvgWriter & SvgWriter::attribute(const char * name, const char * value)
+{
+	startAttribute(name);
+	m_svg += QLatin1String(value);
+	m_svg += QLatin1Char('\'');
+	return *this;
+}
+
+SvgWriter & SvgWriter::attribute(const char * name, qreal value)
+{
+	startAttribute(name);
+	appendNumber(m_svg, value * m_scale);
+	m_svg += QLatin1Char('\'');
+	return *this;
+}
+
+SvgWriter & SvgWriter::startAttribute(const char * name)
+{
+	m_svg += QLatin1Char(' ');
+	m_svg += QLatin1String(name);
+	m_svg += QLatin1String("='");
+	return *this;
+}
+
+SvgWriter & SvgWriter::endAttribute()
+{
+	m_svg += QLatin1Char('\'');
+	return *this;
+}
+
+SvgWriter & SvgWriter::endStart()
+{
+	m_svg += QLatin1Char('>');
+	return *this;
+}
+
+SvgWriter & SvgWriter::end()
+{
+	m_svg += QLatin1String(" />\n");
+	return *this;
+}
+
+SvgWriter & SvgWriter::close(const char * tagName)
+{
+	m_svg += QLatin1String("</");
+	m_svg += QLatin1String(tagName);
+	m_svg += QLatin1String(">\n");
+	return *this;
+}
+
+SvgWriter & SvgWriter::number(qreal value)
+{
+	appendNumber(m_svg, value * m_scale);
+	return *this;
+}
+
+SvgWriter & SvgWriter::absolute(qreal x, qreal y, QPointF & pen)
+{
+	pen.setX(appendNumber(m_svg, x * m_scale));
+	m_svg += QLatin1Char(',');
+	pen.setY(appendNumber(m_svg, y * m_scale));
+	return *this;
+}
+
+SvgWriter & SvgWriter::point(qreal x, qreal y, QPointF & pen)
+{
+	if (!Compact) return absolute(x, y, pen);
+
+	delta(x, pen.rx());
+	m_svg += QLatin1Char(',');
+	delta(y, pen.ry());
+	return *this;
+}
+
+SvgWriter & SvgWriter::delta(qreal value, qreal & pen)
+{
+	// the pen only moves by what was written, so rounding doesn't add up along a relative path
+	pen += appendNumber(m_svg, value * m_scale - pen);
+	return *this;
+}
+
+SvgWriter & SvgWriter::raw(const char * string)
+{
+	m_svg += QLatin1String(string);
+	return *this;
+}
+
+SvgWriter & SvgWriter::raw(const QString & string)
+{
+	m_svg += string;
+	return *this;
+}
+
+SvgWriter & SvgWriter::text(const QString & string)
+{
+	m_svg += TextUtils::escapeAnd(string);
+	return *this;
+}
+
+qreal SvgWriter::appendNumber(QString & svg, qreal value)
+{
+	if (Precision < 0) {
+		// same as QString::arg(double): 'g' format, 6 significant digits
+		QString string = QString::number(value);
+		svg += string;
+		return string.toDouble();
+	}
+
+	qreal scaled = value * PowersOfTen[Precision];
+	if (!(qAbs(scaled) < 9e15)) {
+		// too big for the integer path (or nan/inf)
+		svg += QString::number(value, 'g', 15);
+		return value;
+	}
+
+	qint64 n = qRound64(scaled);
+	qreal written = n / PowersOfTen[Precision];
+	bool negative = n < 0;
+	quint64 digits = negative ? -n : n;
+	int decimals = Precision;
+	while (decimals > 0 && digits % 10 == 0) {
+		digits /= 10;
+		decimals--;
+	}
+
+	// written backwards from the end of the buffer
+	char buffer[32];
+	int i = sizeof(buffer) - 1;
+	buffer[i] = 0;
+	int written = 0;
+	do {
+		if (written == decimals && decimals > 0) {
+			buffer[--i] = '.';
+		}
+		buffer[--i] = '0' + (digits % 10);
+		digits /= 10;
+		written++;
+	} while (digits > 0 || written <= decimals);
+
+	if (negative) buffer[--i] = '-';
+	svg += QLatin1String(buffer + i);
+	return written;
+}
+
+QString SvgWriter::formatNumber(qreal value)
+{
+	QString string;
+	appendNumber(string, value);
+	return string;
+}
+
+void SvgWriter::setPrecision(int decimals)
+{
+	Precision = validPrecision(decimals) ? decimals : -1;
+}
+
+int SvgWriter::precision()
+{
+	return Precision;
+}
+
+bool SvgWriter::validPrecision(int decimals)
+{
+	return decimals >= 0 && decimals <= MaxPrecision;
+}
+
+void SvgWriter::setCompact(bool compact)
+{
+	Compact = compact;
+}
+
+bool SvgWriter::compact()
+{
+	return Compact;
+}
+
+const char * SvgWriter::command(char absoluteCommand)
+{
+	if (absoluteCommand == 'A') return Compact ? "a" : "A";
+	return Compact ? "l" : "L";
+}
+
+QString SvgWriter::benchmark(int count)
+{
+	// coordinates in the range a board produces, with the usual float noise
+	QVector<qreal> values;
+	values.reserve(count);
+	qreal value = -2.5;
+	for (int i = 0; i < count; i++) {
+		values.append(value);
+		value += 0.0127 + (i % 7) * 0.001;
+		if (value > 12.7) value = -2.5;
+	}
+
+	int savedPrecision = Precision;
+	QString report;
+	QElapsedTimer timer;
+
+	QString output;
+	timer.start();
+	foreach (qreal v, values) {
+		output += QString("%1").arg(v);
+		output += QLatin1Char(' ');
+	}
+	report += QString("QString::arg(double): %1 ms, %2 chars\n").arg(timer.elapsed()).arg(output.length());
+
+	for (int decimals = -1; decimals <= MaxPrecision; decimals += (decimals < 3 ? 1 : 3)) {
+		Precision = decimals;
+		output.clear();
+		timer.start();
+		foreach (qreal v, values) {
+			appendNumber(output, v);
+			output += QLatin1Char(' ');
+		}
+		report += QString("appendNumber precision %1: %2 ms, %3 chars\n").arg(decimals).arg(timer.elapsed()).arg(output.length());
+	}
+
+	Precision = savedPrecision;
+	return report;
+}
@@ -0,0 +1,94 @@
+#include "taskgraph.h"
+
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QThreadPool>
+
+class TaskRunnable : public QRunnable
+{
+public:
+	TaskRunnable(TaskGraph * graph, int id) : m_graph(graph), m_id(id) {}
+
+	void run() {
+		m_graph->m_runner->runTask(m_id);
+		m_graph->finished(m_id);
+	}
+
+protected:
+	TaskGraph * m_graph;
+	int m_id;
+};
+
+TaskGraph::TaskGraph(Runner * runner) : m_runner(runner)
+{
+	m_pool = NULL;
+	m_remaining = 0;
+}
+
+int TaskGraph::add()
+{
+	m_dependents.append(QList<int>());
+	m_waitingOn.append(0);
+	return m_dependents.count() - 1;
+}
+
+void TaskGraph::depend(int task, int on)
+{
+	// only on earlier tasks, so there can't be a cycle
+	if (on >= task || m_dependents.at(on).contains(task)) return;
+
+	m_dependents[on].append(task);
+	m_waitingOn[task]++;
+}
+
+int TaskGraph::count() const
+{
+	return m_dependents.count();
+}
+
+void TaskGraph::run(QThreadPool * pool)
+{
+	m_pool = pool;
+	m_remaining = count();
+
+	QList<int> ready;
+	for (int id = 0; id < count(); id++) {
+		if (m_waitingOn.at(id) == 0) ready.append(id);
+	}
+
+	if (m_pool == NULL) {
+		while (!ready.isEmpty()) {
+			int id = ready.takeFirst();
+			m_runner->runTask(id);
+			m_remaining--;
+			foreach (int dependent, m_dependents.at(id)) {
+				if (--m_waitingOn[dependent] == 0) ready.append(dependent);
+			}
+		}
+		return;
+	}
+
+	QMutexLocker locker(&m_mutex);
+	foreach (int id, ready) {
+		start(id);
+	}
+	while (m_remaining > 0) {
+		m_allDone.wait(&m_mutex);
+	}
+}
+
+void TaskGraph::start(int id)
+{
+	m_pool->start(new TaskRunnable(this, id));
+}
+
+void TaskGraph::finished(int id)
+{
+	QMutexLocker locker(&m_mutex);
+	foreach (int dependent, m_dependents.at(id)) {
+		if (--m_waitingOn[dependent] == 0) start(dependent);
+	}
+	if (--m_remaining == 0) {
+		m_allDone.wakeAll();
+	}
+}
@@ -0,0 +1,56 @@
+#ifndef TASKGRAPH_H
+#define TASKGRAPH_H
+
+#include <QList>
+#include <QMutex>
+#include <QVector>
+#include <QWaitCondition>
+
+class QThreadPool;
+
+// Runs a set of tasks, each once every task it depends on has finished.  Tasks are just ids;
+// the Runner does the work for an id.  A task becomes ready on whichever thread finishes its
+// last dependency, and goes straight to the pool, so independent chains never wait on each
+// other.  With no pool, run() works through the ready tasks in order on the calling thread.
+//
+//     TaskGraph graph(runner);
+//     int a = graph.add();
+//     int b = graph.add();
+//     graph.depend(b, a);
+//     graph.run(pool);
+
+class TaskGraph
+{
+public:
+	class Runner {
+	public:
+		virtual ~Runner() {}
+		virtual void runTask(int id) = 0;
+	};
+
+	TaskGraph(Runner *);
+
+	int add();								// ids count up from 0
+	void depend(int task, int on);			// task waits for on, which must have been added before it
+	int count() const;
+
+	// returns once every task has run; the pool must not be the one the caller is running on
+	void run(QThreadPool *);
+
+protected:
+	void start(int id);
+	void finished(int id);
+
+	friend class TaskRunnable;
+
+protected:
+	Runner * m_runner;
+	QVector< QList<int> > m_dependents;
+	QVector<int> m_waitingOn;				// unfinished dependencies per task
+	QThreadPool * m_pool;
+	QMutex m_mutex;
+	QWaitCondition m_allDone;
+	int m_remaining;
+};
+
+#endif // TASKGRAPH_H
@@ -0,0 +1,178 @@
+#include "zipwriter.h"
+
+#include <QDateTime>
+#include <QFile>
+#include <QtDebug>
+
+static const quint32 LocalHeaderSignature = 0x04034b50;
+static const quint32 CentralHeaderSignature = 0x02014b50;
+static const quint32 EndSignature = 0x06054b50;
+static const quint16 VersionNeeded = 20;
+static const quint16 Utf8Names = 0x0800;
+
+class CrcTable
+{
+public:
+	CrcTable() {
+		for (quint32 n = 0; n < 256; n++) {
+			quint32 c = n;
+			for (int k = 0; k < 8; k++) {
+				c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+			}
+			table[n] = c;
+		}
+	}
+
+	quint32 table[256];
+};
+
+// built before main() runs, so boards converted on other threads can share it
+static const CrcTable Crcs;
+
+static void put16(QByteArray & bytes, quint16 value)
+{
+	bytes.append((char) (value & 0xff));
+	bytes.append((char) (value >> 8));
+}
+
+static void put32(QByteArray & bytes, quint32 value)
+{
+	put16(bytes, value & 0xffff);
+	put16(bytes, value >> 16);
+}
+
+static quint16 get16(const QByteArray & bytes, int pos)
+{
+	return (quint8) bytes.at(pos) | ((quint8) bytes.at(pos + 1) << 8);
+}
+
+static quint32 get32(const QByteArray & bytes, int pos)
+{
+	return get16(bytes, pos) | ((quint32) get16(bytes, pos + 2) << 16);
+}
+
+quint32 ZipWriter::crc32(const QByteArray & bytes)
+{
+	quint32 crc = 0xffffffff;
+	const char * data = bytes.constData();
+	for (int i = 0; i < bytes.size(); i++) {
+		crc = Crcs.table[(crc ^ (quint8) data[i]) & 0xff] ^ (crc >> 8);
+	}
+	return crc ^ 0xffffffff;
+}
+
+ZipEntry ZipWriter::compress(const QString & name, const QByteArray & content)
+{
+	ZipEntry entry;
+	entry.name = name;
+	entry.crc = crc32(content);
+	entry.size = content.size();
+
+	QDateTime now = QDateTime::currentDateTime();
+	entry.time = (now.time().hour() << 11) | (now.time().minute() << 5) | (now.time().second() / 2);
+	entry.date = ((now.date().year() - 1980) << 9) | (now.date().month() << 5) | now.date().day();
+
+	// qCompress gives a 4 byte length and a zlib stream; zip wants the raw deflate data inside the stream
+	QByteArray compressed = qCompress(content, 9);
+	int deflatedSize = compressed.size() - 4 - 2 - 4;
+	if (deflatedSize > 0 && deflatedSize < content.size()) {
+		entry.method = 8;
+		entry.data = compressed.mid(6, deflatedSize);
+	}
+	else {
+		entry.method = 0;
+		entry.data = content;
+	}
+
+	return entry;
+}
+
+QByteArray ZipWriter::archive(const QList<ZipEntry> & entries)
+{
+	QByteArray archive;
+	QByteArray directory;
+	foreach (const ZipEntry & entry, entries) {
+		QByteArray name = entry.name.toUtf8();
+
+		put32(directory, CentralHeaderSignature);
+		put16(directory, VersionNeeded);			// made by
+		put16(directory, VersionNeeded);
+		put16(directory, Utf8Names);
+		put16(directory, entry.method);
+		put16(directory, entry.time);
+		put16(directory, entry.date);
+		put32(directory, entry.crc);
+		put32(directory, entry.data.size());
+		put32(directory, entry.size);
+		put16(directory, name.size());
+		put16(directory, 0);						// extra field
+		put16(directory, 0);						// comment
+		put16(directory, 0);						// disk
+		put16(directory, 0);						// internal attributes
+		put32(directory, 0);						// external attributes
+		put32(directory, archive.size());
+		directory.append(name);
+
+		put32(archive, LocalHeaderSignature);
+		put16(archive, VersionNeeded);
+		put16(archive, Utf8Names);
+		put16(archive, entry.method);
+		put16(archive, entry.time);
+		put16(archive, entry.date);
+		put32(archive, entry.crc);
+		put32(archive, entry.data.size());
+		put32(archive, entry.size);
+		put16(archive, name.size());
+		put16(archive, 0);
+		archive.append(name);
+		archive.append(entry.data);
+	}
+
+	quint32 directoryOffset = archive.size();
+	archive.append(directory);
+	put32(archive, EndSignature);
+	put16(archive, 0);
+	put16(archive, 0);
+	put16(archive, entries.count());
+	put16(archive, entries.count());
+	put32(archive, directory.size());
+	put32(archive, directoryOffset);
+	put16(archive, 0);
+
+	return archive;
+}
+
+bool ZipWriter::read(const QString & path, QList<ZipEntry> & entries)
+{
+	QFile file(path);
+	if (!file.open(QIODevice::ReadOnly)) return false;
+
+	QByteArray archive = file.readAll();
+	file.close();
+
+	int pos = 0;
+	while (pos + 30 <= archive.size() && get32(archive, pos) == LocalHeaderSignature) {
+		ZipEntry entry;
+		entry.method = get16(archive, pos + 8);
+		entry.time = get16(archive, pos + 10);
+		entry.date = get16(archive, pos + 12);
+		entry.crc = get32(archive, pos + 14);
+		quint32 dataSize = get32(archive, pos + 18);
+		entry.size = get32(archive, pos + 22);
+		int nameSize = get16(archive, pos + 26);
+		int extraSize = get16(archive, pos + 28);
+		pos += 30;
+		if (pos + nameSize + extraSize + (qint64) dataSize > archive.size()) {
+			qDebug() << "truncated zip" << path;
+			return false;
+		}
+
+		entry.name = QString::fromUtf8(archive.constData() + pos, nameSize);
+		pos += nameSize + extraSize;
+		entry.data = archive.mid(pos, dataSize);
+		pos += dataSize;
+		entries.append(entry);
+	}
+
+	return true;
+}
@@ -0,0 +1,36 @@
+#ifndef ZIPWRITER_H
+#define ZIPWRITER_H
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+
+// Minimal zip archives written from memory, for .fzpz and .fzbz bundles.  Each entry is
+// deflated once when it is made, so the same entry can go into a part's .fzpz and into the
+// run's .fzbz without being compressed again.
+
+struct ZipEntry {
+	QString name;
+	QByteArray data;			// as stored in the archive
+	quint16 method;				// 0 stored, 8 deflated
+	quint32 crc;
+	quint32 size;				// uncompressed
+	quint16 time;				// dos format
+	quint16 date;
+};
+
+class ZipWriter
+{
+public:
+	static ZipEntry compress(const QString & name, const QByteArray & content);
+
+	// the whole archive, assembled in memory so it can be written with a single write
+	static QByteArray archive(const QList<ZipEntry> &);
+
+	// reads back the entries of an archive made by archive(), without inflating them
+	static bool read(const QString & path, QList<ZipEntry> &);
+
+	static quint32 crc32(const QByteArray &);
+};
+
+#endif // ZIPWRITER_H